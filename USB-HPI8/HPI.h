@@ -0,0 +1,285 @@
+#ifndef _HPI_H_INCLUDED
+#define _HPI_H_INCLUDED
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/ina90.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// HPI: 8-bit Host Port Interface of the TMS320VC54 DSP
+//
+// Every 16-bit access is two octet cycles on the data bus, MSB first
+// (HBIL = 0, 1). HCNTL selects the HPI register, see enum below.
+//
+class HPI
+{
+    //  PA6   OUT                HPI HCS#
+    //  PA5   OUT                HPI RESET#
+    //  PA4   OUT                HPI HDS#
+    //  PA3   OUT                HPI HR/W#
+    //  PA2   OUT                HPI HBIL
+    //  PB1   OUT                HPI HCNTL1
+    //  PB0   OUT                HPI HCNTL0
+    //  PB2   IN                 HPI INT (HINT, high if asserted)
+    //  PC0..7 I/O               HPI HD0..7 (shared with USB FIFO)
+
+public:
+
+    enum // HCNTL1..0: HPI register selected by cntl
+    {
+        HPIC            = 0,    // Control register
+        HPID_AUTOINC    = 1,    // Data; HPIA pre-incremented on write,
+                                // post-incremented on read
+        HPIA            = 2,    // Address register
+        HPID            = 3     // Data; HPIA unchanged
+        };
+
+    enum // instead of #defines
+    {
+        BOOT_ENTRY      = 0x007F    // HPI boot loader polls it for entry point
+        };
+
+    bool IsHINT( void ) const
+    {
+        return PINB & _BV(PB2);
+        }
+
+    void Set_HRESET( void )
+    {
+        // HRESET# = LOW
+        PORTA &= ~_BV(PA5);
+        }
+
+    void Pulse_HRESET ()
+    {
+        // HRESET# = LOW
+        PORTA &= ~_BV(PA5);
+
+        // Wait 1us
+        _NOP (); _NOP (); _NOP (); _NOP ();
+        _NOP (); _NOP (); _NOP (); _NOP ();
+        _NOP (); _NOP (); _NOP (); _NOP ();
+        _NOP (); _NOP (); _NOP (); _NOP ();
+
+        // HRESET# = HIGH
+        PORTA |= _BV(PA5);
+        }
+
+    // Burst access: HCNTL, HR/W# and HCS# are set, and the data bus
+    // direction fixed, once for a sequence of words through the same
+    // register (HPID_AUTOINC for a block); each word then only strobes
+    // HBIL and HDS#. End_Burst() releases HCS# and tri-states the bus.
+    //
+    // The HPI drives the bus only while HDS# is low, so the USB FIFO may
+    // be accessed between the words of a read burst; a write burst keeps
+    // PC0..7 as outputs and must not be interrupted by usb_Get().
+    //
+    void Begin_Read( int cntl )
+    {
+        DDRC = 0x00; // DDRC input
+        PORTC = 0x00; // tri-state
+
+        // HCNTL0..1 = cntl & 0x03
+        PORTB &= ~_BV(PB1) & ~_BV(PB0);
+        PORTB |= ( cntl & 0x03 );
+
+        // HDS# = HIGH, HR/W# = HIGH
+        PORTA |= _BV(PA4) | _BV(PA3);
+
+        // HCS# = LOW
+        PORTA &= ~_BV(PA6);
+        }
+
+    void Begin_Write( int cntl )
+    {
+        // HCNTL0..1 = cntl & 0x03
+        PORTB &= ~_BV(PB1) & ~_BV(PB0);
+        PORTB |= ( cntl & 0x03 );
+
+        // HDS# = HIGH, HR/W# = LOW
+        PORTA |= _BV(PA4);
+        PORTA &= ~_BV(PA3);
+
+        // HCS# = LOW
+        PORTA &= ~_BV(PA6);
+
+        DDRC = 0xFF; // DDRC output
+        }
+
+    unsigned short Read_Next( void )
+    {
+        // HBIL = LOW
+        PORTA &= ~_BV(PA2);
+
+        // HDS# = LOW
+        PORTA &= ~_BV(PA4);
+        _NOP ();
+
+        // Read byte
+        unsigned short H = PINC;
+
+        // HDS# = HIGH
+        PORTA |= _BV(PA4);
+
+        // HBIL = HIGH
+        PORTA |= _BV(PA2);
+
+        // HDS# = LOW
+        PORTA &= ~_BV(PA4);
+        _NOP ();
+
+        // Read byte
+        unsigned short L = PINC;
+
+        // HDS# = HIGH
+        PORTA |= _BV(PA4);
+
+        return ( H << 8 ) | L;
+        }
+
+    void Write_Next( unsigned short value )
+    {
+        // MSB
+        PORTC = ( value >> 8 ) & 0xFF;
+
+        // HBIL = 0
+        PORTA &= ~_BV(PA2);
+
+        // HDS# = LOW
+        PORTA &= ~_BV(PA4);
+
+        // HDS# = HIGH
+        PORTA |= _BV(PA4);
+
+        // LSB
+        PORTC = value & 0xFF;
+
+        // HBIL = 1
+        PORTA |= _BV(PA2);
+
+        // HDS# = LOW
+        PORTA &= ~_BV(PA4);
+
+        // HDS# = HIGH
+        PORTA |= _BV(PA4);
+        }
+
+    void End_Burst( void )
+    {
+        // HCS# = HIGH
+        PORTA |= _BV(PA6);
+
+        DDRC = 0x00; // DDRC input
+        PORTC = 0x00; // tri-state
+        }
+
+    void Read_Burst( int cntl, unsigned short* data, int count )
+    {
+        Begin_Read( cntl );
+
+        while ( count-- > 0 )
+            *data++ = Read_Next ();
+
+        End_Burst ();
+        }
+
+    void Write_Burst( int cntl, const unsigned short* data, int count )
+    {
+        Begin_Write( cntl );
+
+        while ( count-- > 0 )
+            Write_Next( *data++ );
+
+        End_Burst ();
+        }
+
+    // Single word access
+    //
+    unsigned short Read( int cntl )
+    {
+        Begin_Read( cntl );
+        unsigned short value = Read_Next ();
+        End_Burst ();
+
+        return value;
+        }
+
+    void Write( int cntl, unsigned short value )
+    {
+        Begin_Write( cntl );
+        Write_Next( value );
+        End_Burst ();
+        }
+
+    void Put_HPIC( int value )
+    {
+        value &= 0x7F;
+        value = ( value << 8 ) | value;
+        Write( 0, value );
+        }
+
+    void Reset_DSP( void )
+    {
+        Pulse_HRESET ();
+
+        // Set XHPIA = 0x0000:0x1000
+        //
+        Put_HPIC( 0x10 );   // XHPIA = ON
+        Write( 2, 0x0000 ); // HPIA = 0x0000
+        Put_HPIC( 0x00 );   // XHPIA = OFF
+        Write( 2, 0x1000 ); // HPIA = 0x1000
+
+        // Wait HINT
+        //
+        for ( int i = 0; i < 10000; i++ )
+            if ( IsHINT () )
+                break;
+
+        // Acknowledge HINT
+        //
+        Put_HPIC( 0x08 );
+        }
+
+    // Starts program downloaded while the HPI boot loader waits, i.e.
+    // after Reset_DSP (entry point must not be 0)
+    //
+    void Start( unsigned short entry )
+    {
+        Write( HPIA, BOOT_ENTRY );
+        Write( HPID, entry );
+        }
+
+    unsigned short Initialize( void )
+    {
+        Reset_DSP ();
+
+        // Download program @ 0x1000
+        //
+        Write( 3, 0x10F8 ); // LD *(0x003E), A
+        Write( 1, 0x003E );
+
+        Write( 1, 0x80F8 ); // STL A, *(0x1100)
+        Write( 1, 0x1100 );
+
+        Write( 1, 0xF073 ); // L1: B L1
+        Write( 1, 0x1004 );
+
+        Write( 2, 0x1100 ); // *(0x1100) = 0xFFFF
+        Write( 3, 0xFFFF );
+
+        Write( 2, 0x007E ); // Run program @0x1000
+        Write( 3, 0x0000 );
+        Write( 1, 0x1000 ); 
+
+        Write( 2, 0x1100 ); // Get ID from *(0x1100)
+        unsigned short ID = Read( 3 );
+
+        Reset_DSP ();
+        return ID;
+        }
+    };
+
+
+extern HPI hpi;
+
+#endif // _HPI_H_INCLUDED
@@ -0,0 +1,242 @@
+#include <avr/interrupt.h>
+
+#include "HostCmd.h"
+#include "HPI.h"
+#include "USB.h"
+
+HOSTCMD hostcmd;
+
+extern volatile uint16_t Timer0_Counter; // 450Hz (2.222ms)
+
+// Timer0_Counter is updated by SIG_OVERFLOW0; its two octets are read
+// with interrupts disabled
+//
+static uint16_t Timer0_Read( void )
+{
+    uint8_t sreg = SREG;
+    cli ();
+
+    uint16_t count = Timer0_Counter;
+
+    SREG = sreg;
+
+    return count;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t HOSTCMD:: GetWord( void )
+{
+    uint16_t H = usb_Get ();
+    return ( H << 8 ) | usb_Get ();
+    }
+
+void HOSTCMD:: PutWord( uint16_t value )
+{
+    usb_Put( value >> 8 );
+    usb_Put( value & 0xFF );
+    }
+
+void HOSTCMD:: WaitHINT( uint16_t timeout_ms )
+{
+    uint16_t ticks = uint16_t( ( timeout_ms * 9UL ) / 20 ) + 1;
+    uint16_t start = Timer0_Read ();
+
+    while ( ! hpi.IsHINT () )
+    {
+        if ( uint16_t( Timer0_Read () - start ) > ticks )
+        {
+            usb_Put( 0 );
+            return;
+            }
+        }
+
+    usb_Put( 1 );
+    }
+
+void HOSTCMD:: ReadCRC( uint16_t count )
+{
+    uint16_t crc = 0xFFFF;
+
+    hpi.Begin_Read( HPI::HPID_AUTOINC );
+
+    for ( ; count > 0; count-- )
+    {
+        uint16_t word = hpi.Read_Next ();
+        crc = CRC_Update( crc, word >> 8 );
+        crc = CRC_Update( crc, word & 0xFF );
+        }
+
+    hpi.End_Burst ();
+
+    PutWord( crc );
+    }
+
+void HOSTCMD:: ReadBlock( uint16_t count )
+{
+    // HPI does not drive the bus between words, so USB FIFO writes may
+    // go between them
+    //
+    hpi.Begin_Read( HPI::HPID_AUTOINC );
+
+    for ( ; count > 0; count-- )
+        PutWord( hpi.Read_Next () );
+
+    hpi.End_Burst ();
+    }
+
+void HOSTCMD:: WriteBlock( uint16_t count )
+{
+    if ( count == 0 )
+        return;
+
+    hpi.Write( HPI::HPID, GetWord () );
+    count--;
+
+    while ( count > 0 )
+    {
+        // Collect words from USB FIFO first, as the write burst owns the bus
+        //
+        uint16_t n = count < BURST_WORDS ? count : BURST_WORDS;
+
+        for ( uint16_t i = 0; i < n; i++ )
+            burst[ i ] = GetWord ();
+
+        hpi.Write_Burst( HPI::HPID_AUTOINC, burst, n );
+
+        count -= n;
+        }
+    }
+
+void HOSTCMD:: Benchmark( uint16_t addr, uint16_t count )
+{
+    uint32_t cycles[ 4 ] = { 0, 0, 0, 0 };
+
+    // Timer1 (LCD PWM, unused here) as cycle counter
+    //
+    uint8_t tccr1a = TCCR1A;
+    uint8_t tccr1b = TCCR1B;
+
+    TCCR1A = 0;             // Normal mode
+    TCCR1B = _BV(CS10);     // clk/1
+
+    cli (); // disable interrupts
+
+    uint16_t t0 = TCNT1;
+    uint16_t overhead = TCNT1 - t0; // Reading TCNT1 itself
+
+    while ( count > 0 )
+    {
+        // Blocks of BURST_WORDS are timed separately, so 16-bit TCNT1
+        // does not overflow
+        //
+        uint16_t n = count < BURST_WORDS ? count : BURST_WORDS;
+
+        hpi.Write( HPI::HPIA, addr );
+        t0 = TCNT1;
+        for ( uint16_t i = 0; i < n; i++ )
+            burst[ i ] = hpi.Read( HPI::HPID_AUTOINC );
+        cycles[ 0 ] += uint16_t( TCNT1 - t0 - overhead );
+
+        hpi.Write( HPI::HPIA, addr );
+        t0 = TCNT1;
+        hpi.Read_Burst( HPI::HPID_AUTOINC, burst, n );
+        cycles[ 1 ] += uint16_t( TCNT1 - t0 - overhead );
+
+        hpi.Write( HPI::HPIA, addr - 1 );
+        t0 = TCNT1;
+        for ( uint16_t i = 0; i < n; i++ )
+            hpi.Write( HPI::HPID_AUTOINC, burst[ i ] );
+        cycles[ 2 ] += uint16_t( TCNT1 - t0 - overhead );
+
+        hpi.Write( HPI::HPIA, addr - 1 );
+        t0 = TCNT1;
+        hpi.Write_Burst( HPI::HPID_AUTOINC, burst, n );
+        cycles[ 3 ] += uint16_t( TCNT1 - t0 - overhead );
+
+        addr += n;
+        count -= n;
+        }
+
+    sei (); // enable interrupts
+
+    TCCR1A = tccr1a;
+    TCCR1B = tccr1b;
+
+    for ( int i = 0; i < 4; i++ )
+    {
+        PutWord( cycles[ i ] >> 16 );
+        PutWord( cycles[ i ] & 0xFFFF );
+        }
+    }
+
+void HOSTCMD:: Execute( void )
+{
+    int opcode = usb_Get ();
+
+    switch( opcode )
+    {
+        case CMD_NOP:
+            break;
+
+        case CMD_SYNC:
+            usb_Put( usb_Get () );
+            break;
+
+        case CMD_SET_HPIC:
+            hpi.Put_HPIC( usb_Get () );
+            break;
+
+        case CMD_GET_HPIC:
+            PutWord( hpi.Read( HPI::HPIC ) );
+            break;
+
+        case CMD_SET_HPIA:
+            hpi.Write( HPI::HPIA, GetWord () );
+            break;
+
+        case CMD_READ:
+            PutWord( hpi.Read( HPI::HPID ) );
+            break;
+
+        case CMD_WRITE:
+            hpi.Write( HPI::HPID, GetWord () );
+            break;
+
+        case CMD_READ_BLOCK:
+            ReadBlock( GetWord () );
+            break;
+
+        case CMD_WRITE_BLOCK:
+            WriteBlock( GetWord () );
+            break;
+
+        case CMD_RESET:
+            hpi.Pulse_HRESET ();
+            break;
+
+        case CMD_WAIT_HINT:
+            WaitHINT( GetWord () );
+            break;
+
+        case CMD_CRC:
+            ReadCRC( GetWord () );
+            break;
+
+        case CMD_START:
+            hpi.Start( GetWord () );
+            break;
+
+        case CMD_BENCHMARK:
+        {
+            uint16_t addr = GetWord ();
+            Benchmark( addr, GetWord () );
+            }
+            break;
+
+        default:
+            usb_Put( RSP_ERROR );
+            usb_Put( opcode );
+            break;
+        }
+    }
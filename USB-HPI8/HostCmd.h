@@ -0,0 +1,154 @@
+#ifndef _HOSTCMD_H_INCLUDED
+#define _HOSTCMD_H_INCLUDED
+
+#include <inttypes.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// HOSTCMD: USB commands for DSP memory access over HPI
+//
+// Commands are read from the USB FIFO and executed in order, as a plain
+// octet stream without framing. Only some commands are answered, so the
+// host may send any number of commands at once and read the replies in
+// order later; block data is passed through between USB FIFO and HPI
+// without buffering.
+//
+class HOSTCMD
+{
+/*
+    Host -> USB-HPI8: OPCODE, PARAMS; USB-HPI8 -> Host: REPLY
+
+    OPCODE               PARAMS                  REPLY
+
+    CMD_NOP         0x00 -                       -
+    CMD_SYNC        0x01 TAG                     TAG
+    CMD_SET_HPIC    0x02 VALUE                   -
+    CMD_GET_HPIC    0x03 -                       HPIC
+    CMD_SET_HPIA    0x04 ADDR                    -
+    CMD_READ        0x05 -                       WORD
+    CMD_WRITE       0x06 WORD                    -
+    CMD_READ_BLOCK  0x07 COUNT                   WORD[COUNT]
+    CMD_WRITE_BLOCK 0x08 COUNT, WORD[COUNT]      -
+    CMD_RESET       0x09 -                       -
+    CMD_WAIT_HINT   0x0A TIMEOUT                 HINT
+    CMD_CRC         0x0B COUNT                   CRC
+    CMD_START       0x0C ENTRY                   -
+    CMD_BENCHMARK   0x0D ADDR, COUNT             CYCLES[4]
+
+    ADDR, WORD, COUNT, TIMEOUT, HPIC, CRC and ENTRY are 16 bits, MSB
+    first; CYCLES are 32 bits, MSB first; TAG, VALUE and HINT are octets.
+
+    CMD_SYNC:       Echoes TAG; the host uses it to find the end of the
+                    replies to the commands before.
+
+    CMD_SET_HPIC:   Writes VALUE to both octets of HPIC (e.g. 0x08 to
+                    acknowledge HINT, 0x10 to select XHPIA).
+
+    CMD_READ, CMD_WRITE: HPID at HPIA; HPIA is unchanged.
+
+    CMD_READ_BLOCK: COUNT words from HPIA on through HPID with
+                    autoincrement, in one HPI read burst; HPIA is left
+                    after the last word.
+
+    CMD_WRITE_BLOCK: COUNT words to HPIA on: the first one through HPID,
+                    the others through HPID with autoincrement (which
+                    increments HPIA before the write); HPIA is left at the
+                    last word. Words are collected from the USB FIFO and
+                    written in HPI bursts of BURST_WORDS.
+
+    CMD_RESET:      Pulses HRESET# for 1us. The DSP asserts HINT when its
+                    HPI boot loader is ready.
+
+    CMD_WAIT_HINT:  Waits until HINT is asserted, at most TIMEOUT ms
+                    (resolution 2.2ms). HINT is 1 if asserted, 0 after
+                    timeout; it is not acknowledged.
+
+    CMD_CRC:        Reads COUNT words from HPIA on, like CMD_READ_BLOCK,
+                    but answers only their CRC-16 (CCITT, x^16 + x^12 +
+                    x^5 + 1, preset 0xFFFF, words MSB first). The host
+                    verifies downloads with it at HPI speed instead of
+                    USB speed.
+
+    CMD_START:      Writes ENTRY to the entry point word of the DSP HPI
+                    boot loader (0x007F), which then branches to ENTRY;
+                    HPIA is changed.
+
+    CMD_BENCHMARK:  Measures HPI access of COUNT words from ADDR on, in
+                    CPU cycles (interrupts disabled, Timer1 at clk/1):
+                    single word read, burst read, single word write and
+                    burst write, in this order. USB transfer is not
+                    included. The words are written back as read, so the
+                    memory is unchanged unless the DSP modifies it at the
+                    same time. ADDR must not be 0, since autoincrement
+                    writes start at ADDR - 1; HPIA is changed.
+
+    Unknown opcodes are answered with RSP_ERROR, OPCODE. The device then
+    takes the following octets as commands again, so the host sends at
+    least 3 + 2 * 65535 NOPs before the next SYNC to resynchronize after
+    an error in a block command.
+*/
+
+public:
+
+    enum // Opcodes
+    {
+        CMD_NOP           = 0x00,
+        CMD_SYNC          = 0x01,
+        CMD_SET_HPIC      = 0x02,
+        CMD_GET_HPIC      = 0x03,
+        CMD_SET_HPIA      = 0x04,
+        CMD_READ          = 0x05,
+        CMD_WRITE         = 0x06,
+        CMD_READ_BLOCK    = 0x07,
+        CMD_WRITE_BLOCK   = 0x08,
+        CMD_RESET         = 0x09,
+        CMD_WAIT_HINT     = 0x0A,
+        CMD_CRC           = 0x0B,
+        CMD_START         = 0x0C,
+        CMD_BENCHMARK     = 0x0D
+        };
+
+    enum // Replies
+    {
+        RSP_ERROR         = 0xEE
+        };
+
+private:
+
+    enum // instead of #defines
+    {
+        BURST_WORDS       = 32      // Words buffered per HPI burst
+        };
+
+    uint16_t burst[ BURST_WORDS ];
+
+    static uint16_t GetWord( void );
+    static void PutWord( uint16_t value );
+
+    void WaitHINT( uint16_t timeout_ms );
+    void ReadCRC( uint16_t count );
+    void ReadBlock( uint16_t count );
+    void WriteBlock( uint16_t count );
+    void Benchmark( uint16_t addr, uint16_t count );
+
+public:
+
+    // CRC-16 (CCITT) update by one octet; the host computes the same
+    //
+    static uint16_t CRC_Update( uint16_t crc, uint8_t octet )
+    {
+        crc = ( crc >> 8 ) | ( crc << 8 );
+        crc ^= octet;
+        crc ^= ( crc & 0xFF ) >> 4;
+        crc ^= crc << 12;
+        crc ^= ( crc & 0xFF ) << 5;
+        return crc;
+        }
+
+    // Executes next command; waits for its octets from the USB FIFO
+    //
+    void Execute( void );
+    };
+
+extern HOSTCMD hostcmd;
+
+#endif // _HOSTCMD_H_INCLUDED
@@ -98,6 +98,10 @@ SOURCE=.\Cadence.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\HostCmd.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\Keyboard.cpp
 # End Source File
 # Begin Source File
@@ -130,6 +134,14 @@ SOURCE=.\Cadence.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\HostCmd.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\HPI.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Keyboard.h
 # End Source File
 # Begin Source File
@@ -140,6 +152,10 @@ SOURCE=.\LCD.h
 
 SOURCE=.\USART.h
 # End Source File
+# Begin Source File
+
+SOURCE=.\USB.h
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 
@@ -0,0 +1,74 @@
+#ifndef _USB_H_INCLUDED
+#define _USB_H_INCLUDED
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/ina90.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// FT245 USB FIFO
+//
+//  PA1   OUT                USB RD#
+//  PA0   OUT                USB WR
+//  PD3   IN                 USB TXE#
+//  PD2   IN                 USB RXF#
+//  PC0..7 I/O               USB D0..7 (shared with HPI)
+//
+// PC0..7 are left as tri-stated inputs after every access.
+
+inline bool usb_TxReady( void )
+{
+    return ! ( PIND & _BV(PD3) );   // TXE# asserted
+    }
+
+inline bool usb_RxAvailable( void )
+{
+    return ! ( PIND & _BV(PD2) );   // RXF# asserted
+    }
+
+inline void usb_Put( int ch )
+{
+    do ; while( ! usb_TxReady () );
+
+    PORTC = ch;
+    DDRC = 0xFF; // PC0..7 output
+    _NOP ();
+
+    // WR = HIGH
+    PORTA |= _BV(PA0);
+
+    // WR = LOW
+    PORTA &= ~_BV(PA0);
+
+    PORTC = 0x00; // tri-state
+    DDRC = 0x00; // PC0..7 input
+    _NOP ();
+    }
+
+inline void usb_Put( const char* str )
+{
+    while ( *str )
+        usb_Put( *str++ );
+    }
+
+// Waits for octet from host
+//
+inline int usb_Get( void )
+{
+    do ; while( ! usb_RxAvailable () );
+
+    // RD# = LOW
+    PORTA &= ~_BV(PA1);
+
+    _NOP (); // Wait 50ns
+    _NOP ();
+
+    unsigned char data = PINC;
+
+    // RD# = HIGH
+    PORTA |= _BV(PA1);
+
+    return data;
+    }
+
+#endif // _USB_H_INCLUDED
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "coff.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+COFF_File::COFF_File( void )
+{
+    image = 0;
+    image_size = 0;
+    big_endian = false;
+    sections = 0;
+    section_count = 0;
+    has_entry = false;
+    entry = 0;
+    error[ 0 ] = 0;
+    }
+
+COFF_File::~COFF_File( void )
+{
+    Clear ();
+    }
+
+void COFF_File::Clear( void )
+{
+    for ( int i = 0; i < section_count; i++ )
+        delete[] sections[ i ].data;
+
+    delete[] sections;
+    sections = 0;
+    section_count = 0;
+
+    has_entry = false;
+    entry = 0;
+    }
+
+bool COFF_File::Fail( const char* message )
+{
+    strncpy( error, message, sizeof( error ) - 1 );
+    error[ sizeof( error ) - 1 ] = 0;
+
+    Clear ();
+    return false;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned int COFF_File::Get16( long offset ) const
+{
+    // Callers check the range
+    //
+    const unsigned char* p = image + offset;
+
+    return big_endian ? ( p[ 0 ] << 8 ) | p[ 1 ] : ( p[ 1 ] << 8 ) | p[ 0 ];
+    }
+
+unsigned long COFF_File::Get32( long offset ) const
+{
+    unsigned long lo = Get16( offset + ( big_endian ? 2 : 0 ) );
+    unsigned long hi = Get16( offset + ( big_endian ? 0 : 2 ) );
+
+    return ( hi << 16 ) | lo;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool COFF_File::Load( const char* filename )
+{
+    Clear ();
+
+    FILE* f = fopen( filename, "rb" );
+    if ( ! f )
+        return Fail( "Cannot open file" );
+
+    fseek( f, 0, SEEK_END );
+    long size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+
+    unsigned char* buf = new unsigned char[ size > 0 ? size : 1 ];
+    bool ok = size > 0 && long( fread( buf, 1, size, f ) ) == size;
+    fclose( f );
+
+    if ( ! ok )
+    {
+        delete[] buf;
+        return Fail( "Cannot read file" );
+        }
+
+    image = buf;
+    image_size = size;
+
+    // COFF1 and COFF2 start with version ID 0x00C1 or 0x00C2, COFF0 with
+    // target ID; the order of its octets tells the byte order
+    //
+    int version = -1;
+    int target = -1;
+
+    if ( size >= 22 )
+    {
+        for ( int order = 0; order < 2 && version < 0; order++ )
+        {
+            big_endian = order != 0;
+
+            unsigned int id = Get16( 0 );
+
+            if ( id == 0x00C1 || id == 0x00C2 )
+            {
+                version = id & 0x0F;
+                target = Get16( 20 );
+                }
+            else if ( id == TARGET_C5400 )
+            {
+                version = 0;
+                target = id;
+                }
+            }
+        }
+
+    long hdr_size = version == 0 ? 20 : 22;
+    long scn_size = version == 2 ? 48 : 40;
+
+    bool loaded = false;
+
+    if ( version < 0 )
+    {
+        Fail( "Not a TI COFF file" );
+        }
+    else if ( target != TARGET_C5400 )
+    {
+        Fail( "Not a C5400 COFF file" );
+        }
+    else
+    {
+        int nsect = Get16( 2 );
+        unsigned long symptr = Get32( 8 );
+        unsigned long nsyms = Get32( 12 );
+        unsigned int opthdr = Get16( 16 );
+
+        long strtab = long( symptr + nsyms * 18 ); // Symbol entries are 18 octets
+        long scnhdr = hdr_size + opthdr;
+
+        if ( scnhdr + nsect * scn_size > size )
+        {
+            Fail( "Truncated file header" );
+            }
+        else
+        {
+            if ( opthdr >= 28 )
+            {
+                has_entry = true;
+                entry = Get32( hdr_size + 16 );
+                }
+
+            sections = new Section[ nsect ];
+            loaded = true;
+
+            for ( int i = 0; i < nsect && loaded; i++ )
+            {
+                long h = scnhdr + i * scn_size;
+
+                unsigned long addr = Get32( h + 8 );
+                unsigned long words = Get32( h + 16 );
+                unsigned long scnptr = Get32( h + 20 );
+                unsigned long flags;
+                int page;
+
+                if ( version == 2 )
+                {
+                    flags = Get32( h + 40 );
+                    page = Get16( h + 46 );
+                    }
+                else
+                {
+                    flags = Get16( h + 36 );
+                    page = image[ h + 39 ];
+                    }
+
+                if ( words == 0 || scnptr == 0
+                    || ( flags & ( STYP_DSECT | STYP_NOLOAD | STYP_COPY | STYP_BSS ) ) )
+                {
+                    continue;
+                    }
+
+                Section& s = sections[ section_count ];
+
+                // Long names are in the string table
+                //
+                memset( s.name, 0, sizeof( s.name ) );
+
+                if ( image[ h ] || image[ h + 1 ] || image[ h + 2 ] || image[ h + 3 ] )
+                {
+                    memcpy( s.name, image + h, 8 );
+                    }
+                else
+                {
+                    long p = strtab + long( Get32( h + 4 ) );
+                    if ( p >= 0 && p < size )
+                        strncpy( s.name, (const char*)image + p, sizeof( s.name ) - 1 );
+                    }
+
+                if ( scnptr + words * 2 > (unsigned long)size )
+                {
+                    loaded = false;
+                    Fail( "Truncated section data" );
+                    break;
+                    }
+
+                if ( addr + words > 0x10000 )
+                {
+                    loaded = false;
+                    Fail( "Section beyond 16-bit address space" );
+                    break;
+                    }
+
+                s.page = page;
+                s.addr = addr;
+                s.size = long( words );
+                s.data = new unsigned short[ words ];
+
+                for ( unsigned long j = 0; j < words; j++ )
+                    s.data[ j ] = Get16( long( scnptr + j * 2 ) );
+
+                ++section_count;
+                }
+            }
+        }
+
+    image = 0;
+    image_size = 0;
+    delete[] buf;
+
+    return loaded;
+    }
@@ -0,0 +1,90 @@
+#ifndef _COFF_H_INCLUDED
+#define _COFF_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+// COFF_File Class: Loadable sections of a TI COFF executable for TMS320C54x
+//
+// Reads COFF0, COFF1 and COFF2 files of either byte order, as written by the
+// TI C5400 linker. Only sections with raw data that are loaded to the target
+// are kept: .bss, DSECT, NOLOAD and COPY sections are skipped. Section
+// addresses and sizes are in 16-bit words; the load (physical) address is
+// used. Program and data page sections are kept alike, since the HPI sees
+// the on-chip RAM at the same address in both.
+//
+class COFF_File
+{
+public:
+
+    struct Section
+    {
+        char name[ 33 ];
+        int page;
+        unsigned long addr;         // Load address
+        long size;                  // Words
+        unsigned short* data;
+        };
+
+private:
+
+    enum // instead of #defines
+    {
+        TARGET_C5400      = 0x0098,
+
+        STYP_DSECT        = 0x0001,
+        STYP_NOLOAD       = 0x0002,
+        STYP_COPY         = 0x0010,
+        STYP_BSS          = 0x0080
+        };
+
+    const unsigned char* image;     // File contents while loading
+    long image_size;
+    bool big_endian;
+
+    Section* sections;
+    int section_count;
+
+    bool has_entry;
+    unsigned long entry;
+
+    char error[ 128 ];
+
+    unsigned int Get16( long offset ) const;
+    unsigned long Get32( long offset ) const;
+
+    bool Fail( const char* message );
+    void Clear( void );
+
+public:
+
+    COFF_File( void );
+    ~COFF_File( void );
+
+    // Reads file; on failure, GetError() tells why
+    //
+    bool Load( const char* filename );
+
+    const char* GetError( void ) const
+    {
+        return error;
+        }
+
+    int GetSectionCount( void ) const
+    {
+        return section_count;
+        }
+
+    const Section& GetSection( int i ) const
+    {
+        return sections[ i ];
+        }
+
+    // Entry point from optional file header; false if there is none
+    //
+    bool GetEntry( unsigned long& p_entry ) const
+    {
+        p_entry = entry;
+        return has_entry;
+        }
+    };
+
+#endif // _COFF_H_INCLUDED
@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/select.h>
+#endif
+
+#include "hpilink.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+HPI_Link::HPI_Link( void )
+{
+#ifdef _WIN32
+    handle = INVALID_HANDLE_VALUE;
+#else
+    fd = -1;
+#endif
+
+    txq_len = 0;
+    sync_tag = 0;
+    timeout_ms = 1000;
+    }
+
+HPI_Link::~HPI_Link( void )
+{
+    Close ();
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HPI_Link::Open( const char* device )
+{
+    Close ();
+
+#ifdef _WIN32
+    char name[ 64 ];
+    _snprintf( name, sizeof( name ), "\\\\.\\%s", device );
+
+    HANDLE h = CreateFile( name, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+        OPEN_EXISTING, 0, NULL );
+
+    if ( h == INVALID_HANDLE_VALUE )
+        return false;
+
+    SetupComm( h, 65536, 65536 );
+
+    COMMTIMEOUTS ct;
+    memset( &ct, 0, sizeof( ct ) );
+    SetCommTimeouts( h, &ct );
+
+    handle = h;
+#else
+    fd = open( device, O_RDWR | O_NOCTTY );
+    if ( fd < 0 )
+        return false;
+
+    struct termios tio;
+    if ( tcgetattr( fd, &tio ) == 0 )
+    {
+        cfmakeraw( &tio );
+        tio.c_cc[ VMIN ] = 0;
+        tio.c_cc[ VTIME ] = 0;
+        tcsetattr( fd, TCSANOW, &tio );
+        }
+#endif
+
+    txq_len = 0;
+
+    return true;
+    }
+
+void HPI_Link::Close( void )
+{
+#ifdef _WIN32
+    if ( handle != INVALID_HANDLE_VALUE )
+        CloseHandle( handle );
+    handle = INVALID_HANDLE_VALUE;
+#else
+    if ( fd >= 0 )
+        close( fd );
+    fd = -1;
+#endif
+    }
+
+int HPI_Link::Read( unsigned char* buf, int len, int timeout_ms )
+{
+#ifdef _WIN32
+    COMMTIMEOUTS ct;
+    memset( &ct, 0, sizeof( ct ) );
+    ct.ReadIntervalTimeout = MAXDWORD;
+    ct.ReadTotalTimeoutMultiplier = MAXDWORD;
+    ct.ReadTotalTimeoutConstant = timeout_ms > 0 ? timeout_ms : 1;
+    SetCommTimeouts( handle, &ct );
+
+    DWORD rd = 0;
+    if ( ! ReadFile( handle, buf, len, &rd, NULL ) )
+        return -1;
+
+    return int( rd );
+#else
+    fd_set rfds;
+    FD_ZERO( &rfds );
+    FD_SET( fd, &rfds );
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = ( timeout_ms % 1000 ) * 1000;
+
+    int rc = select( fd + 1, &rfds, NULL, NULL, &tv );
+    if ( rc <= 0 )
+        return rc;
+
+    return read( fd, buf, len );
+#endif
+    }
+
+bool HPI_Link::Write( const unsigned char* buf, int len )
+{
+#ifdef _WIN32
+    DWORD wr = 0;
+    return WriteFile( handle, buf, len, &wr, NULL ) && int( wr ) == len;
+#else
+    while ( len > 0 )
+    {
+        int rc = write( fd, buf, len );
+        if ( rc < 0 )
+            return false;
+        buf += rc;
+        len -= rc;
+        }
+    return true;
+#endif
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HPI_Link::Queue( int octet )
+{
+    if ( txq_len >= TX_QUEUE && ! Flush () )
+        return false;
+
+    txq[ txq_len++ ] = octet;
+    return true;
+    }
+
+bool HPI_Link::QueueWord( unsigned int word )
+{
+    return Queue( ( word >> 8 ) & 0xFF ) && Queue( word & 0xFF );
+    }
+
+bool HPI_Link::Flush( void )
+{
+    int len = txq_len;
+    txq_len = 0;
+
+    return len == 0 || Write( txq, len );
+    }
+
+bool HPI_Link::GetReply( unsigned char* buf, int len )
+{
+    if ( ! Flush () )
+        return false;
+
+    while ( len > 0 )
+    {
+        int rc = Read( buf, len, timeout_ms );
+        if ( rc <= 0 )
+            return false;
+        buf += rc;
+        len -= rc;
+        }
+
+    return true;
+    }
+
+bool HPI_Link::Sync( void )
+{
+    // Replies to commands before SYNC are discarded
+    //
+    for ( int attempt = 0; attempt < 2; attempt++ )
+    {
+        if ( attempt > 0 )
+        {
+            // The device may be inside a block command: complete it with
+            // NOPs (at most COUNT and 65535 words), see HostCmd.h
+            //
+            for ( long i = 0; i < 3 + 2L * MAX_BLOCK; i++ )
+            {
+                if ( ! Queue( CMD_NOP ) )
+                    return false;
+                }
+            }
+
+        sync_tag = ( sync_tag + 1 ) & 0xFF;
+
+        if ( ! Queue( CMD_SYNC ) || ! Queue( sync_tag ) || ! Flush () )
+            return false;
+
+        unsigned char ch;
+        while ( Read( &ch, 1, timeout_ms ) == 1 )
+        {
+            if ( ch == sync_tag )
+                return true;
+            }
+        }
+
+    return false;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HPI_Link::SetHPIC( int value )
+{
+    return Queue( CMD_SET_HPIC ) && Queue( value );
+    }
+
+bool HPI_Link::SetAddress( unsigned int addr )
+{
+    return Queue( CMD_SET_HPIA ) && QueueWord( addr );
+    }
+
+bool HPI_Link::WriteWord( unsigned int word )
+{
+    return Queue( CMD_WRITE ) && QueueWord( word );
+    }
+
+bool HPI_Link::WriteBlock( unsigned int addr, const unsigned short* words, long count )
+{
+    while ( count > 0 )
+    {
+        // Every block starts with a non-incrementing write, so HPIA is set
+        // for each one
+        //
+        long n = count < MAX_BLOCK ? count : long( MAX_BLOCK );
+
+        if ( ! SetAddress( addr ) || ! Queue( CMD_WRITE_BLOCK ) || ! QueueWord( n ) )
+            return false;
+
+        for ( long i = 0; i < n; i++ )
+        {
+            if ( ! QueueWord( words[ i ] ) )
+                return false;
+            }
+
+        addr += n;
+        words += n;
+        count -= n;
+        }
+
+    return true;
+    }
+
+bool HPI_Link::Reset( void )
+{
+    return Queue( CMD_RESET );
+    }
+
+bool HPI_Link::Start( unsigned int entry )
+{
+    return Queue( CMD_START ) && QueueWord( entry );
+    }
+
+bool HPI_Link::RequestCRC( unsigned int addr, long count )
+{
+    if ( count > MAX_BLOCK )
+        return false;
+
+    return SetAddress( addr ) && Queue( CMD_CRC ) && QueueWord( count );
+    }
+
+bool HPI_Link::GetCRC( unsigned int& crc )
+{
+    unsigned char rsp[ 2 ];
+
+    if ( ! GetReply( rsp, 2 ) )
+        return false;
+
+    crc = ( rsp[ 0 ] << 8 ) | rsp[ 1 ];
+    return true;
+    }
+
+unsigned int HPI_Link::CRC( unsigned int crc, const unsigned short* words, long count )
+{
+    for ( long i = 0; i < 2 * count; i++ )
+    {
+        // Same as HOSTCMD::CRC_Update
+        //
+        unsigned int octet = i & 1 ? words[ i / 2 ] & 0xFF : words[ i / 2 ] >> 8;
+
+        crc = ( ( crc >> 8 ) | ( crc << 8 ) ) & 0xFFFF;
+        crc ^= octet;
+        crc ^= ( crc & 0xFF ) >> 4;
+        crc ^= ( crc << 12 ) & 0xFFFF;
+        crc ^= ( crc & 0xFF ) << 5;
+        }
+
+    return crc;
+    }
+
+bool HPI_Link::GetHPIC( unsigned int& hpic )
+{
+    unsigned char rsp[ 2 ];
+
+    if ( ! Queue( CMD_GET_HPIC ) || ! GetReply( rsp, 2 ) )
+        return false;
+
+    hpic = ( rsp[ 0 ] << 8 ) | rsp[ 1 ];
+    return true;
+    }
+
+bool HPI_Link::ReadWord( unsigned int& word )
+{
+    unsigned char rsp[ 2 ];
+
+    if ( ! Queue( CMD_READ ) || ! GetReply( rsp, 2 ) )
+        return false;
+
+    word = ( rsp[ 0 ] << 8 ) | rsp[ 1 ];
+    return true;
+    }
+
+bool HPI_Link::ReadBlock( unsigned int addr, unsigned short* words, long count )
+{
+    // All block commands are sent before the replies are read, so the
+    // device streams without waiting for the host
+    //
+    if ( ! SetAddress( addr ) )
+        return false;
+
+    for ( long left = count; left > 0; left -= MAX_BLOCK )
+    {
+        long n = left < MAX_BLOCK ? left : long( MAX_BLOCK );
+
+        if ( ! Queue( CMD_READ_BLOCK ) || ! QueueWord( n ) )
+            return false;
+        }
+
+    while ( count > 0 )
+    {
+        unsigned char rsp[ 2048 ];
+
+        int n = count < long( sizeof( rsp ) / 2 ) ? int( count ) : int( sizeof( rsp ) / 2 );
+
+        if ( ! GetReply( rsp, 2 * n ) )
+            return false;
+
+        for ( int i = 0; i < n; i++ )
+            words[ i ] = ( rsp[ 2 * i ] << 8 ) | rsp[ 2 * i + 1 ];
+
+        words += n;
+        count -= n;
+        }
+
+    return true;
+    }
+
+bool HPI_Link::WaitHINT( int wait_ms, bool& asserted )
+{
+    unsigned char rsp;
+
+    if ( ! Queue( CMD_WAIT_HINT ) || ! QueueWord( wait_ms ) )
+        return false;
+
+    int saved = timeout_ms;
+    timeout_ms += wait_ms;
+
+    bool ok = GetReply( &rsp, 1 );
+
+    timeout_ms = saved;
+
+    if ( ok )
+        asserted = rsp != 0;
+
+    return ok;
+    }
+
+bool HPI_Link::Benchmark( unsigned int addr, unsigned int count, unsigned long cycles[ BM_COUNT ] )
+{
+    unsigned char rsp[ 4 * BM_COUNT ];
+
+    if ( ! Queue( CMD_BENCHMARK ) || ! QueueWord( addr ) || ! QueueWord( count )
+        || ! GetReply( rsp, sizeof( rsp ) ) )
+    {
+        return false;
+        }
+
+    for ( int i = 0; i < BM_COUNT; i++ )
+    {
+        const unsigned char* p = rsp + 4 * i;
+        cycles[ i ] = ( (unsigned long)p[ 0 ] << 24 ) | ( (unsigned long)p[ 1 ] << 16 )
+            | ( p[ 2 ] << 8 ) | p[ 3 ];
+        }
+
+    return true;
+    }
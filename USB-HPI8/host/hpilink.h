@@ -0,0 +1,136 @@
+#ifndef _HPILINK_H_INCLUDED
+#define _HPILINK_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+// HPI_Link Class: Host side of the USB-HPI8 command protocol
+//
+// Talks to USB-HPI8 through the FT245 virtual COM port; see HostCmd.h in the
+// firmware for the commands. Commands without reply are queued and sent in
+// large writes; a command with reply flushes the queue and waits for the
+// reply, so a whole sequence of writes costs one USB round trip.
+//
+class HPI_Link
+{
+public:
+
+    enum // Opcodes, as in HostCmd.h
+    {
+        CMD_NOP           = 0x00,
+        CMD_SYNC          = 0x01,
+        CMD_SET_HPIC      = 0x02,
+        CMD_GET_HPIC      = 0x03,
+        CMD_SET_HPIA      = 0x04,
+        CMD_READ          = 0x05,
+        CMD_WRITE         = 0x06,
+        CMD_READ_BLOCK    = 0x07,
+        CMD_WRITE_BLOCK   = 0x08,
+        CMD_RESET         = 0x09,
+        CMD_WAIT_HINT     = 0x0A,
+        CMD_CRC           = 0x0B,
+        CMD_START         = 0x0C,
+        CMD_BENCHMARK     = 0x0D,
+
+        RSP_ERROR         = 0xEE
+        };
+
+    enum // HPIC bits
+    {
+        HPIC_HINT         = 0x08,   // Write 1 to acknowledge HINT
+        HPIC_XHPIA        = 0x10    // HPIA writes go to XHPIA
+        };
+
+    enum // instead of #defines
+    {
+        MCU_CLOCK         = 7372800,    // USB-HPI8 CPU clock, Hz
+        BOOT_ENTRY        = 0x007F,     // Entry point word of DSP HPI boot loader
+        MAX_BLOCK         = 65535,      // Words per block command
+        TX_QUEUE          = 4096        // Octets queued before write
+        };
+
+private:
+
+#ifdef _WIN32
+    void* handle;
+#else
+    int fd;
+#endif
+
+    unsigned char txq[ TX_QUEUE ];
+    int txq_len;
+
+    int sync_tag;
+    int timeout_ms;
+
+    int Read( unsigned char* buf, int len, int timeout_ms );
+    bool Write( const unsigned char* buf, int len );
+
+    bool Queue( int octet );
+    bool QueueWord( unsigned int word );
+
+    // Flushes queue and reads exactly len reply octets
+    //
+    bool GetReply( unsigned char* buf, int len );
+
+public:
+
+    HPI_Link( void );
+    virtual ~HPI_Link( void );
+
+    bool Open( const char* device );
+    void Close( void );
+
+    // Reply timeout
+    //
+    void SetTimeout( int p_timeout_ms )
+    {
+        timeout_ms = p_timeout_ms;
+        }
+
+    // Sends queued commands
+    //
+    bool Flush( void );
+
+    // Flushes queue and waits until all commands were executed; after a
+    // timeout or error, sends NOPs to resynchronize command stream
+    //
+    bool Sync( void );
+
+    // Queued commands, no reply
+    //
+    bool SetHPIC( int value );
+    bool SetAddress( unsigned int addr );
+    bool WriteWord( unsigned int word );
+    bool WriteBlock( unsigned int addr, const unsigned short* words, long count );
+    bool Reset( void );
+    bool Start( unsigned int entry );
+
+    // Requests CRC of count words (at most MAX_BLOCK) from addr on; the
+    // CRCs are read with GetCRC() in the same order, so any number of
+    // blocks are checked in one round trip
+    //
+    bool RequestCRC( unsigned int addr, long count );
+    bool GetCRC( unsigned int& crc );
+
+    // CRC-16 (CCITT) as computed by USB-HPI8, preset 0xFFFF
+    //
+    static unsigned int CRC( unsigned int crc, const unsigned short* words, long count );
+
+    // Commands with reply; false on timeout
+    //
+    bool GetHPIC( unsigned int& hpic );
+    bool ReadWord( unsigned int& word );
+    bool ReadBlock( unsigned int addr, unsigned short* words, long count );
+    bool WaitHINT( int wait_ms, bool& asserted );
+
+    enum // Benchmark results
+    {
+        BM_READ, BM_READ_BURST, BM_WRITE, BM_WRITE_BURST, BM_COUNT
+        };
+
+    // HPI access of count words from addr (not 0) on in USB-HPI8 CPU
+    // cycles, without USB transfer; the memory is written back as read
+    //
+    bool Benchmark( unsigned int addr, unsigned int count, unsigned long cycles[ BM_COUNT ] );
+    };
+
+#endif // _HPILINK_H_INCLUDED
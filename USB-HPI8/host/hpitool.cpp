@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include "hpilink.h"
+#include "coff.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static long Milliseconds( void )
+{
+#ifdef _WIN32
+    return long( GetTickCount () );
+#else
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+#endif
+    }
+
+static unsigned int Number( const char* str )
+{
+    return (unsigned int)strtoul( str, NULL, 0 );
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+// Downloads COFF executable into the DSP through the HPI boot loader, and
+// starts it. All sections are streamed, then their CRCs are read back, in
+// one round trip each; the program is only started if every CRC matches.
+//
+static int Boot( HPI_Link& hpi, const char* filename, int wait_ms )
+{
+    COFF_File coff;
+
+    if ( ! coff.Load( filename ) )
+    {
+        fprintf( stderr, "%s: %s\n", filename, coff.GetError () );
+        return -1;
+        }
+
+    unsigned long entry = 0;
+
+    if ( ! coff.GetEntry( entry ) || entry == 0 || entry > 0xFFFF )
+    {
+        fprintf( stderr, "%s: No entry point for HPI boot\n", filename );
+        return -1;
+        }
+
+    long start = Milliseconds ();
+
+    // Reset DSP, wait for boot loader, then clear XHPIA and acknowledge HINT
+    //
+    bool hint = false;
+
+    if ( ! hpi.Reset () || ! hpi.WaitHINT( wait_ms, hint ) )
+    {
+        fprintf( stderr, "No response\n" );
+        return -1;
+        }
+
+    if ( ! hint )
+    {
+        fprintf( stderr, "DSP boot loader not ready (no HINT)\n" );
+        return -1;
+        }
+
+    hpi.SetHPIC( HPI_Link::HPIC_XHPIA );
+    hpi.SetAddress( 0x0000 );
+    hpi.SetHPIC( HPI_Link::HPIC_HINT );
+
+    long words = 0;
+
+    for ( int i = 0; i < coff.GetSectionCount (); i++ )
+    {
+        const COFF_File::Section& s = coff.GetSection( i );
+
+        if ( ! hpi.WriteBlock( s.addr, s.data, s.size ) )
+        {
+            fprintf( stderr, "No response\n" );
+            return -1;
+            }
+
+        words += s.size;
+        }
+
+    // Verify
+    //
+    for ( int i = 0; i < coff.GetSectionCount (); i++ )
+    {
+        const COFF_File::Section& s = coff.GetSection( i );
+
+        for ( long p = 0; p < s.size; p += HPI_Link::MAX_BLOCK )
+        {
+            long n = s.size - p < HPI_Link::MAX_BLOCK ? s.size - p : long( HPI_Link::MAX_BLOCK );
+            hpi.RequestCRC( s.addr + p, n );
+            }
+        }
+
+    bool verified = true;
+
+    for ( int i = 0; i < coff.GetSectionCount (); i++ )
+    {
+        const COFF_File::Section& s = coff.GetSection( i );
+
+        bool ok = true;
+
+        for ( long p = 0; p < s.size; p += HPI_Link::MAX_BLOCK )
+        {
+            long n = s.size - p < HPI_Link::MAX_BLOCK ? s.size - p : long( HPI_Link::MAX_BLOCK );
+
+            unsigned int crc = 0;
+
+            if ( ! hpi.GetCRC( crc ) )
+            {
+                fprintf( stderr, "No response\n" );
+                return -1;
+                }
+
+            if ( crc != HPI_Link::CRC( 0xFFFF, s.data + p, n ) )
+                ok = false;
+            }
+
+        printf( "%-12s page %d  %04lX..%04lX  %6ld words  %s\n", s.name, s.page,
+            s.addr, s.addr + s.size - 1, s.size, ok ? "OK" : "CRC ERROR" );
+
+        if ( ! ok )
+            verified = false;
+        }
+
+    if ( ! verified )
+    {
+        fprintf( stderr, "Verification failed, DSP not started\n" );
+        return -1;
+        }
+
+    if ( ! hpi.Start( entry ) || ! hpi.Sync () )
+    {
+        fprintf( stderr, "No response\n" );
+        return -1;
+        }
+
+    long elapsed = Milliseconds () - start;
+
+    printf( "Started at %04lX, %ld words in %ld ms\n", entry, words, elapsed );
+    return 0;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+// Prints HPI access rates of single word and burst access, as measured by
+// USB-HPI8, and block transfer rates including USB
+//
+static int Bench( HPI_Link& hpi, unsigned int addr, unsigned int count )
+{
+    static const char* names[ HPI_Link::BM_COUNT ] =
+    {
+        "read", "read burst", "write", "write burst"
+        };
+
+    unsigned long cycles[ HPI_Link::BM_COUNT ];
+
+    if ( ! hpi.Benchmark( addr, count, cycles ) )
+    {
+        fprintf( stderr, "No response\n" );
+        return -1;
+        }
+
+    printf( "HPI, %u words:\n", count );
+
+    for ( int i = 0; i < HPI_Link::BM_COUNT; i++ )
+    {
+        double per_word = double( cycles[ i ] ) / count;
+
+        printf( "  %-12s %8lu cycles  %6.1f cycles/word  %8.0f words/s\n",
+            names[ i ], cycles[ i ], per_word,
+            cycles[ i ] ? HPI_Link::MCU_CLOCK / per_word : 0.0 );
+        }
+
+    // Same words read and written back through USB
+    //
+    unsigned short* words = new unsigned short[ count ];
+
+    long t0 = Milliseconds ();
+    bool ok = hpi.ReadBlock( addr, words, count );
+    long t1 = Milliseconds ();
+    ok = ok && hpi.WriteBlock( addr, words, count ) && hpi.Sync ();
+    long t2 = Milliseconds ();
+
+    delete[] words;
+
+    if ( ! ok )
+    {
+        fprintf( stderr, "No response\n" );
+        return -1;
+        }
+
+    printf( "USB + HPI, %u words:\n", count );
+    printf( "  %-12s %8ld ms  %8.0f words/s\n", "read block", t1 - t0,
+        t1 > t0 ? count * 1000.0 / ( t1 - t0 ) : 0.0 );
+    printf( "  %-12s %8ld ms  %8.0f words/s\n", "write block", t2 - t1,
+        t2 > t1 ? count * 1000.0 / ( t2 - t1 ) : 0.0 );
+
+    return 0;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Usage( void )
+{
+    fprintf( stderr,
+        "Usage: hpitool <device> reset [timeout_ms]\n"
+        "       hpitool <device> hpic [value]\n"
+        "       hpitool <device> peek <addr> [count]\n"
+        "       hpitool <device> poke <addr> <word> [word ...]\n"
+        "       hpitool <device> dump <addr> <count> <outfile>\n"
+        "       hpitool <device> load <addr> <infile>\n"
+        "       hpitool <device> boot <coff-file> [timeout_ms]\n"
+        "       hpitool <device> bench <addr> [count]\n"
+        "\n"
+        "Numbers may be given in hex (0x...). Files hold 16-bit words, MSB first.\n"
+        );
+    }
+
+int main( int argc, char** argv )
+{
+    if ( argc < 3 )
+    {
+        Usage ();
+        return -1;
+        }
+
+    const char* device = argv[ 1 ];
+    const char* cmd = argv[ 2 ];
+
+    HPI_Link hpi;
+
+    if ( ! hpi.Open( device ) )
+    {
+        fprintf( stderr, "Cannot open %s\n", device );
+        return -1;
+        }
+
+    if ( ! hpi.Sync () )
+    {
+        fprintf( stderr, "No response\n" );
+        return -1;
+        }
+
+    if ( strcmp( cmd, "reset" ) == 0 )
+    {
+        // Resets DSP and waits for its HPI boot loader
+        //
+        int wait_ms = argc >= 4 ? Number( argv[ 3 ] ) : 1000;
+        bool hint = false;
+
+        if ( ! hpi.Reset () || ! hpi.WaitHINT( wait_ms, hint ) )
+        {
+            fprintf( stderr, "No response\n" );
+            return -1;
+            }
+
+        printf( "HINT %s\n", hint ? "asserted" : "not asserted" );
+        return hint ? 0 : -1;
+        }
+
+    if ( strcmp( cmd, "boot" ) == 0 && argc >= 4 )
+    {
+        return Boot( hpi, argv[ 3 ], argc >= 5 ? Number( argv[ 4 ] ) : 1000 );
+        }
+
+    if ( strcmp( cmd, "bench" ) == 0 && argc >= 4 )
+    {
+        unsigned int addr = Number( argv[ 3 ] );
+        unsigned int count = argc >= 5 ? Number( argv[ 4 ] ) : 4096;
+
+        if ( addr == 0 || count == 0 || count > HPI_Link::MAX_BLOCK )
+        {
+            fprintf( stderr, "Address must not be 0, count 1..%d\n", HPI_Link::MAX_BLOCK );
+            return -1;
+            }
+
+        return Bench( hpi, addr, count );
+        }
+
+    if ( strcmp( cmd, "hpic" ) == 0 )
+    {
+        unsigned int hpic = 0;
+
+        if ( ( argc >= 4 && ! hpi.SetHPIC( Number( argv[ 3 ] ) ) )
+            || ! hpi.GetHPIC( hpic ) )
+        {
+            fprintf( stderr, "No response\n" );
+            return -1;
+            }
+
+        printf( "HPIC = 0x%04X\n", hpic );
+        return 0;
+        }
+
+    if ( strcmp( cmd, "peek" ) == 0 && argc >= 4 )
+    {
+        unsigned int addr = Number( argv[ 3 ] );
+        long count = argc >= 5 ? Number( argv[ 4 ] ) : 1;
+
+        unsigned short* words = new unsigned short[ count ];
+
+        if ( ! hpi.ReadBlock( addr, words, count ) )
+        {
+            fprintf( stderr, "No response\n" );
+            delete[] words;
+            return -1;
+            }
+
+        for ( long i = 0; i < count; i++ )
+        {
+            if ( i % 8 == 0 )
+                printf( "%s%04lX:", i ? "\n" : "", ( addr + i ) & 0xFFFF );
+            printf( " %04X", words[ i ] );
+            }
+        printf( "\n" );
+
+        delete[] words;
+        return 0;
+        }
+
+    if ( strcmp( cmd, "poke" ) == 0 && argc >= 5 )
+    {
+        unsigned int addr = Number( argv[ 3 ] );
+        int count = argc - 4;
+
+        unsigned short* words = new unsigned short[ count ];
+
+        for ( int i = 0; i < count; i++ )
+            words[ i ] = Number( argv[ 4 + i ] );
+
+        bool ok = hpi.WriteBlock( addr, words, count ) && hpi.Sync ();
+
+        delete[] words;
+
+        if ( ! ok )
+        {
+            fprintf( stderr, "No response\n" );
+            return -1;
+            }
+
+        return 0;
+        }
+
+    if ( strcmp( cmd, "dump" ) == 0 && argc >= 6 )
+    {
+        unsigned int addr = Number( argv[ 3 ] );
+        long count = Number( argv[ 4 ] );
+
+        FILE* f = fopen( argv[ 5 ], "wb" );
+        if ( ! f )
+        {
+            fprintf( stderr, "Cannot create %s\n", argv[ 5 ] );
+            return -1;
+            }
+
+        unsigned short* words = new unsigned short[ count ];
+
+        bool ok = hpi.ReadBlock( addr, words, count );
+
+        for ( long i = 0; ok && i < count; i++ )
+        {
+            fputc( words[ i ] >> 8, f );
+            fputc( words[ i ] & 0xFF, f );
+            }
+
+        fclose( f );
+        delete[] words;
+
+        if ( ! ok )
+        {
+            fprintf( stderr, "No response\n" );
+            return -1;
+            }
+
+        return 0;
+        }
+
+    if ( strcmp( cmd, "load" ) == 0 && argc >= 5 )
+    {
+        unsigned int addr = Number( argv[ 3 ] );
+
+        FILE* f = fopen( argv[ 4 ], "rb" );
+        if ( ! f )
+        {
+            fprintf( stderr, "Cannot open %s\n", argv[ 4 ] );
+            return -1;
+            }
+
+        fseek( f, 0, SEEK_END );
+        long count = ftell( f ) / 2;
+        fseek( f, 0, SEEK_SET );
+
+        unsigned short* words = new unsigned short[ count ];
+
+        for ( long i = 0; i < count; i++ )
+        {
+            int H = fgetc( f );
+            words[ i ] = ( H << 8 ) | fgetc( f );
+            }
+
+        fclose( f );
+
+        bool ok = hpi.WriteBlock( addr, words, count ) && hpi.Sync ();
+
+        delete[] words;
+
+        if ( ! ok )
+        {
+            fprintf( stderr, "No response\n" );
+            return -1;
+            }
+
+        printf( "Loaded %ld words at %04X\n", count, addr );
+        return 0;
+        }
+
+    Usage ();
+    return -1;
+    }
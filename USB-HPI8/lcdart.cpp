@@ -14,6 +14,9 @@
 #include "A2D.h"
 #include "Keyboard.h"
 #include "Cadence.h"
+#include "HPI.h"
+#include "USB.h"
+#include "HostCmd.h"
 
 /*
     MCU:    ATMega16
@@ -65,184 +68,6 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class HPI
-{
-public:
-
-    void Set_HRESET( void )
-    {
-        // HRESET# = LOW
-        PORTA &= ~_BV(PA5);
-        }
-
-    void Pulse_HRESET ()
-    {
-        // HRESET# = LOW
-        PORTA &= ~_BV(PA5);
-
-        // Wait 1us
-        _NOP (); _NOP (); _NOP (); _NOP ();
-        _NOP (); _NOP (); _NOP (); _NOP ();
-        _NOP (); _NOP (); _NOP (); _NOP ();
-        _NOP (); _NOP (); _NOP (); _NOP ();
-
-        // HRESET# = HIGH
-        PORTA |= _BV(PA5);
-        }
-
-    unsigned short Read( int cntl )
-    {
-        DDRC = 0x00; // DDRC input
-        PORTC = 0x00; // tri-state
-
-        // HCNTL0..1 = cntl & 0x03
-        PORTB &= ~_BV(PB1) & ~_BV(PB0);
-        PORTB |= ( cntl & 0x03 );
-
-        // HDS# = HIGH, HR/W# = HIGH
-        PORTA |= _BV(PA4) | _BV(PA3);
-
-        // HCS# = LOW
-        PORTA &= ~_BV(PA6);
-
-        // HBIL = LOW
-        PORTA &= ~_BV(PA2);
-
-        // HDS# = LOW
-        PORTA &= ~_BV(PA4);
-        _NOP ();
-
-        // Read byte
-        unsigned short H = PINC;
-
-        // HDS# = HIGH
-        PORTA |= _BV(PA4);
-
-        // HBIL = HIGH
-        PORTA |= _BV(PA2);
-
-        // HDS# = LOW
-        PORTA &= ~_BV(PA4);
-        _NOP ();
-
-        // Read byte
-        unsigned short L = PINC;
-
-        // HDS# = HIGH
-        PORTA |= _BV(PA4);
-
-        // HCS# = HIGH
-        PORTA |= _BV(PA6);
-
-        return ( H << 8 ) | L;
-        }
-
-    void Write( int cntl, unsigned short value )
-    {
-        // HCNTL0..1 = cntl & 0x03
-        PORTB &= ~_BV(PB1) & ~_BV(PB0);
-        PORTB |= ( cntl & 0x03 );
-
-        // HDS# = HIGH, HR/W# = LOW
-        PORTA |= _BV(PA4);
-        PORTA &= ~_BV(PA3);
-
-        // HCS# = LOW
-        PORTA &= ~_BV(PA6);
-
-        // MSB
-        DDRC = 0xFF; // DDRC output
-        PORTC = ( value >> 8 ) & 0xFF;
-
-        // HBIL = 0
-        PORTA &= ~_BV(PA2);
-
-        // HDS# = LOW
-        PORTA &= ~_BV(PA4);
-
-        // HDS# = HIGH
-        PORTA |= _BV(PA4);
-
-        // LSB
-        PORTC = value & 0xFF;
-
-        // HBIL = 1
-        PORTA |= _BV(PA2);
-
-        // HDS# = LOW
-        PORTA &= ~_BV(PA4);
-
-        // HDS# = HIGH
-        PORTA |= _BV(PA4);
-
-        // HCS# = HIGH
-        PORTA |= _BV(PA6);
-
-        DDRC = 0x00; // DDRC input
-        PORTC = 0x00; // tri-state
-        }
-
-    void Put_HPIC( int value )
-    {
-        value &= 0x7F;
-        value = ( value << 8 ) | value;
-        Write( 0, value );
-        }
-
-    void Reset_DSP( void )
-    {
-        Pulse_HRESET ();
-
-        // Set XHPIA = 0x0000:0x1000
-        //
-        Put_HPIC( 0x10 );   // XHPIA = ON
-        Write( 2, 0x0000 ); // HPIA = 0x0000
-        Put_HPIC( 0x00 );   // XHPIA = OFF
-        Write( 2, 0x1000 ); // HPIA = 0x1000
-
-        // Wait HINT
-        //
-        for ( int i = 0; i < 10000; i++ )
-            if ( ( PINB & _BV(PB2) ) == 1 )
-                break;
-
-        // Acknowledge HINT
-        //
-        Put_HPIC( 0x08 );
-        }
-
-    unsigned short Initialize( void )
-    {
-        Reset_DSP ();
-
-        // Download program @ 0x1000
-        //
-        Write( 3, 0x10F8 ); // LD *(0x003E), A
-        Write( 1, 0x003E );
-
-        Write( 1, 0x80F8 ); // STL A, *(0x1100)
-        Write( 1, 0x1100 );
-
-        Write( 1, 0xF073 ); // L1: B L1
-        Write( 1, 0x1004 );
-
-        Write( 2, 0x1100 ); // *(0x1100) = 0xFFFF
-        Write( 3, 0xFFFF );
-
-        Write( 2, 0x007E ); // Run program @0x1000
-        Write( 3, 0x0000 );
-        Write( 1, 0x1000 ); 
-
-        Write( 2, 0x1100 ); // Get ID from *(0x1100)
-        unsigned short ID = Read( 3 );
-
-        Reset_DSP ();
-        return ID;
-        }
-    };
-
-///////////////////////////////////////////////////////////////////////////////
-
 volatile uint16_t Timer0_Counter = 0;
 volatile bool Timer0_Event = false;
 
@@ -289,30 +114,6 @@ void Timer2_Initialize( void )
 
 bool isSoftReset = false;
 
-
-inline void usb_Put( int ch )
-{
-    PORTC = ch;
-    DDRC = 0xFF; // PC0..7 output
-    _NOP ();
-
-    // WR = HIGH
-    PORTA |= _BV(PA0);
-
-    // WR = LOW
-    PORTA &= ~_BV(PA0);
-
-    PORTC = 0x00; // tri-state
-    DDRC = 0x00; // PC0..7 input
-    _NOP ();
-    }
-
-void usb_Put( char* str )
-{
-    while ( *str )
-        usb_Put( *str++ );
-    }
-
 HPI hpi;
 
 int
@@ -341,7 +142,6 @@ main( void )
 
     usart.Initialize ();
     usart << "---------------\r\n";
-    usb_Put( "---------------\r\n" );
 
     usart << "DSP TMS320VC54: " << hpi.Initialize () << "\r\n";
 
@@ -349,16 +149,16 @@ main( void )
     usart << "[" << hpi.Read( 1 ) << ",";
     usart << hpi.Read( 1 ) << "]\r\n";
 
+    Timer0_Initialize (); // Timeouts of host commands
+
+    // USB is for host commands only (see HostCmd.h); they are executed
+    // as they arrive
+    //
     for ( ;; )
     {
-        usart << "HPIC = " << hpi.Read( 0 ) << "\r\n";
-
-        for ( long i = 0; i < 500000; i++ )
-            _NOP ();
+        hostcmd.Execute ();
 
         PORTD ^= _BV(PD4);
-
-        usb_Put( "Hello, world\r\n" );
         }
 
 
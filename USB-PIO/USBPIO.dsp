@@ -94,6 +94,38 @@ SOURCE=.\usbpio.cpp
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=.\bert.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\bstream.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\clockmon.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\dstream.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\hostcmd.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\lapd.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\trace.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\usblink.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\xhfc.h
 # End Source File
 # End Group
@@ -0,0 +1,333 @@
+#ifndef _BERT_H_INCLUDED
+#define _BERT_H_INCLUDED
+
+#include "usblink.h"
+
+extern bool usb_TxReady( void );
+
+extern class XHFC hfc;
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Bit error rate tester for transparent B-Channels
+//
+// A channel under test (numbered port * 2 + bc, as in bstream.h) is taken
+// from B_Stream: its TX FIFO service gets a pseudo random bit sequence
+// (PRBS 2^11-1, x^11 + x^9 + 1, or 2^15-1, x^15 + x^14 + 1, as in O.150)
+// and its RX FIFO service is checked against the same sequence. The far
+// end loops the B-Channel back (loopback call), or a second channel under
+// test is on the other end of the line; the checker synchronizes to any
+// phase of the sequence.
+//
+// The generator and the checker reference run octet-wise: 8 sequence bits
+// per step, first bit in bit 7. The checker loads received octets until
+// SYNC_OCTETS octets in a row are predicted; then it runs free and counts
+// differing bits as errors. An octet which was repeated or skipped (jitter
+// buffer slip, at either end) is counted as slip instead, and the
+// reference is moved along. More than LOSS_ERRORS bit errors in one FIFO
+// service lose the sync.
+//
+// A BERT record per channel under test is sent every second; it is skipped
+// (gap in SEQ) when the USB FIFO is full, e.g. without host.
+//
+class BER_Tester
+{
+/*
+    BERT frame (USB-PIO -> Host), ADDR = channel:
+
+    +---+---+---+---+---+---+---+---+
+    |            PATTERN            |  PRBS_11 or PRBS_15
+    +---+---+---+---+---+---+---+---+
+    |             FLAGS             |  FL_SYNC
+    +---+---+---+---+---+---+---+---+
+    |              SEQ              |  Record number, mod 256
+    +---+---+---+---+---+---+---+---+
+    |       BITS HI, BITS LO        |  Bits checked in period
+    +---+---+---+---+---+---+---+---+
+    |     ERRORS HI, ERRORS LO      |  Bit errors in period
+    +---+---+---+---+---+---+---+---+
+    |      SLIPS HI, SLIPS LO       |  Octet slips in period
+    +---+---+---+---+---+---+---+---+
+    |     LOSSES HI, LOSSES LO      |  Sync losses in period
+    +---+---+---+---+---+---+---+---+
+    |     TOTAL BITS (4 octets)     |  Since start (MSB first)
+    +---+---+---+---+---+---+---+---+
+    |    TOTAL ERRORS (4 octets)    |  Since start
+    +---+---+---+---+---+---+---+---+
+    |  ERRORED SECONDS HI, ... LO   |  Since start
+    +---+---+---+---+---+---+---+---+
+    |      SECONDS HI, SECONDS LO   |  Since start
+    +---+---+---+---+---+---+---+---+
+
+    Bits are only checked in sync. A period is errored if it has bit
+    errors, slips or sync losses, or if it ended out of sync. FL_SYNC: the
+    checker is in sync at the end of the period. RX octets discarded by
+    the FIFO service (RX overrun) count as sync loss.
+*/
+
+public:
+
+    enum // Patterns
+    {
+        PRBS_OFF          = 0,
+        PRBS_11           = 11,     // 2^11-1, x^11 + x^9 + 1
+        PRBS_15           = 15      // 2^15-1, x^15 + x^14 + 1
+        };
+
+    enum // BERT flags
+    {
+        FL_SYNC           = 0x01
+        };
+
+private:
+
+    enum // instead of #defines
+    {
+        MAX_CHANNELS      = 2 * XHFC_MAX_PORTS,
+        SYNC_OCTETS       = 4,      // Octets predicted in a row to sync
+        LOSS_ERRORS       = 16      // Bit errors in one FIFO service to lose sync
+        };
+
+    struct Channel
+    {
+        unsigned char pattern;      // PRBS_*, PRBS_OFF if not under test
+        bool sync;
+        unsigned char good;         // Octets predicted in a row while hunting
+        unsigned char seq;
+
+        unsigned int tx_reg;        // Generator shift register
+        unsigned int rx_reg;        // Checker reference
+
+        // Current period
+        //
+        unsigned int bits;
+        unsigned int errors;
+        unsigned int slips;
+        unsigned int losses;
+
+        // Since start
+        //
+        unsigned long total_bits;
+        unsigned long total_errors;
+        unsigned int errored_secs;
+        unsigned int seconds;
+        };
+
+    USB_Link& link;
+    Channel ch[ MAX_CHANNELS ];
+
+    static void PutLong( unsigned char* p, unsigned long x )
+    {
+        p[ 0 ] = x >> 24;
+        p[ 1 ] = x >> 16;
+        p[ 2 ] = x >> 8;
+        p[ 3 ] = x;
+        }
+
+    static void PutWord( unsigned char* p, unsigned int x )
+    {
+        p[ 0 ] = x >> 8;
+        p[ 1 ] = x;
+        }
+
+    // Next 8 sequence bits after register reg (the last bits of the sequence)
+    //
+    static unsigned char Peek( int pattern, unsigned int reg )
+    {
+        if ( pattern == PRBS_15 )
+            return ( reg >> 7 ) ^ ( reg >> 6 ); // Taps 15, 14
+        else
+            return ( reg >> 3 ) ^ ( reg >> 1 ); // Taps 11, 9
+        }
+
+    static unsigned int Shift( int pattern, unsigned int reg, unsigned char octet )
+    {
+        return ( ( reg << 8 ) | octet ) & ( ( 1u << pattern ) - 1 );
+        }
+
+    static int CountBits( unsigned char x )
+    {
+        int n = 0;
+        for ( ; x; x &= x - 1 )
+            ++n;
+        return n;
+        }
+
+    void LoseSync( Channel& c )
+    {
+        if ( c.sync )
+            ++c.losses;
+
+        c.sync = false;
+        c.good = 0;
+        }
+
+    // Checks one received octet
+    //
+    void Check( Channel& c, unsigned char octet )
+    {
+        unsigned char expected = Peek( c.pattern, c.rx_reg );
+
+        if ( ! c.sync )
+        {
+            // Hunting: load received bits; a line stuck at zero would be
+            // predicted by the zero register, too
+            //
+            if ( octet == expected && c.rx_reg != 0 )
+            {
+                if ( ++c.good >= SYNC_OCTETS )
+                    c.sync = true;
+                }
+            else
+            {
+                c.good = 0;
+                }
+
+            c.rx_reg = Shift( c.pattern, c.rx_reg, octet );
+            return;
+            }
+
+        c.bits += 8;
+
+        if ( octet == expected )
+        {
+            c.rx_reg = Shift( c.pattern, c.rx_reg, expected );
+            return;
+            }
+
+        if ( octet == ( c.rx_reg & 0xFF ) )
+        {
+            // Previous octet repeated: reference stays
+            //
+            ++c.slips;
+            return;
+            }
+
+        unsigned int next = Shift( c.pattern, c.rx_reg, expected );
+
+        if ( octet == Peek( c.pattern, next ) )
+        {
+            // Octet skipped: reference moves by two
+            //
+            c.rx_reg = Shift( c.pattern, next, octet );
+            ++c.slips;
+            return;
+            }
+
+        c.errors += CountBits( octet ^ expected );
+        c.rx_reg = next;
+        }
+
+    void SendRecord( int chan )
+    {
+        Channel& c = ch[ chan ];
+
+        unsigned char rec[ 23 ];
+
+        rec[ 0 ] = c.pattern;
+        rec[ 1 ] = c.sync ? FL_SYNC : 0;
+        rec[ 2 ] = c.seq++;
+        PutWord( rec + 3, c.bits );
+        PutWord( rec + 5, c.errors );
+        PutWord( rec + 7, c.slips );
+        PutWord( rec + 9, c.losses );
+
+        c.total_bits += c.bits;
+        c.total_errors += c.errors;
+        ++c.seconds;
+
+        if ( c.errors || c.slips || c.losses || ! c.sync )
+            ++c.errored_secs;
+
+        PutLong( rec + 11, c.total_bits );
+        PutLong( rec + 15, c.total_errors );
+        PutWord( rec + 19, c.errored_secs );
+        PutWord( rec + 21, c.seconds );
+
+        if ( usb_TxReady () )
+            link.SendFrame( USB_Link::FRM_CTL_BERT, chan, rec, sizeof( rec ) );
+
+        c.bits = c.errors = c.slips = c.losses = 0;
+        }
+
+public:
+
+    BER_Tester( USB_Link& p_link )
+        : link( p_link )
+    {
+        memset( ch, 0, sizeof( ch ) );
+        }
+
+    bool IsRunning( int chan ) const
+    {
+        return chan < MAX_CHANNELS && ch[ chan ].pattern != PRBS_OFF;
+        }
+
+    // Starts test with pattern, or stops it with PRBS_OFF; false if
+    // pattern is not supported
+    //
+    bool Start( int chan, int pattern )
+    {
+        if ( chan >= MAX_CHANNELS
+            || ( pattern != PRBS_OFF && pattern != PRBS_11 && pattern != PRBS_15 ) )
+        {
+            return false;
+            }
+
+        memset( &ch[ chan ], 0, sizeof( Channel ) );
+
+        ch[ chan ].pattern = pattern;
+        ch[ chan ].tx_reg = 1;
+
+        return true;
+        }
+
+    // Data read from B-Channel RX FIFO (data == 0 if FIFO held too few octets)
+    //
+    void OnRxData( int chan, const unsigned char* data, int len, int discarded )
+    {
+        Channel& c = ch[ chan ];
+
+        if ( discarded )
+            LoseSync( c );
+
+        if ( ! data )
+            return;
+
+        unsigned int errors = c.errors;
+
+        for ( int i = 0; i < len; i++ )
+            Check( c, data[ i ] );
+
+        if ( c.sync && c.errors - errors > LOSS_ERRORS )
+            LoseSync( c );
+        }
+
+    // Data about to be written to B-Channel TX FIFO
+    //
+    void OnTxData( int chan, unsigned char* data, int len )
+    {
+        Channel& c = ch[ chan ];
+
+        for ( int i = 0; i < len; i++ )
+        {
+            data[ i ] = Peek( c.pattern, c.tx_reg );
+            c.tx_reg = Shift( c.pattern, c.tx_reg, data[ i ] );
+            }
+        }
+
+    // Sends BERT records of channels under test; called every second
+    // from main loop
+    //
+    void SendRecords( void )
+    {
+        for ( int chan = 0; chan < 2 * hfc.GetPortCount (); chan++ )
+        {
+            if ( ch[ chan ].pattern != PRBS_OFF )
+                SendRecord( chan );
+            }
+        }
+    };
+
+extern BER_Tester bert;
+
+#endif // _BERT_H_INCLUDED
@@ -0,0 +1,285 @@
+#ifndef _BSTREAM_H_INCLUDED
+#define _BSTREAM_H_INCLUDED
+
+#include "usblink.h"
+
+extern class XHFC hfc;
+extern bool usb_TxReady( void );
+
+//////////////////////////////////////////////////////////////////////////////////////
+// B-Channel audio streaming between host and XHFC FIFOs
+//
+// Channels are numbered port * 2 + bc. Every B-Channel FIFO service moves
+// B_CH_BUFSIZE octets (1ms of 64 kbit/s audio). Received chunks are queued
+// by the bottom half in a per-channel ring and sent to the host from the
+// main loop by Poll(), one AUDIO frame per chunk, while the USB FIFO
+// accepts data. Audio from the host is kept in a small per-channel ring,
+// which is drained by the 1ms TX FIFO service.
+//
+class B_Stream
+{
+/*
+    AUDIO frame (both directions), ADDR = channel:
+
+    +---+---+---+---+---+---+---+---+
+    |              SEQ              |  Per channel and direction, mod 256
+    +---+---+---+---+---+---+---+---+
+    |            SAMPLES            |  Transparent B-Channel octets
+    +---+---+---+---+---+---+---+---+
+
+    Host -> USB-PIO:
+
+        First AUDIO frame for a channel starts streaming; samples may be
+        omitted (e.g. to record only). AUDIO frame without data (no SEQ)
+        stops streaming. Gaps in SEQ are counted as sequence errors.
+
+    USB-PIO -> Host:
+
+        Sent for every B_CH_BUFSIZE octets read from the RX FIFO while the
+        channel is streaming. Chunks dropped because the RX ring was full
+        are skipped in SEQ.
+
+    AUDIO_STATS frame (USB-PIO -> Host), ADDR = channel, one per channel:
+
+        STREAMING, TX FILL, RX UNDERRUN, RX OVERRUN, TX UNDERRUN,
+        TX OVERRUN, SEQ ERRORS, RX FIFO LEVEL, TX FIFO LEVEL,
+        RX SLIPS INSERTED, RX SLIPS DELETED, TX SLIPS INSERTED,
+        TX SLIPS DELETED
+
+    RX UNDERRUN:  RX FIFO held less than B_CH_BUFSIZE octets
+    RX OVERRUN:   octets discarded from RX FIFO or RX ring (in octets)
+    TX UNDERRUN:  host audio did not arrive in time; silence was sent
+    TX OVERRUN:   host audio did not fit into the ring (in octets)
+    FIFO LEVEL:   smoothed XHFC FIFO level (octets) seen by jitter buffer
+    SLIPS:        single samples inserted/deleted by jitter buffer
+
+    Counters are 16-bit words, MSB first.
+*/
+
+    enum // instead of #defines
+    {
+        MAX_CHANNELS      = 2 * XHFC_MAX_PORTS, // 2 B-Channels per S/U port
+        TX_RING_SIZE      = 32,   // 4ms of audio; must be power of 2
+        TX_PRIME_LEVEL    = 16,   // Fill level to start playing
+        RX_CHUNK          = 8,    // Octets per AUDIO frame (= B_CH_BUFSIZE)
+        RX_RING_CHUNKS    = 4,    // 4ms of audio; must be power of 2
+        SILENCE           = 0xFF
+        };
+
+    struct Channel
+    {
+        bool streaming;
+        bool tx_primed;           // Ring has been filled up to TX_PRIME_LEVEL
+
+        unsigned char rx_seq;     // Next SEQ to host
+        unsigned char tx_seq;     // Expected SEQ from host
+
+        unsigned char tx_head;    // Write index
+        unsigned char tx_tail;    // Read index
+        unsigned char tx_ring[ TX_RING_SIZE ];
+
+        unsigned char rx_head;    // Next chunk to queue
+        unsigned char rx_tail;    // Next chunk to send
+        unsigned char rx_ring[ RX_RING_CHUNKS ][ RX_CHUNK ];
+
+        unsigned short rx_underrun;
+        unsigned short rx_overrun;
+        unsigned short tx_underrun;
+        unsigned short tx_overrun;
+        unsigned short seq_errors;
+        };
+
+    USB_Link& link;
+    Channel ch[ MAX_CHANNELS ];
+
+    static void PutWord( unsigned char*& p, unsigned int value )
+    {
+        *p++ = ( value >> 8 ) & 0xFF;
+        *p++ = value & 0xFF;
+        }
+
+    int TX_Fill( const Channel& c ) const
+    {
+        return ( c.tx_head - c.tx_tail ) & ( TX_RING_SIZE - 1 );
+        }
+
+public:
+
+    B_Stream( USB_Link& p_link )
+        : link( p_link )
+    {
+        memset( ch, 0, sizeof( ch ) );
+        }
+
+    bool IsStreaming( int chan ) const
+    {
+        return chan < MAX_CHANNELS && ch[ chan ].streaming;
+        }
+
+    // AUDIO frame received from host
+    //
+    void OnAudioFrame( int chan, const unsigned char* data, int len )
+    {
+        if ( chan >= MAX_CHANNELS )
+            return;
+
+        Channel& c = ch[ chan ];
+
+        if ( len == 0 ) // Stop
+        {
+            c.streaming = false;
+            return;
+            }
+
+        if ( ! c.streaming ) // Start
+        {
+            c.streaming = true;
+            c.tx_primed = false;
+            c.tx_head = c.tx_tail = 0;
+            c.rx_head = c.rx_tail = 0;
+            c.tx_seq = data[ 0 ];
+            }
+
+        if ( data[ 0 ] != c.tx_seq )
+            ++c.seq_errors;
+
+        c.tx_seq = data[ 0 ] + 1;
+
+        for ( int i = 1; i < len; i++ )
+        {
+            unsigned char next = ( c.tx_head + 1 ) & ( TX_RING_SIZE - 1 );
+            if ( next == c.tx_tail )
+            {
+                c.tx_overrun += len - i;
+                break;
+                }
+
+            c.tx_ring[ c.tx_head ] = data[ i ];
+            c.tx_head = next;
+            }
+
+        if ( TX_Fill( c ) >= TX_PRIME_LEVEL )
+            c.tx_primed = true;
+        }
+
+    // Data read from B-Channel RX FIFO (data == 0 if FIFO held too few octets).
+    // Called from bottom half; only queues the chunk.
+    //
+    void OnRxData( int chan, const unsigned char* data, int len, int discarded )
+    {
+        if ( chan >= MAX_CHANNELS || ! ch[ chan ].streaming )
+            return;
+
+        Channel& c = ch[ chan ];
+
+        c.rx_overrun += discarded;
+
+        if ( ! data )
+        {
+            ++c.rx_underrun;
+            return;
+            }
+
+        if ( len > RX_CHUNK )
+            len = RX_CHUNK;
+
+        unsigned char next = ( c.rx_head + 1 ) & ( RX_RING_CHUNKS - 1 );
+        if ( next == c.rx_tail ) // Host does not keep up; SEQ shows the gap
+        {
+            c.rx_overrun += len;
+            ++c.rx_seq;
+            return;
+            }
+
+        memcpy( c.rx_ring[ c.rx_head ], data, len );
+        c.rx_head = next;
+        }
+
+    // Sends at most one queued chunk per channel, while the USB FIFO accepts
+    // data. Called from main loop.
+    //
+    void Poll( void )
+    {
+        for ( int chan = 0; chan < 2 * hfc.GetPortCount (); chan++ )
+        {
+            Channel& c = ch[ chan ];
+
+            if ( c.rx_tail == c.rx_head )
+                continue;
+
+            if ( ! usb_TxReady () )
+                return;
+
+            link.SendFrame( USB_Link::FRM_CTL_AUDIO, chan,
+                &c.rx_seq, 1, c.rx_ring[ c.rx_tail ], RX_CHUNK );
+
+            ++c.rx_seq;
+            c.rx_tail = ( c.rx_tail + 1 ) & ( RX_RING_CHUNKS - 1 );
+            }
+        }
+
+    // Data about to be written to B-Channel TX FIFO
+    //
+    void OnTxData( int chan, unsigned char* data, int len )
+    {
+        if ( chan >= MAX_CHANNELS )
+            return;
+
+        Channel& c = ch[ chan ];
+
+        // Send silence when not streaming, and until enough data is buffered
+        //
+        if ( ! c.streaming || ! c.tx_primed )
+        {
+            memset( data, SILENCE, len );
+            return;
+            }
+
+        int i = 0;
+
+        for ( ; i < len && c.tx_tail != c.tx_head; i++ )
+        {
+            data[ i ] = c.tx_ring[ c.tx_tail ];
+            c.tx_tail = ( c.tx_tail + 1 ) & ( TX_RING_SIZE - 1 );
+            }
+
+        if ( i < len ) // Underrun; pad with silence and prime again
+        {
+            memset( data + i, SILENCE, len - i );
+            c.tx_primed = false;
+            ++c.tx_underrun;
+            }
+        }
+
+    void SendStatistics( void )
+    {
+        for ( int chan = 0; chan < 2 * hfc.GetPortCount (); chan++ )
+        {
+            const Channel& c = ch[ chan ];
+            const XHFC_Port& port = hfc.port[ chan >> 1 ];
+            const JitterBuffer& rx = port.Get_B_RX_Jitter( chan & 1 );
+            const JitterBuffer& tx = port.Get_B_TX_Jitter( chan & 1 );
+
+            unsigned char buf[ 22 ];
+            unsigned char* p = buf;
+
+            *p++ = c.streaming;
+            *p++ = TX_Fill( c );
+            PutWord( p, c.rx_underrun );
+            PutWord( p, c.rx_overrun );
+            PutWord( p, c.tx_underrun );
+            PutWord( p, c.tx_overrun );
+            PutWord( p, c.seq_errors );
+            *p++ = rx.GetLevel ();
+            *p++ = tx.GetLevel ();
+            PutWord( p, rx.inserted );
+            PutWord( p, rx.deleted );
+            PutWord( p, tx.inserted );
+            PutWord( p, tx.deleted );
+
+            link.SendFrame( USB_Link::FRM_CTL_AUDIO_STATS, chan, buf, p - buf );
+            }
+        }
+    };
+
+#endif // _BSTREAM_H_INCLUDED
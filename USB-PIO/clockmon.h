@@ -0,0 +1,328 @@
+#ifndef _CLOCKMON_H_INCLUDED
+#define _CLOCKMON_H_INCLUDED
+
+#include "usblink.h"
+
+extern bool usb_TxReady( void );
+
+extern class XHFC hfc;
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Clock Monitor: S0 frame clock (XHFC F0 counter) against the MCU clock
+//
+// Timer2 runs from the MCU crystal at clk/1024 (14400 Hz); its overflow
+// interrupt extends it to 32 bits and wakes the main loop at least every
+// 17.8ms, also when XHFC interrupts have stopped.
+//
+// Stamp() takes F0 counter and MCU time together in the XHFC top half.
+// OnTick() runs on every XHFC timer tick: it follows the phase of the S0
+// frame clock against the MCU clock and counts a frame slip every time it
+// has moved by one frame (125us), and it counts timer ticks which the
+// bottom half has missed. Poll() detects stalled ticks and sends a CLOCK
+// record every second of MCU time.
+//
+class ClockMonitor
+{
+/*
+    CLOCK frame (USB-PIO -> Host), ADDR = 0:
+
+    +---+---+---+---+---+---+---+---+
+    |             FLAGS             |  FL_STALLED, FL_IRQ_OFF
+    +---+---+---+---+---+---+---+---+
+    |              SEQ              |  Record number, mod 256
+    +---+---+---+---+---+---+---+---+
+    |         F0 (4 octets)         |  S0 frames in period (MSB first)
+    +---+---+---+---+---+---+---+---+
+    |         MCU (4 octets)        |  Timer2 counts in period
+    +---+---+---+---+---+---+---+---+
+    |         PPM HI, PPM LO        |  S0 frame rate deviation, signed
+    +---+---+---+---+---+---+---+---+
+    |       TICKS HI, TICKS LO      |  XHFC timer ticks in period
+    +---+---+---+---+---+---+---+---+
+    |        IRQS HI, IRQS LO       |  XHFC interrupts in period
+    +---+---+---+---+---+---+---+---+
+    |     GAINED HI, GAINED LO      |  Frame slips, S0 clock fast
+    +---+---+---+---+---+---+---+---+
+    |       LOST HI, LOST LO        |  Frame slips, S0 clock slow
+    +---+---+---+---+---+---+---+---+
+    |     MISSED HI, MISSED LO      |  Timer ticks missed
+    +---+---+---+---+---+---+---+---+
+    |     STALLS HI, STALLS LO      |  Stall events
+    +---+---+---+---+---+---+---+---+
+
+    F0 and MCU are summed over the ticks of the record, so both cover the
+    same interval (none if there was no tick). PPM is
+    ( F0 * 9 / ( MCU * 5 ) - 1 ) * 10^6, limited to +/-32767; 0 without
+    ticks. Its resolution is one Timer2 count (about 70ppm in 1s), so the
+    host sums F0 and MCU for long term drift. GAINED, LOST, MISSED and
+    STALLS count since startup, mod 2^16.
+
+    FL_STALLED: no XHFC timer tick for STALL_TIME. FL_IRQ_OFF: the top
+    half has found the F0 counter stopped and disabled XHFC interrupts.
+*/
+
+public:
+
+    enum // CLOCK flags
+    {
+        FL_STALLED        = 0x01,
+        FL_IRQ_OFF        = 0x02
+        };
+
+private:
+
+    enum // instead of #defines
+    {
+        MCU_HZ            = 14400,  // Timer2 at 14.7456 MHz / 1024
+        REPORT_TIME       = MCU_HZ, // CLOCK record every 1s
+        STALL_TIME        = 720,    // 50ms without tick
+        FRAMES_PER_MS     = 8,
+
+        // Phase is kept in 1/72000 s: F0 frame = 9, Timer2 count = 5
+        //
+        PHASE_FRAME       = 9,
+        PHASE_MCU         = 5,
+        PHASE_HYSTERESIS  = 9,      // Stamp jitter: Timer2 resolution and top half
+        MAX_GAP_TICKS     = 16      // Resync instead of counting slips
+        };
+
+    USB_Link& link;
+
+    volatile unsigned long mcu_hi; // Timer2 overflows
+
+    // Stamp of the last top half
+    //
+    unsigned long stamp_f0;
+    unsigned long stamp_mcu;
+
+    // Stamp at previous tick
+    //
+    bool tick_valid;
+    unsigned long tick_f0;
+    unsigned long tick_mcu;
+    unsigned long tick_time;    // MCU time of OnTick(), for stall detection
+
+    int phase;                  // S0 ahead of MCU clock, 1/72000 s
+
+    // Current record
+    //
+    unsigned long rec_f0;
+    unsigned long rec_mcu;
+    unsigned int rec_ticks;
+    unsigned long rec_irq;      // IRQ count at start
+    unsigned long rec_time;     // MCU time at start
+    unsigned char rec_seq;
+
+    bool stalled;
+
+    // Counters since startup
+    //
+    unsigned int gained;
+    unsigned int lost;
+    unsigned int missed;
+    unsigned int stalls;
+
+    static void PutLong( unsigned char* p, unsigned long x )
+    {
+        p[ 0 ] = x >> 24;
+        p[ 1 ] = x >> 16;
+        p[ 2 ] = x >> 8;
+        p[ 3 ] = x;
+        }
+
+    static void PutWord( unsigned char* p, unsigned int x )
+    {
+        p[ 0 ] = x >> 8;
+        p[ 1 ] = x;
+        }
+
+    // Deviation of S0 frame rate from nominal, in ppm
+    //
+    int GetPPM( void ) const
+    {
+        if ( rec_mcu == 0 )
+            return 0;
+
+        long diff = long( rec_f0 * PHASE_FRAME - rec_mcu * PHASE_MCU );
+
+        // diff * 10^6 / ( MCU * 5 ) without overflow for |diff| < 2^31 / 200000
+        //
+        if ( diff > 10000 )
+            return 32767;
+        if ( diff < -10000 )
+            return -32767;
+
+        long ppm = diff * ( 1000000L / PHASE_MCU ) / long( rec_mcu );
+
+        return ppm > 32767 ? 32767 : ppm < -32767 ? -32767 : int( ppm );
+        }
+
+    void SendRecord( unsigned long now )
+    {
+        unsigned char rec[ 24 ];
+
+        rec[ 0 ] = ( stalled ? FL_STALLED : 0 ) | ( hfc.IsIrqEnabled () ? 0 : FL_IRQ_OFF );
+        rec[ 1 ] = rec_seq++;
+        PutLong( rec + 2, rec_f0 );
+        PutLong( rec + 6, rec_mcu );
+        PutWord( rec + 10, GetPPM () );
+        PutWord( rec + 12, rec_ticks );
+        PutWord( rec + 14, hfc.GetIrqCount () - rec_irq );
+        PutWord( rec + 16, gained );
+        PutWord( rec + 18, lost );
+        PutWord( rec + 20, missed );
+        PutWord( rec + 22, stalls );
+
+        link.SendFrame( USB_Link::FRM_CTL_CLOCK, 0, rec, sizeof( rec ) );
+
+        rec_f0 = 0;
+        rec_mcu = 0;
+        rec_ticks = 0;
+        rec_irq = hfc.GetIrqCount ();
+        rec_time = now;
+        }
+
+public:
+
+    ClockMonitor( USB_Link& p_link )
+        : link( p_link )
+    {
+        mcu_hi = 0;
+        stamp_f0 = stamp_mcu = 0;
+        tick_valid = false;
+        tick_f0 = tick_mcu = tick_time = 0;
+        phase = 0;
+        rec_f0 = rec_mcu = 0;
+        rec_ticks = 0;
+        rec_irq = 0;
+        rec_time = 0;
+        rec_seq = 0;
+        stalled = false;
+        gained = lost = missed = stalls = 0;
+        }
+
+    // Starts Timer2 at clk/1024 with overflow interrupt
+    //
+    void Start( void )
+    {
+        TCCR2 = _BV(CS22) | _BV(CS21) | _BV(CS20);
+        TIFR = _BV(TOV2);
+        TIMSK |= _BV(TOIE2);
+
+        tick_time = rec_time = GetTime ();
+        rec_irq = hfc.GetIrqCount ();
+        }
+
+    // Timer2 overflow (interrupt context)
+    //
+    void OnOverflow( void )
+    {
+        ++mcu_hi;
+        }
+
+    // MCU time in Timer2 counts
+    //
+    unsigned long GetTime( void ) const
+    {
+        unsigned char sreg = SREG;
+        cli ();
+
+        unsigned char lo = TCNT2;
+        unsigned long hi = mcu_hi;
+
+        // Overflow not serviced yet (interrupts disabled)
+        //
+        if ( ( TIFR & _BV(TOV2) ) && lo < 0x80 )
+            ++hi;
+
+        SREG = sreg;
+
+        return ( hi << 8 ) | lo;
+        }
+
+    // Takes F0 counter and MCU time; called after hfc.InterruptHandler()
+    // has returned true (interrupt context or XHFC interrupt masked)
+    //
+    void Stamp( void )
+    {
+        stamp_f0 = hfc.GetF0Count ();
+        stamp_mcu = GetTime ();
+        }
+
+    // Called from main loop on every XHFC timer tick (XHFC interrupt masked)
+    //
+    void OnTick( void )
+    {
+        tick_time = GetTime ();
+
+        unsigned long d_f0 = stamp_f0 - tick_f0;
+        unsigned long d_mcu = stamp_mcu - tick_mcu;
+        long tick_frames = FRAMES_PER_MS * hfc.GetTickMs ();
+
+        bool gap = ! tick_valid || stalled
+            || d_f0 > tick_frames * MAX_GAP_TICKS
+            || d_mcu > ( MCU_HZ / 1000 + 1 ) * hfc.GetTickMs () * MAX_GAP_TICKS;
+
+        tick_valid = true;
+        tick_f0 = stamp_f0;
+        tick_mcu = stamp_mcu;
+
+        if ( stalled )
+        {
+            tracef( "Clock: ticks resumed" );
+            stalled = false;
+            }
+
+        ++rec_ticks;
+
+        if ( gap )
+        {
+            // Clocks not comparable over this interval; start over
+            //
+            phase = 0;
+            return;
+            }
+
+        rec_f0 += d_f0;
+        rec_mcu += d_mcu;
+
+        // Ticks the bottom half has not seen (timer interrupt is a single bit)
+        //
+        if ( long( d_f0 ) >= tick_frames + tick_frames / 2 )
+            missed += ( d_f0 + tick_frames / 2 ) / tick_frames - 1;
+
+        phase += int( d_f0 * PHASE_FRAME ) - int( d_mcu * PHASE_MCU );
+
+        while ( phase > PHASE_FRAME + PHASE_HYSTERESIS )
+        {
+            phase -= PHASE_FRAME;
+            ++gained;
+            }
+
+        while ( phase < -( PHASE_FRAME + PHASE_HYSTERESIS ) )
+        {
+            phase += PHASE_FRAME;
+            ++lost;
+            }
+        }
+
+    // Detects stalled ticks and sends CLOCK record when due. Called from
+    // main loop (XHFC interrupt masked).
+    //
+    void Poll( void )
+    {
+        unsigned long now = GetTime ();
+
+        if ( ! stalled && now - tick_time > STALL_TIME )
+        {
+            stalled = true;
+            ++stalls;
+            tracef( "Clock: no XHFC tick for 50ms, irq %c", hfc.IsIrqEnabled () );
+            }
+
+        if ( now - rec_time >= REPORT_TIME && usb_TxReady () )
+            SendRecord( now );
+        }
+    };
+
+#endif // _CLOCKMON_H_INCLUDED
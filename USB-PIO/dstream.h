@@ -0,0 +1,172 @@
+#ifndef _DSTREAM_H_INCLUDED
+#define _DSTREAM_H_INCLUDED
+
+#include "usblink.h"
+
+#ifdef XHFC_LAPD
+#include "lapd.h"
+#endif
+
+extern class XHFC hfc;
+
+//////////////////////////////////////////////////////////////////////////////////////
+// D-Channel frames between host and XHFC FIFOs
+//
+// The XHFC bottom half only queues received frames in the port's RX frame
+// ring; they are sent to the host from the main loop, one frame per port
+// at a time, so the USB FIFO never stalls the FIFO service. When the port's
+// LAPD entity is enabled (XHFC_LAPD builds), frames are passed to it
+// instead, and only layer 3 messages are sent to the host.
+//
+// Frames of B-Channels in HDLC mode (XHFC_B_HDLC builds) are sent the same
+// way as B_RX frames.
+//
+class D_Stream
+{
+/*
+    D_RX frame (USB-PIO -> Host), ADDR = port:
+
+    +---+---+---+---+---+---+---+---+
+    |            STATUS             |  RX_OK or RX_CRC_ERROR
+    +---+---+---+---+---+---+---+---+
+    |              SEQ              |  Per port, mod 256
+    +---+---+---+---+---+---+---+---+
+    |             DATA              |  HDLC frame octets (without FCS)
+    +---+---+---+---+---+---+---+---+
+    |            FCS HI             |  FCS as received
+    +---+---+---+---+---+---+---+---+
+    |            FCS LO             |
+    +---+---+---+---+---+---+---+---+
+
+    SEQ is incremented for every frame queued for delivery and for every
+    frame dropped because of full ring, so host detects the latter as gap
+    in SEQ. Aborted and too short frames are not delivered.
+
+    B_RX frame (USB-PIO -> Host), ADDR = port * 2 + bc: same as D_RX,
+    with SEQ per B-Channel.
+*/
+
+public:
+
+    enum // D_RX status
+    {
+        RX_OK             = 0x00,
+        RX_CRC_ERROR      = 0x01
+        };
+
+private:
+
+    struct RxSeq
+    {
+        unsigned char seq;          // SEQ of next frame
+        unsigned short dropped;     // Ring drops already counted in seq
+        };
+
+    USB_Link& link;
+    RxSeq rx_seq[ XHFC_MAX_PORTS ];
+
+#ifdef XHFC_B_HDLC
+    RxSeq b_rx_seq[ 2 * XHFC_MAX_PORTS ];
+#endif
+
+    // SEQ of oldest frame of the ring. Frames dropped by the ring since
+    // the previous one (full ring) are counted first; they were queued
+    // later than the frames still in the ring, but the gap shows up all
+    // the same.
+    //
+    static unsigned char NextSeq( FrameRing& ring, RxSeq& rs )
+    {
+        if ( ring.dropped < rs.dropped ) // Ring was reset
+            rs.dropped = 0;
+
+        rs.seq += ring.dropped - rs.dropped;
+        rs.dropped = ring.dropped;
+
+        return rs.seq++;
+        }
+
+    // Sends oldest frame of the ring and removes it
+    //
+    void SendFrame( FrameRing& ring, int type, int addr, RxSeq& rs )
+    {
+        // Ring keeps STAT as last octet
+        //
+        int len = ring.GetLen () - 1;
+
+        const unsigned char* p;
+        ring.GetChunk( len, p );
+
+        unsigned char hdr[ 2 ];
+        hdr[ 0 ] = *p ? RX_CRC_ERROR : RX_OK;
+        hdr[ 1 ] = NextSeq( ring, rs );
+
+        link.BeginFrame( type, addr, sizeof( hdr ) + len );
+        link.PutData( hdr, sizeof( hdr ) );
+
+        for ( int offset = 0; offset < len; )
+        {
+            int n = ring.GetChunk( offset, p );
+            if ( n > len - offset )
+                n = len - offset;
+
+            link.PutData( p, n );
+            offset += n;
+            }
+
+        link.EndFrame ();
+
+        ring.Pop ();
+        }
+
+public:
+
+    D_Stream( USB_Link& p_link )
+        : link( p_link )
+    {
+        memset( rx_seq, 0, sizeof( rx_seq ) );
+#ifdef XHFC_B_HDLC
+        memset( b_rx_seq, 0, sizeof( b_rx_seq ) );
+#endif
+        }
+
+    // Sends at most one received frame per port and B-Channel. Called
+    // from main loop.
+    //
+    void Poll( void )
+    {
+        for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+        {
+            FrameRing& ring = hfc.port[ pt ].Get_D_RX_Ring ();
+
+            if ( ring.IsEmpty () )
+                continue;
+
+#ifdef XHFC_LAPD
+            if ( lapd[ pt ].IsEnabled () )
+            {
+                lapd[ pt ].OnFrame( ring );
+                ring.Pop ();
+
+                // Drops seen by LAPD are not reported as SEQ gap later
+                //
+                rx_seq[ pt ].dropped = ring.dropped;
+                continue;
+                }
+#endif
+
+            SendFrame( ring, USB_Link::FRM_CTL_D_RX, pt, rx_seq[ pt ] );
+            }
+
+#ifdef XHFC_B_HDLC
+        for ( int ch = 0; ch < 2 * hfc.GetPortCount (); ch++ )
+        {
+            XHFC_Port& port = hfc.port[ ch >> 1 ];
+
+            if ( port.Is_B_HDLC( ch & 1 ) && ! port.Get_B_HDLC( ch & 1 ).rx_ring.IsEmpty () )
+                SendFrame( port.Get_B_HDLC( ch & 1 ).rx_ring, USB_Link::FRM_CTL_B_RX, ch, b_rx_seq[ ch ] );
+            }
+#endif
+        }
+    };
+
+#endif // _DSTREAM_H_INCLUDED
@@ -0,0 +1,724 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/select.h>
+#endif
+
+#include "piolink.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+PIO_Link::PIO_Link( void )
+{
+#ifdef _WIN32
+    handle = INVALID_HANDLE_VALUE;
+#else
+    fd = -1;
+#endif
+
+    state = WAIT_FLG1;
+    CTL = ADDR = CS = 0;
+    data_len = data_p = 0;
+    sn_to_pio = 0;
+    bad_frames = 0;
+    cmd_tag = 0;
+    cmd_pending = 0;
+
+    for ( int i = 0; i < MAX_CHANNELS; i++ )
+    {
+        tx_seq[ i ] = 0;
+        rx_seq[ i ] = -1;
+        rx_lost[ i ] = 0;
+        b_rx_seq[ i ] = -1;
+        b_rx_lost[ i ] = 0;
+        }
+
+    for ( int i = 0; i < MAX_PORTS; i++ )
+    {
+        d_rx_seq[ i ] = -1;
+        d_rx_lost[ i ] = 0;
+        }
+
+    trace_dropped = -1;
+    trace_lost = 0;
+
+    clock_f0 = 0;
+    clock_mcu = 0;
+    }
+
+PIO_Link::~PIO_Link( void )
+{
+    Close ();
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool PIO_Link::Open( const char* device )
+{
+    Close ();
+
+#ifdef _WIN32
+    char name[ 64 ];
+    _snprintf( name, sizeof( name ), "\\\\.\\%s", device );
+
+    HANDLE h = CreateFile( name, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+        OPEN_EXISTING, 0, NULL );
+
+    if ( h == INVALID_HANDLE_VALUE )
+        return false;
+
+    SetupComm( h, 65536, 65536 );
+
+    COMMTIMEOUTS ct;
+    memset( &ct, 0, sizeof( ct ) );
+    SetCommTimeouts( h, &ct );
+
+    handle = h;
+#else
+    fd = open( device, O_RDWR | O_NOCTTY );
+    if ( fd < 0 )
+        return false;
+
+    struct termios tio;
+    if ( tcgetattr( fd, &tio ) == 0 )
+    {
+        cfmakeraw( &tio );
+        tio.c_cc[ VMIN ] = 0;
+        tio.c_cc[ VTIME ] = 0;
+        tcsetattr( fd, TCSANOW, &tio );
+        }
+#endif
+
+    return true;
+    }
+
+void PIO_Link::Close( void )
+{
+#ifdef _WIN32
+    if ( handle != INVALID_HANDLE_VALUE )
+        CloseHandle( handle );
+    handle = INVALID_HANDLE_VALUE;
+#else
+    if ( fd >= 0 )
+        close( fd );
+    fd = -1;
+#endif
+    }
+
+int PIO_Link::Read( unsigned char* buf, int len, int timeout_ms )
+{
+#ifdef _WIN32
+    COMMTIMEOUTS ct;
+    memset( &ct, 0, sizeof( ct ) );
+    ct.ReadIntervalTimeout = MAXDWORD;
+    ct.ReadTotalTimeoutMultiplier = MAXDWORD;
+    ct.ReadTotalTimeoutConstant = timeout_ms > 0 ? timeout_ms : 1;
+    SetCommTimeouts( handle, &ct );
+
+    DWORD rd = 0;
+    if ( ! ReadFile( handle, buf, len, &rd, NULL ) )
+        return -1;
+
+    return int( rd );
+#else
+    fd_set rfds;
+    FD_ZERO( &rfds );
+    FD_SET( fd, &rfds );
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = ( timeout_ms % 1000 ) * 1000;
+
+    int rc = select( fd + 1, &rfds, NULL, NULL, &tv );
+    if ( rc <= 0 )
+        return rc;
+
+    return read( fd, buf, len );
+#endif
+    }
+
+bool PIO_Link::Write( const unsigned char* buf, int len )
+{
+#ifdef _WIN32
+    DWORD wr = 0;
+    return WriteFile( handle, buf, len, &wr, NULL ) && int( wr ) == len;
+#else
+    while ( len > 0 )
+    {
+        int rc = write( fd, buf, len );
+        if ( rc < 0 )
+            return false;
+        buf += rc;
+        len -= rc;
+        }
+    return true;
+#endif
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool PIO_Link::SendFrame( int type, int addr, const unsigned char* buf, int len )
+{
+    if ( len > MAX_DATA )
+        return false;
+
+    unsigned char frame[ 6 + MAX_DATA ];
+    int n = 0;
+
+    ++sn_to_pio;
+
+    frame[ n++ ] = 0x15; // FLG1
+    frame[ n++ ] = 0x15; // FLG2
+    frame[ n++ ] = 4 + len; // BC
+    frame[ n++ ] = ( ( sn_to_pio & 0x0F ) << 4 ) | ( type & 0x0F ); // CTL
+    frame[ n++ ] = addr;
+
+    int cs = frame[ 2 ] + frame[ 3 ] + frame[ 4 ];
+
+    for ( int i = 0; i < len; i++ )
+    {
+        frame[ n++ ] = buf[ i ];
+        cs += buf[ i ];
+        }
+
+    frame[ n++ ] = ( cs - 1 ) & 0xFF;
+
+    return Write( frame, n );
+    }
+
+bool PIO_Link::Poll( int timeout_ms )
+{
+    unsigned char buf[ 4096 ];
+
+    int len = Read( buf, sizeof( buf ), timeout_ms );
+    if ( len < 0 )
+        return false;
+
+    for ( int i = 0; i < len; i++ )
+        OnReceivedOctet( buf[ i ] );
+
+    return true;
+    }
+
+void PIO_Link::OnReceivedOctet( int octet )
+{
+    switch( state )
+    {
+        case WAIT_FLG1:
+            if ( octet == 0x15 )
+                state = WAIT_FLG2;
+            else
+                OnConsole( octet );
+            break;
+
+        case WAIT_FLG2:
+            if ( octet == 0x15 )
+                state = WAIT_BC;
+            else
+            {
+                ++bad_frames;
+                state = WAIT_FLG1;
+                }
+            break;
+
+        case WAIT_BC:
+            if ( octet < 4 )
+            {
+                ++bad_frames;
+                state = WAIT_FLG1;
+                break;
+                }
+            CS = octet;
+            data_len = octet - 4;
+            data_p = 0;
+            state = WAIT_CTL;
+            break;
+
+        case WAIT_CTL:
+            CS += octet;
+            CTL = octet;
+            state = WAIT_ADDR;
+            break;
+
+        case WAIT_ADDR:
+            CS += octet;
+            ADDR = octet;
+            state = data_len ? WAIT_DATA : WAIT_CS;
+            break;
+
+        case WAIT_DATA:
+            CS += octet;
+            data[ data_p++ ] = octet;
+            if ( data_p >= data_len )
+                state = WAIT_CS;
+            break;
+
+        case WAIT_CS:
+            state = WAIT_FLG1;
+            if ( ( ( CS - 1 ) & 0xFF ) != octet )
+                ++bad_frames;
+            else
+                OnFrame( CTL & 0x0F, ADDR, data, data_len );
+            break;
+        }
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int GetWord( const unsigned char* p )
+{
+    return ( p[ 0 ] << 8 ) | p[ 1 ];
+    }
+
+static unsigned long GetLong( const unsigned char* p )
+{
+    return ( (unsigned long)GetWord( p ) << 16 ) | GetWord( p + 2 );
+    }
+
+// Formats TRACE record the same way as tracef() used to on the device;
+// see trace.h in the firmware. Missing arguments are shown as '?'.
+//
+static void FormatTrace( char* out, int size,
+    const char* format, const unsigned char* args, int len )
+{
+    static const char hextab[] = "0123456789ABCDEF";
+
+    int n = 0;
+    const unsigned char* end = args + len;
+
+    for ( ; *format && n < size - 4; format++ )
+    {
+        if ( *format != '%' )
+        {
+            out[ n++ ] = *format;
+            continue;
+            }
+
+        if ( ! *++format )
+            break;
+
+        int width = 0; // Octets of argument value
+
+        if ( *format == '%' )
+            out[ n++ ] = '%';
+        else if ( *format == 'c' )
+            width = 1;
+        else if ( *format == 's' )
+            width = 2;
+        else if ( *format == 'l' )
+            width = 4;
+        else if ( *format == 'a' && args < end )
+        {
+            int count = *args++;
+            for ( ; count > 0 && args < end && n < size - 4; count-- )
+            {
+                out[ n++ ] = hextab[ *args >> 4 ];
+                out[ n++ ] = hextab[ *args++ & 0xF ];
+                if ( count > 1 )
+                    out[ n++ ] = ' ';
+                }
+            }
+        else if ( *format == 'a' )
+            out[ n++ ] = '?';
+
+        if ( width > end - args )
+        {
+            out[ n++ ] = '?';
+            args = end;
+            continue;
+            }
+
+        for ( ; width > 0 && n < size - 3; width-- )
+        {
+            out[ n++ ] = hextab[ *args >> 4 ];
+            out[ n++ ] = hextab[ *args++ & 0xF ];
+            }
+        }
+
+    out[ n ] = 0;
+    }
+
+void PIO_Link::OnFrame( int type, int addr, const unsigned char* buf, int len )
+{
+    switch( type )
+    {
+        case FRM_AUDIO:
+        {
+            if ( addr >= MAX_CHANNELS || len < 1 )
+                break;
+
+            int seq = buf[ 0 ];
+            if ( rx_seq[ addr ] >= 0 )
+                rx_lost[ addr ] += ( seq - rx_seq[ addr ] ) & 0xFF;
+            rx_seq[ addr ] = ( seq + 1 ) & 0xFF;
+
+            OnAudio( addr, seq, buf + 1, len - 1 );
+            }
+            break;
+
+        case FRM_AUDIO_STATS:
+        {
+            if ( len < 22 )
+                break;
+
+            AudioStats st;
+            st.streaming   = buf[ 0 ] != 0;
+            st.tx_fill     = buf[ 1 ];
+            st.rx_underrun = GetWord( buf + 2 );
+            st.rx_overrun  = GetWord( buf + 4 );
+            st.tx_underrun = GetWord( buf + 6 );
+            st.tx_overrun  = GetWord( buf + 8 );
+            st.seq_errors  = GetWord( buf + 10 );
+            st.rx_level    = buf[ 12 ];
+            st.tx_level    = buf[ 13 ];
+            st.rx_inserted = GetWord( buf + 14 );
+            st.rx_deleted  = GetWord( buf + 16 );
+            st.tx_inserted = GetWord( buf + 18 );
+            st.tx_deleted  = GetWord( buf + 20 );
+
+            OnAudioStats( addr, st );
+            }
+            break;
+
+        case FRM_D_RX:
+        {
+            // STATUS, SEQ, DATA, FCS (2 octets)
+            //
+            if ( addr >= MAX_PORTS || len < 4 )
+                break;
+
+            int seq = buf[ 1 ];
+            if ( d_rx_seq[ addr ] >= 0 )
+                d_rx_lost[ addr ] += ( seq - d_rx_seq[ addr ] ) & 0xFF;
+            d_rx_seq[ addr ] = ( seq + 1 ) & 0xFF;
+
+            OnDFrame( addr, buf[ 0 ] == 0, buf + 2, len - 4 );
+            }
+            break;
+
+        case FRM_B_RX:
+        {
+            // Same as D_RX
+            //
+            if ( addr >= MAX_CHANNELS || len < 4 )
+                break;
+
+            int seq = buf[ 1 ];
+            if ( b_rx_seq[ addr ] >= 0 )
+                b_rx_lost[ addr ] += ( seq - b_rx_seq[ addr ] ) & 0xFF;
+            b_rx_seq[ addr ] = ( seq + 1 ) & 0xFF;
+
+            OnBFrame( addr, buf[ 0 ] == 0, buf + 2, len - 4 );
+            }
+            break;
+
+        case FRM_CMD_ACK:
+            // OPCODE, TAG, RESULT, REPLY
+            //
+            if ( len < 3 )
+                break;
+
+            if ( cmd_pending > 0 )
+                --cmd_pending;
+
+            OnCommandAck( addr, buf[ 0 ], buf[ 1 ], buf[ 2 ], buf + 3, len - 3 );
+            break;
+
+        case FRM_LAPD_IND:
+            // PRIM, PARAMS
+            //
+            if ( len < 1 )
+                break;
+
+            OnLapdIndication( addr, buf[ 0 ], buf + 1, len - 1 );
+            break;
+
+        case FRM_TRACE:
+        {
+            // DROPPED (2 octets), FORMAT, NUL, ARGS
+            //
+            const unsigned char* nul = len > 2
+                ? (const unsigned char*)memchr( buf + 2, 0, len - 2 ) : 0;
+            if ( ! nul )
+                break;
+
+            int dropped = GetWord( buf );
+            if ( trace_dropped >= 0 )
+                trace_lost += ( dropped - trace_dropped ) & 0xFFFF;
+            trace_dropped = dropped;
+
+            char text[ 512 ];
+            FormatTrace( text, sizeof( text ), (const char*)buf + 2,
+                nul + 1, buf + len - ( nul + 1 ) );
+
+            OnTrace( text );
+            }
+            break;
+
+        case FRM_CLOCK:
+        {
+            if ( len < 24 )
+                break;
+
+            ClockStats st;
+            st.stalled     = ( buf[ 0 ] & 0x01 ) != 0;
+            st.irq_off     = ( buf[ 0 ] & 0x02 ) != 0;
+            st.seq         = buf[ 1 ];
+            st.f0          = GetLong( buf + 2 );
+            st.mcu         = GetLong( buf + 6 );
+            st.ppm         = short( GetWord( buf + 10 ) );
+            st.ticks       = GetWord( buf + 12 );
+            st.irqs        = GetWord( buf + 14 );
+            st.gained      = GetWord( buf + 16 );
+            st.lost        = GetWord( buf + 18 );
+            st.missed      = GetWord( buf + 20 );
+            st.stalls      = GetWord( buf + 22 );
+
+            // S0 frames at 8000 Hz, Timer2 at 14400 Hz
+            //
+            clock_f0 += st.f0;
+            clock_mcu += st.mcu;
+            st.drift_ppm = clock_mcu > 0
+                ? ( clock_f0 * 1.8 / clock_mcu - 1 ) * 1e6 : 0;
+
+            OnClock( st );
+            }
+            break;
+
+        case FRM_BERT:
+        {
+            if ( len < 23 )
+                break;
+
+            BertStats st;
+            st.pattern      = buf[ 0 ];
+            st.sync         = ( buf[ 1 ] & 0x01 ) != 0;
+            st.seq          = buf[ 2 ];
+            st.bits         = GetWord( buf + 3 );
+            st.errors       = GetWord( buf + 5 );
+            st.slips        = GetWord( buf + 7 );
+            st.losses       = GetWord( buf + 9 );
+            st.total_bits   = GetLong( buf + 11 );
+            st.total_errors = GetLong( buf + 15 );
+            st.errored_secs = GetWord( buf + 19 );
+            st.seconds      = GetWord( buf + 21 );
+            st.ber          = st.total_bits
+                ? double( st.total_errors ) / st.total_bits : 0;
+
+            OnBert( addr, st );
+            }
+            break;
+        }
+    }
+
+void PIO_Link::OnConsole( int ch )
+{
+    putchar( ch );
+    }
+
+void PIO_Link::OnTrace( const char* text )
+{
+    printf( "%s\n", text );
+    }
+
+void PIO_Link::OnClock( const ClockStats& st )
+{
+    printf( "Clock: %lu frames in %.3fs, %+d ppm (%+.1f ppm long term), "
+        "%d ticks, %d irqs\n"
+        "    slips +%d/-%d, missed ticks %d, stalls %d%s%s\n",
+        st.f0, st.mcu / 14400.0, st.ppm, st.drift_ppm, st.ticks, st.irqs,
+        st.gained, st.lost, st.missed, st.stalls,
+        st.stalled ? ", STALLED" : "", st.irq_off ? ", XHFC IRQ OFF" : "" );
+    }
+
+void PIO_Link::OnBert( int chan, const BertStats& st )
+{
+    printf( "B%d: PRBS %d %s, %d bits, %d errors, %d slips, %d sync losses; "
+        "BER %.2e, %d/%d errored seconds\n",
+        chan, st.pattern, st.sync ? "sync" : "NO SYNC", st.bits, st.errors,
+        st.slips, st.losses, st.ber, st.errored_secs, st.seconds );
+    }
+
+void PIO_Link::OnAudio( int, int, const unsigned char*, int )
+{
+    }
+
+void PIO_Link::OnAudioStats( int chan, const AudioStats& st )
+{
+    printf( "B%d: %s, tx fill %d, rx underrun %d overrun %d, "
+        "tx underrun %d overrun %d, seq errors %d\n"
+        "    fifo level rx %d tx %d, slips rx +%d/-%d tx +%d/-%d\n",
+        chan, st.streaming ? "streaming" : "idle", st.tx_fill,
+        st.rx_underrun, st.rx_overrun, st.tx_underrun, st.tx_overrun,
+        st.seq_errors, st.rx_level, st.tx_level,
+        st.rx_inserted, st.rx_deleted, st.tx_inserted, st.tx_deleted );
+    }
+
+void PIO_Link::OnDFrame( int port, bool crc_ok, const unsigned char* data, int len )
+{
+    printf( "%d D-RX%s", port, crc_ok ? "" : " (CRC error)" );
+
+    for ( int i = 0; i < len; i++ )
+        printf( " %02X", data[ i ] );
+
+    printf( "\n" );
+    }
+
+void PIO_Link::OnBFrame( int chan, bool crc_ok, const unsigned char* data, int len )
+{
+    printf( "B%d RX%s", chan, crc_ok ? "" : " (CRC error)" );
+
+    for ( int i = 0; i < len; i++ )
+        printf( " %02X", data[ i ] );
+
+    printf( "\n" );
+    }
+
+void PIO_Link::OnCommandAck( int port, int opcode, int tag, int rc,
+    const unsigned char* reply, int len )
+{
+    printf( "%d CMD %02X tag %02X: rc %d", port, opcode, tag, rc );
+
+    for ( int i = 0; i < len; i++ )
+        printf( " %02X", reply[ i ] );
+
+    printf( "\n" );
+    }
+
+void PIO_Link::OnLapdIndication( int port, int prim, const unsigned char* data, int len )
+{
+    static const char* names[] =
+    {
+        "DL-ESTABLISH-IND", "DL-ESTABLISH-CONF", "DL-RELEASE-IND", "DL-RELEASE-CONF",
+        "DL-DATA-IND", "DL-UNITDATA-IND", "MDL-ERROR-IND", "MDL-TEI-IND"
+        };
+
+    if ( prim >= DL_ESTABLISH_IND && prim <= MDL_TEI_IND )
+        printf( "%d %s", port, names[ prim - DL_ESTABLISH_IND ] );
+    else
+        printf( "%d LAPD %02X", port, prim );
+
+    if ( prim == MDL_ERROR_IND && len >= 1 )
+        printf( " %c", data[ 0 ] );
+    else
+    {
+        for ( int i = 0; i < len; i++ )
+            printf( " %02X", data[ i ] );
+        }
+
+    printf( "\n" );
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool PIO_Link::StartAudio( int chan )
+{
+    rx_seq[ chan ] = -1;
+
+    unsigned char seq = tx_seq[ chan ]++;
+    return SendFrame( FRM_AUDIO, chan, &seq, 1 );
+    }
+
+bool PIO_Link::SendAudio( int chan, const unsigned char* samples, int len )
+{
+    unsigned char buf[ 1 + MAX_DATA ];
+
+    while ( len > 0 )
+    {
+        int n = len > AUDIO_CHUNK ? AUDIO_CHUNK : len;
+
+        buf[ 0 ] = tx_seq[ chan ]++;
+        memcpy( buf + 1, samples, n );
+
+        if ( ! SendFrame( FRM_AUDIO, chan, buf, n + 1 ) )
+            return false;
+
+        samples += n;
+        len -= n;
+        }
+
+    return true;
+    }
+
+bool PIO_Link::StopAudio( int chan )
+{
+    return SendFrame( FRM_AUDIO, chan );
+    }
+
+bool PIO_Link::RequestAudioStats( void )
+{
+    return SendFrame( FRM_AUDIO_STATS_REQ, 0 );
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+int PIO_Link::SendCommand( int port, int opcode, const unsigned char* params, int len )
+{
+    if ( len > MAX_CMD_DATA )
+        return -1;
+
+    unsigned char buf[ 2 + MAX_CMD_DATA ];
+
+    int tag = cmd_tag;
+    cmd_tag = ( cmd_tag + 1 ) & 0xFF;
+
+    buf[ 0 ] = opcode;
+    buf[ 1 ] = tag;
+    if ( len > 0 )
+        memcpy( buf + 2, params, len );
+
+    if ( ! SendFrame( FRM_CMD, port, buf, 2 + len ) )
+        return -1;
+
+    ++cmd_pending;
+    return tag;
+    }
+
+// Packs { LEN, DATA[LEN] } ... after prefix octets; returns length or 0
+//
+static int PackFrames( unsigned char* buf, int n,
+    const unsigned char* const* frames, const int* lens, int count )
+{
+    int start = n;
+
+    for ( int i = 0; i < count; i++ )
+    {
+        if ( lens[ i ] < 1 || lens[ i ] > 255 || n + 1 + lens[ i ] > PIO_Link::MAX_CMD_DATA )
+            break;
+
+        buf[ n++ ] = lens[ i ];
+        memcpy( buf + n, frames[ i ], lens[ i ] );
+        n += lens[ i ];
+        }
+
+    return n > start ? n : 0;
+    }
+
+int PIO_Link::Send_D_Frames( int port, const unsigned char* const* frames, const int* lens, int count )
+{
+    unsigned char buf[ MAX_CMD_DATA ];
+
+    int n = PackFrames( buf, 0, frames, lens, count );
+    if ( n == 0 )
+        return -1;
+
+    return SendCommand( port, OP_D_TX, buf, n );
+    }
+
+int PIO_Link::Send_B_Frames( int chan, const unsigned char* const* frames, const int* lens, int count )
+{
+    unsigned char buf[ MAX_CMD_DATA ];
+    buf[ 0 ] = chan & 1;
+
+    int n = PackFrames( buf, 1, frames, lens, count );
+    if ( n == 0 )
+        return -1;
+
+    return SendCommand( chan >> 1, OP_B_TX, buf, n );
+    }
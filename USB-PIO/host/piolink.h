@@ -0,0 +1,279 @@
+#ifndef _PIOLINK_H_INCLUDED
+#define _PIOLINK_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+// PIO_Link Class: Host side of the USB-PIO binary frame protocol
+//
+// Talks to USB-PIO through the FT245 virtual COM port. See usblink.h and
+// bstream.h in the firmware for the frame formats. TRACE frames are
+// formatted here and passed to OnTrace(); octets received outside of
+// frames (ASCII console of older firmware) are passed to OnConsole().
+//
+class PIO_Link
+{
+public:
+
+    enum // Frame types
+    {
+        FRM_AUDIO           = 0x00,
+        FRM_AUDIO_STATS_REQ = 0x01,
+        FRM_CMD             = 0x03,
+        FRM_BERT            = 0x08, // Firmware built with XHFC_BERT only
+        FRM_AUDIO_STATS     = 0x09,
+        FRM_D_RX            = 0x0A,
+        FRM_CMD_ACK         = 0x0B,
+        FRM_LAPD_IND        = 0x0C,
+        FRM_TRACE           = 0x0D,
+        FRM_B_RX            = 0x0E, // Firmware built with XHFC_B_HDLC only
+        FRM_CLOCK           = 0x0F  // Firmware built with XHFC_CLOCKMON only
+        };
+
+    enum // Command opcodes, see hostcmd.h in the firmware
+    {
+        OP_D_TX             = 0x01,
+        OP_L1_ACTIVATE      = 0x02,
+        OP_L1_DEACTIVATE    = 0x03,
+        OP_B_ENABLE         = 0x04,
+        OP_B_DISABLE        = 0x05,
+        OP_B_LOOP           = 0x06,
+        OP_PEEK             = 0x07,
+        OP_POKE             = 0x08,
+        OP_STATS            = 0x09,
+        OP_LAPD             = 0x0A, // Firmware built with XHFC_LAPD only
+        OP_XC_CONNECT       = 0x0B,
+        OP_XC_PCM           = 0x0C,
+        OP_XC_TABLE         = 0x0D,
+        OP_MODERATION       = 0x0E,
+        OP_B_HDLC           = 0x0F, // Firmware built with XHFC_B_HDLC only
+        OP_B_TX             = 0x10, // ...
+        OP_B_STATS          = 0x11, // ...
+        OP_L1_LOG           = 0x12, // Firmware built with XHFC_L1_LOG only
+        OP_L1_EVENTS        = 0x13, // ...
+        OP_BERT             = 0x14  // Firmware built with XHFC_BERT only
+        };
+
+    enum // Cross-connect table entries
+    {
+        XC_NONE             = 0xFF,
+        XC_PCM              = 0x80
+        };
+
+    enum // LAPD primitives, see lapd.h in the firmware
+    {
+        DL_ESTABLISH_REQ    = 0x01,
+        DL_RELEASE_REQ      = 0x02,
+        DL_DATA_REQ         = 0x03,
+        DL_UNITDATA_REQ     = 0x04,
+        MDL_CONFIG_REQ      = 0x05,
+
+        DL_ESTABLISH_IND    = 0x81,
+        DL_ESTABLISH_CONF   = 0x82,
+        DL_RELEASE_IND      = 0x83,
+        DL_RELEASE_CONF     = 0x84,
+        DL_DATA_IND         = 0x85,
+        DL_UNITDATA_IND     = 0x86,
+        MDL_ERROR_IND       = 0x87,
+        MDL_TEI_IND         = 0x88
+        };
+
+    enum // Command results
+    {
+        RC_OK               = 0x00,
+        RC_BAD_OPCODE       = 0x01,
+        RC_BAD_PARAM        = 0x02,
+        RC_FULL             = 0x03
+        };
+
+    enum
+    {
+        MAX_CHANNELS        = 16, // 2 per port
+        MAX_PORTS           = 8,  // Over all XHFC chips
+        MAX_DATA            = 255 - 4,
+        AUDIO_CHUNK         = 8, // 1ms; device ring holds only 4ms
+        MAX_CMD_DATA        = 72 - 2 // Device receive buffer minus OPCODE, TAG
+        };
+
+    struct AudioStats
+    {
+        bool streaming;
+        int  tx_fill;
+        int  rx_underrun;
+        int  rx_overrun;
+        int  tx_underrun;
+        int  tx_overrun;
+        int  seq_errors;
+        int  rx_level;      // XHFC FIFO levels
+        int  tx_level;
+        int  rx_inserted;   // Jitter buffer slips
+        int  rx_deleted;
+        int  tx_inserted;
+        int  tx_deleted;
+        };
+
+    struct ClockStats // CLOCK record, see clockmon.h in the firmware
+    {
+        bool stalled;       // No XHFC timer tick for 50ms
+        bool irq_off;       // XHFC interrupts disabled, F0 counter stopped
+        int  seq;
+        unsigned long f0;   // S0 frames in period
+        unsigned long mcu;  // MCU Timer2 counts (1/14400 s) in period
+        int  ppm;           // S0 frame rate deviation in period
+        double drift_ppm;   // ... over all records received
+        int  ticks;         // XHFC timer ticks in period
+        int  irqs;          // XHFC interrupts in period
+        int  gained;        // Frame slips since startup, S0 clock fast
+        int  lost;          // ... S0 clock slow
+        int  missed;        // Timer ticks missed since startup
+        int  stalls;        // Stall events since startup
+        };
+
+    struct BertStats // BERT record, see bert.h in the firmware
+    {
+        int  pattern;       // 11 or 15 (PRBS 2^n-1)
+        bool sync;          // Checker in sync at end of period
+        int  seq;
+        int  bits;          // Bits checked in period (1s)
+        int  errors;        // Bit errors in period
+        int  slips;         // Octet slips in period
+        int  losses;        // Sync losses in period
+        unsigned long total_bits;   // Since start of test
+        unsigned long total_errors;
+        int  errored_secs;
+        int  seconds;
+        double ber;         // total_errors / total_bits, 0 without bits
+        };
+
+private:
+
+    enum STATE // Receiver state-machine
+    {
+        WAIT_FLG1, WAIT_FLG2, WAIT_BC, WAIT_CTL, WAIT_ADDR, WAIT_DATA, WAIT_CS
+        };
+
+#ifdef _WIN32
+    void* handle;
+#else
+    int fd;
+#endif
+
+    STATE state;
+    int CTL;
+    int ADDR;
+    int CS;
+    int data_len;
+    int data_p;
+    unsigned char data[ 256 ];
+
+    int sn_to_pio;
+    int bad_frames;
+
+    int cmd_tag;
+    int cmd_pending; // Commands not acknowledged yet
+
+    unsigned char tx_seq[ MAX_CHANNELS ];
+    int rx_seq[ MAX_CHANNELS ]; // -1 if not known yet
+    int rx_lost[ MAX_CHANNELS ];
+
+    int d_rx_seq[ MAX_PORTS ]; // -1 if not known yet
+    int d_rx_lost[ MAX_PORTS ];
+
+    int b_rx_seq[ MAX_CHANNELS ]; // -1 if not known yet
+    int b_rx_lost[ MAX_CHANNELS ];
+
+    int trace_dropped; // Last DROPPED counter, -1 if not known yet
+    int trace_lost;
+
+    double clock_f0;   // Sum of CLOCK records
+    double clock_mcu;
+
+    int Read( unsigned char* buf, int len, int timeout_ms );
+    bool Write( const unsigned char* buf, int len );
+
+    void OnReceivedOctet( int octet );
+
+protected:
+
+    // Callbacks, called from Poll()
+    //
+    virtual void OnFrame( int type, int addr, const unsigned char* data, int len );
+    virtual void OnConsole( int ch );
+    virtual void OnAudio( int chan, int seq, const unsigned char* samples, int len );
+    virtual void OnAudioStats( int chan, const AudioStats& stats );
+    virtual void OnDFrame( int port, bool crc_ok, const unsigned char* data, int len );
+    virtual void OnBFrame( int chan, bool crc_ok, const unsigned char* data, int len );
+    virtual void OnCommandAck( int port, int opcode, int tag, int rc,
+        const unsigned char* reply, int len );
+    virtual void OnLapdIndication( int port, int prim, const unsigned char* data, int len );
+    virtual void OnTrace( const char* text );
+    virtual void OnClock( const ClockStats& stats );
+    virtual void OnBert( int chan, const BertStats& stats );
+
+public:
+
+    PIO_Link( void );
+    virtual ~PIO_Link( void );
+
+    bool Open( const char* device );
+    void Close( void );
+
+    bool SendFrame( int type, int addr, const unsigned char* data = 0, int len = 0 );
+
+    // Processes received octets; waits at most timeout_ms for the first one.
+    // Returns false on I/O error.
+    //
+    bool Poll( int timeout_ms );
+
+    // B-Channel audio
+    //
+    bool StartAudio( int chan );
+    bool SendAudio( int chan, const unsigned char* samples, int len );
+    bool StopAudio( int chan );
+    bool RequestAudioStats( void );
+
+    // Commands. Returns TAG of the command sent, or -1 on error.
+    // Commands may be pipelined; see GetPendingCommands().
+    //
+    int SendCommand( int port, int opcode, const unsigned char* params = 0, int len = 0 );
+
+    // Queues D-Channel frames; as many as fit into one command
+    //
+    int Send_D_Frames( int port, const unsigned char* const* frames, const int* lens, int count );
+
+    // Same for B-Channel in HDLC mode
+    //
+    int Send_B_Frames( int chan, const unsigned char* const* frames, const int* lens, int count );
+
+    int GetPendingCommands( void ) const
+    {
+        return cmd_pending;
+        }
+
+    int GetLostAudioFrames( int chan ) const
+    {
+        return rx_lost[ chan ];
+        }
+
+    int GetLostDFrames( int port ) const
+    {
+        return d_rx_lost[ port ];
+        }
+
+    int GetLostBFrames( int chan ) const
+    {
+        return b_rx_lost[ chan ];
+        }
+
+    // Trace records dropped by the device since the first one received
+    //
+    int GetLostTraces( void ) const
+    {
+        return trace_lost;
+        }
+
+    int GetBadFrames( void ) const
+    {
+        return bad_frames;
+        }
+    };
+
+#endif // _PIOLINK_H_INCLUDED
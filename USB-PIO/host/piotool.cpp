@@ -0,0 +1,655 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "piolink.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Streams raw B-Channel audio from file to channel, and records audio
+// received from the same channel. Transmission is paced by reception,
+// i.e. by the S/U line clock, so host and line clocks cannot drift apart.
+//
+class AudioStreamer : public PIO_Link
+{
+    int chan;
+    FILE* inf;
+    FILE* outf;
+    long received;
+
+protected:
+
+    virtual void OnAudio( int ch, int /* seq */, const unsigned char* samples, int len )
+    {
+        if ( ch != chan )
+            return;
+
+        if ( outf )
+            fwrite( samples, 1, len, outf );
+
+        received += len;
+
+        SendNext( len );
+        }
+
+public:
+
+    AudioStreamer( int p_chan, FILE* p_inf, FILE* p_outf )
+        : chan( p_chan ), inf( p_inf ), outf( p_outf ), received( 0 )
+    {
+        }
+
+    long GetReceived( void ) const
+    {
+        return received;
+        }
+
+    void SendNext( int len )
+    {
+        unsigned char buf[ AUDIO_CHUNK ];
+
+        if ( len > AUDIO_CHUNK )
+            len = AUDIO_CHUNK;
+
+        if ( ! inf )
+            return;
+
+        int n = int( fread( buf, 1, len, inf ) );
+        if ( n < len )
+            memset( buf + n, 0xFF, len - n ); // Silence after EOF
+
+        SendAudio( chan, buf, len );
+        }
+    };
+
+///////////////////////////////////////////////////////////////////////////////
+// Sends commands one at a time and prints their acknowledgements
+//
+class CommandTool : public PIO_Link
+{
+    int l1_pending; // Events left in L1 event log after last OP_L1_EVENTS
+
+protected:
+
+    virtual void OnCommandAck( int port, int opcode, int tag, int rc,
+        const unsigned char* reply, int len )
+    {
+        if ( opcode == OP_XC_TABLE && rc == RC_OK )
+        {
+            for ( int ch = 0; ch < len; ch++ )
+            {
+                printf( "Port %d bc %d: ", ch >> 1, ch & 1 );
+
+                if ( reply[ ch ] == XC_NONE )
+                    printf( "FIFO\n" );
+                else if ( reply[ ch ] & XC_PCM )
+                    printf( "PCM slot %d\n", reply[ ch ] & ~XC_PCM );
+                else if ( reply[ ch ] == ch )
+                    printf( "loop\n" );
+                else
+                    printf( "port %d bc %d\n", reply[ ch ] >> 1, reply[ ch ] & 1 );
+                }
+            return;
+            }
+
+        if ( opcode == OP_MODERATION && len >= 11 )
+        {
+            unsigned long irqs = ( (unsigned long)reply[ 3 ] << 24 ) | ( reply[ 4 ] << 16 )
+                | ( reply[ 5 ] << 8 ) | reply[ 6 ];
+            unsigned long cycles = ( (unsigned long)reply[ 7 ] << 24 ) | ( reply[ 8 ] << 16 )
+                | ( reply[ 9 ] << 8 ) | reply[ 10 ];
+
+            printf( "%sThreshold TX %d RX %d octets, timer %d ms; %lu irqs/s, %lu bus cycles/s\n",
+                rc == RC_OK ? "" : "Rejected. ",
+                reply[ 0 ] * 16, reply[ 1 ] * 16, 1 << ( reply[ 2 ] - 2 ), irqs, cycles );
+            return;
+            }
+
+        if ( opcode == OP_B_STATS && rc == RC_OK && len >= 18 )
+        {
+            int w[ 9 ];
+            for ( int i = 0; i < 9; i++ )
+                w[ i ] = ( reply[ i * 2 ] << 8 ) | reply[ i * 2 + 1 ];
+
+            printf( "Port %d B-Channel HDLC:\n"
+                "    B-TX sent %d, underrun %d, dropped %d, queued %d\n"
+                "    B-RX frames %d, crc error %d, invalid %d, overrun %d, dropped %d\n",
+                port, w[ 0 ], w[ 1 ], w[ 2 ], w[ 3 ], w[ 4 ], w[ 5 ], w[ 6 ], w[ 7 ], w[ 8 ] );
+            return;
+            }
+
+        if ( opcode == OP_L1_LOG && rc == RC_OK && len >= 28 )
+        {
+            static const char* const bucket[ 8 ] =
+                { "<16", "<32", "<64", "<128", "<256", "<512", "<1024", ">=1024" };
+
+            int w[ 14 ];
+            for ( int i = 0; i < 14; i++ )
+                w[ i ] = ( reply[ i * 2 ] << 8 ) | reply[ i * 2 + 1 ];
+
+            printf( "Port %d L1: failed activations %d, longest %d ms\n"
+                "    T1 expired %d, T3 expired %d, T4 expired %d, F8 entered %d\n"
+                "    Activation time (ms):",
+                port, w[ 0 ], w[ 1 ], w[ 2 ], w[ 3 ], w[ 4 ], w[ 5 ] );
+
+            for ( int i = 0; i < 8; i++ )
+                printf( " %s:%d", bucket[ i ], w[ 6 + i ] );
+
+            printf( "\n" );
+            return;
+            }
+
+        if ( opcode == OP_L1_EVENTS && rc == RC_OK && len >= 3 )
+        {
+            static const char* const timer_name[ 3 ] = { "T1", "T3", "T4" };
+            static const char* const prim_name[ 4 ] =
+                { "PH-ACTIVATE req", "PH-DEACTIVATE req", "PH-ACTIVATE ind", "PH-DEACTIVATE ind" };
+
+            int dropped = ( reply[ 0 ] << 8 ) | reply[ 1 ];
+            if ( dropped && l1_pending < 0 )
+                printf( "Port %d: %d events dropped\n", port, dropped );
+
+            l1_pending = reply[ 2 ];
+
+            for ( const unsigned char* ev = reply + 3; ev + 5 <= reply + len; ev += 5 )
+            {
+                unsigned long time = ( (unsigned long)ev[ 0 ] << 24 ) | ( ev[ 1 ] << 16 )
+                    | ( ev[ 2 ] << 8 ) | ev[ 3 ];
+                int code = ev[ 4 ];
+
+                printf( "%10lu ms  port %d  ", time, port );
+
+                if ( code < 0x10 )
+                    printf( "state %d\n", code );
+                else if ( code >= 0x10 && code <= 0x12 )
+                    printf( "%s expired\n", timer_name[ code - 0x10 ] );
+                else if ( code >= 0x20 && code <= 0x23 )
+                    printf( "%s\n", prim_name[ code - 0x20 ] );
+                else
+                    printf( "event %02x\n", code );
+                }
+            return;
+            }
+
+        if ( opcode != OP_STATS || rc != RC_OK || len < 24 )
+        {
+            PIO_Link::OnCommandAck( port, opcode, tag, rc, reply, len );
+            return;
+            }
+
+        int w[ 9 ];
+        for ( int i = 0; i < 9; i++ )
+            w[ i ] = ( reply[ i * 2 ] << 8 ) | reply[ i * 2 + 1 ];
+
+        unsigned long irq_cnt = ( (unsigned long)reply[ 20 ] << 24 ) | ( reply[ 21 ] << 16 )
+            | ( reply[ 22 ] << 8 ) | reply[ 23 ];
+
+        printf( "Port %d: L1 state %d%s, irqs %lu\n"
+            "    D-TX sent %d, underrun %d, dropped %d, queued %d\n"
+            "    D-RX frames %d, crc error %d, invalid %d, overrun %d, dropped %d\n",
+            port, reply[ 18 ], reply[ 19 ] ? " (activated)" : "", irq_cnt,
+            w[ 0 ], w[ 1 ], w[ 2 ], w[ 3 ], w[ 4 ], w[ 5 ], w[ 6 ], w[ 7 ], w[ 8 ] );
+        }
+
+public:
+
+    CommandTool( void )
+        : l1_pending( -1 )
+    {
+        }
+
+    // Events left in L1 event log, -1 before first OP_L1_EVENTS
+    //
+    int GetL1Pending( void ) const
+    {
+        return l1_pending;
+        }
+
+    // Returns false if not acknowledged in time
+    //
+    bool Execute( int port, int opcode, const unsigned char* params = 0, int len = 0 )
+    {
+        if ( SendCommand( port, opcode, params, len ) < 0 )
+            return false;
+
+        for ( int i = 0; i < 10 && GetPendingCommands () > 0; i++ )
+        {
+            if ( ! Poll( 100 ) )
+                return false;
+            }
+
+        return GetPendingCommands () == 0;
+        }
+    };
+
+static int ParseHex( const char* str, unsigned char* buf, int max_len )
+{
+    int len = 0;
+
+    while ( str[ 0 ] && str[ 1 ] && len < max_len )
+    {
+        unsigned int octet;
+        if ( sscanf( str, "%2x", &octet ) != 1 )
+            break;
+
+        buf[ len++ ] = octet;
+        str += 2;
+        }
+
+    return len;
+    }
+
+static int RunCommand( const char* device, int argc, char** argv )
+{
+    const char* cmd = argv[ 0 ];
+    int port = argc >= 2 ? atoi( argv[ 1 ] ) : 0;
+
+    unsigned char par[ PIO_Link::MAX_CMD_DATA ];
+    int len = 0;
+    int opcode;
+
+    if ( strcmp( cmd, "dtx" ) == 0 && argc >= 3 )
+    {
+        // One argument per frame, as hex string
+        //
+        opcode = PIO_Link::OP_D_TX;
+
+        for ( int i = 2; i < argc; i++ )
+        {
+            int n = ParseHex( argv[ i ], par + len + 1, PIO_Link::MAX_CMD_DATA - len - 1 );
+            if ( n <= 0 )
+                return -1;
+
+            par[ len ] = n;
+            len += 1 + n;
+            }
+        }
+    else if ( strcmp( cmd, "activate" ) == 0 && argc >= 2 )
+    {
+        opcode = PIO_Link::OP_L1_ACTIVATE;
+        }
+    else if ( strcmp( cmd, "deactivate" ) == 0 && argc >= 2 )
+    {
+        opcode = PIO_Link::OP_L1_DEACTIVATE;
+        }
+    else if ( strcmp( cmd, "bchan" ) == 0 && argc >= 4 )
+    {
+        if ( strcmp( argv[ 3 ], "on" ) == 0 )
+            opcode = PIO_Link::OP_B_ENABLE;
+        else if ( strcmp( argv[ 3 ], "off" ) == 0 )
+            opcode = PIO_Link::OP_B_DISABLE;
+        else if ( strcmp( argv[ 3 ], "loop" ) == 0 )
+            opcode = PIO_Link::OP_B_LOOP;
+        else if ( strcmp( argv[ 3 ], "hdlc" ) == 0 )
+            opcode = PIO_Link::OP_B_HDLC;
+        else
+            return -1;
+
+        par[ len++ ] = atoi( argv[ 2 ] );
+        }
+    else if ( strcmp( cmd, "btx" ) == 0 && argc >= 4 )
+    {
+        // Same as dtx, after BC
+        //
+        opcode = PIO_Link::OP_B_TX;
+        par[ len++ ] = atoi( argv[ 2 ] );
+
+        for ( int i = 3; i < argc; i++ )
+        {
+            int n = ParseHex( argv[ i ], par + len + 1, PIO_Link::MAX_CMD_DATA - len - 1 );
+            if ( n <= 0 )
+                return -1;
+
+            par[ len ] = n;
+            len += 1 + n;
+            }
+        }
+    else if ( strcmp( cmd, "bstats" ) == 0 && argc >= 3 )
+    {
+        opcode = PIO_Link::OP_B_STATS;
+        par[ len++ ] = atoi( argv[ 2 ] );
+        }
+    else if ( strcmp( cmd, "xc" ) == 0 && argc >= 5 )
+    {
+        opcode = PIO_Link::OP_XC_CONNECT;
+        par[ len++ ] = atoi( argv[ 2 ] );
+        par[ len++ ] = atoi( argv[ 3 ] );
+        par[ len++ ] = atoi( argv[ 4 ] );
+        }
+    else if ( strcmp( cmd, "xcpcm" ) == 0 && argc >= 4 )
+    {
+        opcode = PIO_Link::OP_XC_PCM;
+        par[ len++ ] = atoi( argv[ 2 ] );
+        par[ len++ ] = atoi( argv[ 3 ] );
+        }
+    else if ( strcmp( cmd, "xctable" ) == 0 )
+    {
+        opcode = PIO_Link::OP_XC_TABLE;
+        port = 0;
+        }
+    else if ( strcmp( cmd, "moderation" ) == 0 )
+    {
+        // Presets per use case, or explicit values
+        //
+        opcode = PIO_Link::OP_MODERATION;
+        port = 0;
+
+        static const struct { const char* name; int tx, rx, ti; } presets[] =
+        {
+            { "voice", 1, 1, 2 }, // 16 octets, 1 ms
+            { "data",  3, 3, 2 }, // 48 octets, 1 ms
+            { "idle",  1, 1, 6 }  // 16 octets, 16 ms
+            };
+
+        if ( argc == 2 )
+        {
+            for ( unsigned int i = 0; i < sizeof( presets ) / sizeof( presets[ 0 ] ); i++ )
+            {
+                if ( strcmp( argv[ 1 ], presets[ i ].name ) == 0 )
+                {
+                    par[ len++ ] = presets[ i ].tx;
+                    par[ len++ ] = presets[ i ].rx;
+                    par[ len++ ] = presets[ i ].ti;
+                    }
+                }
+
+            if ( len == 0 )
+                return -1;
+            }
+        else if ( argc >= 4 )
+        {
+            par[ len++ ] = atoi( argv[ 1 ] );
+            par[ len++ ] = atoi( argv[ 2 ] );
+            par[ len++ ] = atoi( argv[ 3 ] );
+            }
+        }
+    else if ( strcmp( cmd, "peek" ) == 0 && argc >= 2 )
+    {
+        opcode = PIO_Link::OP_PEEK;
+        port = 0;
+        par[ len++ ] = strtol( argv[ 1 ], NULL, 16 );
+        }
+    else if ( strcmp( cmd, "poke" ) == 0 && argc >= 3 )
+    {
+        opcode = PIO_Link::OP_POKE;
+        port = 0;
+        par[ len++ ] = strtol( argv[ 1 ], NULL, 16 );
+        par[ len++ ] = strtol( argv[ 2 ], NULL, 16 );
+        }
+    else if ( strcmp( cmd, "dstats" ) == 0 && argc >= 2 )
+    {
+        opcode = PIO_Link::OP_STATS;
+        }
+    else if ( strcmp( cmd, "l1log" ) == 0 && argc >= 2 )
+    {
+        opcode = PIO_Link::OP_L1_LOG;
+        par[ len++ ] = argc >= 3 && strcmp( argv[ 2 ], "clear" ) == 0;
+        }
+    else if ( strcmp( cmd, "l1events" ) == 0 && argc >= 2 )
+    {
+        opcode = PIO_Link::OP_L1_EVENTS;
+        }
+    else if ( strcmp( cmd, "lapd" ) == 0 && argc >= 3 )
+    {
+        opcode = PIO_Link::OP_LAPD;
+
+        if ( strcmp( argv[ 2 ], "config" ) == 0 && argc >= 4 )
+        {
+            par[ len++ ] = PIO_Link::MDL_CONFIG_REQ;
+            par[ len++ ] = 1;
+            par[ len++ ] = atoi( argv[ 3 ] );
+            par[ len++ ] = argc >= 5 ? atoi( argv[ 4 ] ) : 0;
+            }
+        else if ( strcmp( argv[ 2 ], "off" ) == 0 )
+        {
+            par[ len++ ] = PIO_Link::MDL_CONFIG_REQ;
+            par[ len++ ] = 0;
+            par[ len++ ] = 127;
+            par[ len++ ] = 0;
+            }
+        else if ( strcmp( argv[ 2 ], "establish" ) == 0 )
+        {
+            par[ len++ ] = PIO_Link::DL_ESTABLISH_REQ;
+            }
+        else if ( strcmp( argv[ 2 ], "release" ) == 0 )
+        {
+            par[ len++ ] = PIO_Link::DL_RELEASE_REQ;
+            }
+        else if ( strcmp( argv[ 2 ], "send" ) == 0 && argc >= 4 )
+        {
+            par[ len++ ] = PIO_Link::DL_DATA_REQ;
+            int n = ParseHex( argv[ 3 ], par + len, PIO_Link::MAX_CMD_DATA - len );
+            if ( n <= 0 )
+                return -1;
+            len += n;
+            }
+        else
+        {
+            return -1;
+            }
+        }
+    else
+    {
+        return -1;
+        }
+
+    CommandTool pio;
+
+    if ( ! pio.Open( device ) )
+    {
+        fprintf( stderr, "Cannot open %s\n", device );
+        return -2;
+        }
+
+    if ( ! pio.Execute( port, opcode, par, len ) )
+    {
+        fprintf( stderr, "No acknowledgement\n" );
+        return -2;
+        }
+
+    // Read L1 event log until empty
+    //
+    while ( opcode == PIO_Link::OP_L1_EVENTS && pio.GetL1Pending () > 0 )
+    {
+        if ( ! pio.Execute( port, opcode ) )
+        {
+            fprintf( stderr, "No acknowledgement\n" );
+            return -2;
+            }
+        }
+
+    return 0;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Usage( void )
+{
+    fprintf( stderr,
+        "Usage: piotool <device> stream <chan> <infile|-> <outfile|-> [seconds]\n"
+        "       piotool <device> stats\n"
+        "       piotool <device> monitor [seconds]\n"
+        "       piotool <device> dtx <port> <hexframe>...\n"
+        "       piotool <device> activate|deactivate|dstats <port>\n"
+        "       piotool <device> bchan <port> <bc> on|off|loop|hdlc\n"
+        "       piotool <device> btx <port> <bc> <hexframe>...\n"
+        "       piotool <device> bstats <port> <bc>\n"
+        "       piotool <device> bert <port> <bc> 11|15|off [seconds]\n"
+        "       piotool <device> xc <port> <bc> <peer port> <peer bc>\n"
+        "       piotool <device> xcpcm <port> <bc> <slot>\n"
+        "       piotool <device> xctable\n"
+        "       piotool <device> moderation [voice|data|idle|<thres tx> <thres rx> <timer>]\n"
+        "       piotool <device> peek <reg>\n"
+        "       piotool <device> poke <reg> <value>\n"
+        "       piotool <device> lapd <port> config <tei> [k]|off|establish|release\n"
+        "       piotool <device> lapd <port> send <hexmessage>\n"
+        "       piotool <device> l1log <port> [clear]\n"
+        "       piotool <device> l1events <port>\n"
+        "\n"
+        "       <chan> is port * 2 + bc; audio files are raw octets.\n"
+        "       xc switches B-Channels in the XHFC; bchan on releases it.\n"
+        "       bchan hdlc, btx and bstats need firmware built with XHFC_B_HDLC.\n"
+        "       <reg>, <value> and frames are hex; frames are without FCS.\n"
+        "       moderation thresholds are in 16 octets, timer 2 (1 ms) .. 6 (16 ms).\n"
+        "       l1log and l1events need firmware built with XHFC_L1_LOG.\n"
+        "       bert sends PRBS 2^11-1 or 2^15-1 and checks what comes back\n"
+        "       (far end loop or test on peer); 0 seconds leaves it running.\n"
+        "       It needs firmware built with XHFC_BERT.\n" );
+    }
+
+int main( int argc, char** argv )
+{
+    if ( argc < 3 )
+    {
+        Usage ();
+        return -1;
+        }
+
+    const char* device = argv[ 1 ];
+    const char* cmd = argv[ 2 ];
+
+    if ( strcmp( cmd, "stats" ) == 0 )
+    {
+        PIO_Link pio;
+
+        if ( ! pio.Open( device ) )
+        {
+            fprintf( stderr, "Cannot open %s\n", device );
+            return -1;
+            }
+
+        pio.RequestAudioStats ();
+
+        for ( int i = 0; i < 10; i++ )
+            pio.Poll( 50 );
+
+        return 0;
+        }
+
+    if ( strcmp( cmd, "monitor" ) == 0 )
+    {
+        // Prints received D-Channel and B-Channel HDLC frames
+        //
+        int seconds = argc >= 4 ? atoi( argv[ 3 ] ) : 10;
+
+        PIO_Link pio;
+
+        if ( ! pio.Open( device ) )
+        {
+            fprintf( stderr, "Cannot open %s\n", device );
+            return -1;
+            }
+
+        time_t end = time( NULL ) + seconds;
+
+        while ( time( NULL ) < end )
+        {
+            if ( ! pio.Poll( 100 ) )
+                break;
+            }
+
+        fprintf( stderr, "Lost D frames %d/%d, lost traces %d, bad frames %d\n",
+            pio.GetLostDFrames( 0 ), pio.GetLostDFrames( 1 ), pio.GetLostTraces (),
+            pio.GetBadFrames () );
+
+        return 0;
+        }
+
+    if ( strcmp( cmd, "bert" ) == 0 && argc >= 6 )
+    {
+        // Runs bit error rate test for some seconds, or stops it; results
+        // are printed every second
+        //
+        unsigned char par[ 2 ];
+        par[ 0 ] = atoi( argv[ 4 ] );
+        par[ 1 ] = strcmp( argv[ 5 ], "off" ) == 0 ? 0 : atoi( argv[ 5 ] );
+
+        int port = atoi( argv[ 3 ] );
+        int seconds = argc >= 7 ? atoi( argv[ 6 ] ) : 10;
+
+        CommandTool pio;
+
+        if ( ! pio.Open( device ) )
+        {
+            fprintf( stderr, "Cannot open %s\n", device );
+            return -1;
+            }
+
+        if ( ! pio.Execute( port, PIO_Link::OP_BERT, par, 2 ) )
+        {
+            fprintf( stderr, "No acknowledgement\n" );
+            return -2;
+            }
+
+        if ( par[ 1 ] == 0 || seconds == 0 )
+            return 0;
+
+        time_t end = time( NULL ) + seconds;
+
+        while ( time( NULL ) < end )
+        {
+            if ( ! pio.Poll( 100 ) )
+                break;
+            }
+
+        par[ 1 ] = 0;
+        pio.Execute( port, PIO_Link::OP_BERT, par, 2 );
+
+        return 0;
+        }
+
+    if ( strcmp( cmd, "stream" ) == 0 && argc >= 6 )
+    {
+        int chan = atoi( argv[ 3 ] );
+        int seconds = argc >= 7 ? atoi( argv[ 6 ] ) : 10;
+
+        FILE* inf = strcmp( argv[ 4 ], "-" ) ? fopen( argv[ 4 ], "rb" ) : NULL;
+        FILE* outf = strcmp( argv[ 5 ], "-" ) ? fopen( argv[ 5 ], "wb" ) : NULL;
+
+        AudioStreamer pio( chan, inf, outf );
+
+        if ( ! pio.Open( device ) )
+        {
+            fprintf( stderr, "Cannot open %s\n", device );
+            return -1;
+            }
+
+        pio.StartAudio( chan );
+
+        // Prime device TX ring with 2ms of audio
+        //
+        pio.SendNext( PIO_Link::AUDIO_CHUNK );
+        pio.SendNext( PIO_Link::AUDIO_CHUNK );
+
+        long target = long( seconds ) * 8000;
+
+        while ( pio.GetReceived () < target )
+        {
+            if ( ! pio.Poll( 100 ) )
+                break;
+            }
+
+        pio.StopAudio( chan );
+        pio.RequestAudioStats ();
+
+        for ( int i = 0; i < 10; i++ )
+            pio.Poll( 50 );
+
+        fprintf( stderr, "Received %ld octets, lost %d frames, bad frames %d\n",
+            pio.GetReceived (), pio.GetLostAudioFrames( chan ), pio.GetBadFrames () );
+
+        if ( inf )
+            fclose( inf );
+        if ( outf )
+            fclose( outf );
+
+        return 0;
+        }
+
+    int rc = RunCommand( device, argc - 2, argv + 2 );
+    if ( rc != -1 )
+        return rc;
+
+    Usage ();
+    return -1;
+    }
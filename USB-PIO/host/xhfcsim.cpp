@@ -0,0 +1,822 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// xhfcsim: Runs the XHFC driver (xhfc.h) on the host against XHFC_Model
+//
+// Build (mISDN headers as for the firmware):
+//
+//     g++ -Wall -I<mISDN include dir> -o xhfcsim xhfcsim.cpp
+//
+// Add -DXHFC_B_HDLC, -DXHFC_L1_LOG, -DXHFC_BERT, -DXHFC_NO_ADDR_CACHE or -DXHFC_MAX_CHIPS=2
+// -DXHFC_MAX_PORTS=8 to run the driver in these configurations.
+//
+// Scenarios run in fixed order from power-on and are deterministic. The
+// main loop is emulated frame by frame: the top half runs whenever INT#
+// is asserted, followed by the bottom half. Bus cycles are counted in 1ms
+// windows and reported for idle and loaded system.
+//
+
+#ifndef XHFC_SIM
+#define XHFC_SIM
+#endif
+
+#define _delay_us( us )
+
+#include "../xhfc.h"
+#include "xhfcsim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Register model and the driver under test
+
+static XHFC_Model model[ XHFC_MAX_CHIPS ];
+static bool verbose = false;
+
+int XHFC_SimRead( int chip, bool addr_reg )
+{
+    return model[ chip ].Read( addr_reg );
+    }
+
+void XHFC_SimWrite( int chip, bool addr_reg, int value )
+{
+    model[ chip ].Write( addr_reg, value );
+    }
+
+bool XHFC_SimIrq( void )
+{
+    for ( int c = 0; c < XHFC_MAX_CHIPS; c++ )
+    {
+        if ( model[ c ].IsIrqAsserted () )
+            return true;
+        }
+
+    return false;
+    }
+
+int XHFC_HW::addr_latch[ XHFC_MAX_CHIPS ];
+
+#ifdef XHFC_BENCHMARK
+unsigned long XHFC_HW::addr_cycles = 0;
+unsigned long XHFC_HW::data_cycles = 0;
+#endif
+
+XHFC hfc;
+
+// tracef() as formatted by the host for TRACE frames; printed with -v only
+//
+void tracef( const char* format... )
+{
+    if ( ! verbose )
+        return;
+
+    va_list marker;
+    va_start( marker, format );
+
+    printf( "    " );
+
+    for ( const char* f = format; *f; f++ )
+    {
+        if ( *f != '%' || f[ 1 ] == 0 )
+        {
+            putchar( *f );
+            continue;
+            }
+
+        switch( *++f )
+        {
+            case 'c':
+                printf( "%02X", va_arg( marker, int ) & 0xFF );
+                break;
+
+            case 's':
+                printf( "%04X", va_arg( marker, int ) & 0xFFFF );
+                break;
+
+            case 'l':
+                printf( "%08lX", va_arg( marker, long ) & 0xFFFFFFFFL );
+                break;
+
+            case 'a':
+            {
+                const unsigned char* p = va_arg( marker, const unsigned char* );
+                int count = va_arg( marker, int );
+                for ( int i = 0; i < count; i++ )
+                    printf( i ? " %02X" : "%02X", p[ i ] );
+                }
+                break;
+
+            default:
+                putchar( *f );
+                break;
+            }
+        }
+
+    printf( "\n" );
+
+    va_end( marker );
+    }
+
+#ifdef XHFC_LAPD
+void D_TimerTick( int, int )
+{
+    }
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// B-Channel hooks: every channel sends a counting sequence; received data
+// is checked for continuity.
+
+struct B_Check
+{
+    unsigned char tx_next;
+    int  rx_expected;           // -1 after reset or underrun
+    long rx_octets;
+    long rx_errors;             // Octets out of sequence
+    long rx_underruns;          // Services without data
+    };
+
+static B_Check bcheck[ 2 * XHFC_MAX_PORTS ];
+
+static void ResetBChecks( void )
+{
+    for ( int ch = 0; ch < 2 * XHFC_MAX_PORTS; ch++ )
+    {
+        bcheck[ ch ].rx_expected = -1;
+        bcheck[ ch ].rx_octets = 0;
+        bcheck[ ch ].rx_errors = 0;
+        bcheck[ ch ].rx_underruns = 0;
+        }
+    }
+
+#ifdef XHFC_BERT
+
+///////////////////////////////////////////////////////////////////////////////
+// Bit error rate tester: BERT records are collected from USB_Link; errors
+// and slips are injected into the data the tester sees
+
+#include "../bert.h"
+
+static unsigned char usb_out[ 1024 ];
+static int usb_out_len = 0;
+
+bool usb_TxReady( void )
+{
+    return true;
+    }
+
+void usb_Put( int ch )
+{
+    if ( usb_out_len < int( sizeof( usb_out ) ) )
+        usb_out[ usb_out_len++ ] = ch;
+    }
+
+static USB_Link usb_link;
+BER_Tester bert( usb_link );
+
+static int bert_tx_errors = 0;  // Octets to send with bit 0 inverted
+static int bert_rx_slips = 0;   // RX services to overwrite an octet in
+
+#endif
+
+void B_TX_Data( int chan, unsigned char* data, int len )
+{
+#ifdef XHFC_BERT
+    if ( bert.IsRunning( chan ) )
+    {
+        bert.OnTxData( chan, data, len );
+
+        for ( int i = 0; i < len && chan == 0 && bert_tx_errors > 0; i++, bert_tx_errors-- )
+            data[ i ] ^= 0x01;
+        return;
+        }
+#endif
+
+    for ( int i = 0; i < len; i++ )
+        data[ i ] = bcheck[ chan ].tx_next++;
+    }
+
+void B_RX_Data( int chan, const unsigned char* data, int len, int discarded )
+{
+#ifdef XHFC_BERT
+    if ( bert.IsRunning( chan ) )
+    {
+        unsigned char buf[ 16 ];
+
+        if ( data && chan == 0 && bert_rx_slips > 0 && len <= 16 )
+        {
+            // Last octet replaced by the one before: a repeated and a
+            // skipped octet
+            //
+            memcpy( buf, data, len );
+            buf[ len - 1 ] = buf[ len - 2 ];
+            data = buf;
+            --bert_rx_slips;
+            }
+
+        bert.OnRxData( chan, data, len, discarded );
+        return;
+        }
+#endif
+
+    B_Check& bc = bcheck[ chan ];
+
+    if ( ! data )
+    {
+        ++bc.rx_underruns;
+        bc.rx_expected = -1;
+        return;
+        }
+
+    if ( discarded )
+        bc.rx_expected = -1;
+
+    for ( int i = 0; i < len; i++ )
+    {
+        if ( bc.rx_expected >= 0 && data[ i ] != bc.rx_expected )
+            ++bc.rx_errors;
+
+        bc.rx_expected = ( data[ i ] + 1 ) & 0xFF;
+        }
+
+    bc.rx_octets += len;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+// Main loop emulation and bus cycle statistics
+
+struct BusStats
+{
+    unsigned long windows;      // 1ms windows
+    unsigned long addr;         // Address cycles
+    unsigned long data;         // Data cycles
+    unsigned long max_addr;     // Max. address cycles in one window
+    unsigned long max_data;
+    unsigned long irqs;         // Top halves which scheduled bottom half
+    };
+
+static BusStats bus;
+
+static void GetCycles( unsigned long& addr, unsigned long& data )
+{
+    addr = data = 0;
+
+    for ( int c = 0; c < XHFC_MAX_CHIPS; c++ )
+    {
+        addr += model[ c ].addr_writes + model[ c ].addr_reads;
+        data += model[ c ].data_writes + model[ c ].data_reads;
+        }
+    }
+
+// Runs system for ms milliseconds
+//
+static void Run( int ms )
+{
+    for ( int w = 0; w < ms; w++ )
+    {
+        unsigned long addr0, data0;
+        GetCycles( addr0, data0 );
+
+        for ( int i = 0; i < XHFC_Model::STEP_PER_MS; i++ )
+        {
+            for ( int c = 0; c < XHFC_MAX_CHIPS; c++ )
+                model[ c ].Step ();
+
+            if ( XHFC_SimIrq () && hfc.InterruptHandler () )
+            {
+                ++bus.irqs;
+                hfc.BottomHalf_EH ();
+                }
+            }
+
+        unsigned long addr1, data1;
+        GetCycles( addr1, data1 );
+
+        ++bus.windows;
+        bus.addr += addr1 - addr0;
+        bus.data += data1 - data0;
+        if ( addr1 - addr0 > bus.max_addr )
+            bus.max_addr = addr1 - addr0;
+        if ( data1 - data0 > bus.max_data )
+            bus.max_data = data1 - data0;
+        }
+    }
+
+static void ResetBusStats( void )
+{
+    memset( &bus, 0, sizeof( bus ) );
+    }
+
+static void ReportBusStats( const char* name )
+{
+    unsigned long n = bus.windows ? bus.windows : 1;
+
+    printf( "bench %-14s %5lu ms, %4lu irqs/s, bus cycles per ms: "
+        "addr avg %5.1f max %3lu, data avg %6.1f max %4lu\n",
+        name, bus.windows, bus.irqs * 1000 / n,
+        double( bus.addr ) / n, bus.max_addr,
+        double( bus.data ) / n, bus.max_data );
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+// Scenarios
+
+static int failures = 0;
+
+static bool Check( const char* name, bool ok, const char* why = "" )
+{
+    printf( "%-20s %s%s%s\n", name, ok ? "ok" : "FAILED", ok ? "" : ": ", ok ? "" : why );
+
+    if ( ! ok )
+        ++failures;
+
+    return ok;
+    }
+
+// Copies oldest frame of ring; returns its length
+//
+static int GetFrame( FrameRing& ring, unsigned char* buf )
+{
+    int len = ring.GetLen ();
+
+    for ( int offset = 0; offset < len; )
+    {
+        const unsigned char* p;
+        int n = ring.GetChunk( offset, p );
+        if ( n > len - offset )
+            n = len - offset;
+
+        memcpy( buf + offset, p, n );
+        offset += n;
+        }
+
+    ring.Pop ();
+    return len;
+    }
+
+// Received frame: DATA, FCS (2 octets), STAT
+//
+static bool CheckFrame( const unsigned char* rx, int rx_len,
+    const unsigned char* tx, int tx_len, bool crc_ok )
+{
+    if ( rx_len != tx_len + 3 || memcmp( rx, tx, tx_len ) != 0 )
+        return false;
+
+    if ( crc_ok != ( rx[ rx_len - 1 ] == 0 ) )
+        return false;
+
+    // FCS over data and FCS gives the good residue
+    //
+    unsigned short crc = 0xFFFF;
+    for ( int i = 0; i < tx_len + 2; i++ )
+    {
+        crc ^= rx[ i ];
+        for ( int b = 0; b < 8; b++ )
+            crc = ( crc & 1 ) ? ( crc >> 1 ) ^ 0x8408 : crc >> 1;
+        }
+
+    return crc == 0xF0B8;
+    }
+
+static bool AllActivated( bool activated )
+{
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        if ( hfc.port[ pt ].IsActivated () != activated )
+            return false;
+        }
+
+    return true;
+    }
+
+// Port connected to pt by the cable (pt itself if none)
+//
+static int GetPeer( int pt )
+{
+    int first = pt & ~1;
+    return first + 1 < hfc.GetPortCount ()
+        && hfc.port[ first ].GetChip () == hfc.port[ first + 1 ].GetChip ()
+        ? pt ^ 1 : pt;
+    }
+
+static void TestInitialize( int chip_id, int ports_per_chip )
+{
+    // Interfaces beyond XHFC_MAX_PORTS are left unused by the driver, so
+    // they are not modelled; a lone interface then sees the ideal peer
+    //
+    for ( int c = 0; c < XHFC_MAX_CHIPS; c++ )
+    {
+        int ports = XHFC_MAX_PORTS - c * ports_per_chip;
+        if ( ports <= 0 || ports > ports_per_chip )
+            ports = ports_per_chip;
+        model[ c ].Reset( chip_id, ports );
+        }
+
+    int expected = XHFC_MAX_CHIPS * ports_per_chip;
+    if ( expected > XHFC_MAX_PORTS )
+        expected = XHFC_MAX_PORTS;
+
+    // Even ports are NT, so that every cable has NT and TE end; a port
+    // without cable is TE, so that it activates towards the ideal NT
+    //
+    int nt_modes = ports_per_chip > 1 ? 0x55 : 0x00;
+    if ( expected & 1 )
+        nt_modes &= ~( 1 << ( expected - 1 ) );
+
+    bool ok = hfc.Initialize( nt_modes );
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+        hfc.port[ pt ].Startup ();
+
+    Check( "initialize", ok && hfc.GetPortCount () == expected, "chip not detected" );
+
+    ResetBusStats ();
+    Run( 100 );
+
+    Check( "timer irq", bus.irqs >= 100 && bus.irqs <= 110, "not one per ms" );
+    Check( "f0 counter", hfc.GetF0Count () >= 100 * XHFC_Model::STEP_PER_MS - 8, "not counting" );
+
+    ReportBusStats( "deactivated" );
+    }
+
+static void TestActivation( void )
+{
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        if ( ! hfc.port[ pt ].IsNT () )
+            hfc.port[ pt ].PH_ActivateRequest ();
+        }
+
+    Run( 50 );
+
+    Check( "L1 activation", AllActivated( true ), "port not activated" );
+    }
+
+static void TestDChannel( void )
+{
+    static const int lens[] = { 3, 20, 45 };
+    unsigned char frame[ 64 ];
+    unsigned char rx[ 80 ];
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        for ( int i = 0; i < 3; i++ )
+        {
+            for ( int j = 0; j < lens[ i ]; j++ )
+                frame[ j ] = pt * 16 + i + j;
+
+            FrameRing& ring = hfc.port[ pt ].Get_D_TX_Ring ();
+            ring.Put( frame, lens[ i ] );
+            ring.Commit ();
+            }
+        }
+
+    Run( 200 );
+
+    bool ok = true;
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        int src = GetPeer( pt );
+        FrameRing& ring = hfc.port[ pt ].Get_D_RX_Ring ();
+
+        for ( int i = 0; i < 3; i++ )
+        {
+            for ( int j = 0; j < lens[ i ]; j++ )
+                frame[ j ] = src * 16 + i + j;
+
+            if ( ring.IsEmpty ()
+                || ! CheckFrame( rx, GetFrame( ring, rx ), frame, lens[ i ], true ) )
+            {
+                ok = false;
+                }
+            }
+
+        ok = ok && ring.IsEmpty () && hfc.port[ pt ].Get_D_TX_Ring ().IsEmpty ();
+        }
+
+    Check( "D-Channel frames", ok, "frame lost or corrupted" );
+
+    // CRC error on port 0
+    //
+    int pt = 0;
+    int src = GetPeer( pt );
+    int crc_errors = hfc.port[ pt ].Get_D_Channel ().rx_crc_error;
+
+    model[ hfc.port[ pt ].GetChip () ].InjectCrcError( 0 );
+
+    FrameRing& tx = hfc.port[ src ].Get_D_TX_Ring ();
+    tx.Put( frame, 10 );
+    tx.Commit ();
+
+    Run( 20 );
+
+    FrameRing& ring = hfc.port[ pt ].Get_D_RX_Ring ();
+    ok = ! ring.IsEmpty ()
+        && CheckFrame( rx, GetFrame( ring, rx ), frame, 10, false )
+        && hfc.port[ pt ].Get_D_Channel ().rx_crc_error == crc_errors + 1;
+
+    Check( "D-Channel CRC error", ok, "not reported" );
+    }
+
+static void TestBChannels( void )
+{
+    Run( 200 ); // Let jitter buffers settle
+
+    ResetBChecks ();
+    ResetBusStats ();
+
+    Run( 1000 );
+
+    bool ok = true;
+    char why[ 80 ] = "";
+
+    for ( int ch = 0; ch < 2 * hfc.GetPortCount (); ch++ )
+    {
+        const B_Check& bc = bcheck[ ch ];
+
+        if ( bc.rx_errors || bc.rx_underruns || bc.rx_octets < 8000 - 16 || bc.rx_octets > 8000 + 16 )
+        {
+            sprintf( why, "B%d: %ld octets, %ld errors, %ld underruns",
+                ch, bc.rx_octets, bc.rx_errors, bc.rx_underruns );
+            ok = false;
+            }
+        }
+
+    Check( "B-Channel streams", ok, why );
+
+    ReportBusStats( "B-Channels" );
+    }
+
+#ifdef XHFC_B_HDLC
+static void TestBChannelHDLC( void )
+{
+    unsigned char frame[ 64 ];
+    unsigned char rx[ 80 ];
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+        hfc.port[ pt ].Connect_B_Channel( 1, true );
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        for ( int j = 0; j < 60; j++ )
+            frame[ j ] = pt + j;
+
+        FrameRing& ring = hfc.port[ pt ].Get_B_HDLC( 1 ).tx_ring;
+        ring.Put( frame, 60 );
+        ring.Commit ();
+        }
+
+    Run( 20 );
+
+    bool ok = true;
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        for ( int j = 0; j < 60; j++ )
+            frame[ j ] = GetPeer( pt ) + j;
+
+        FrameRing& ring = hfc.port[ pt ].Get_B_HDLC( 1 ).rx_ring;
+        if ( ring.IsEmpty () || ! CheckFrame( rx, GetFrame( ring, rx ), frame, 60, true ) )
+            ok = false;
+
+        hfc.port[ pt ].Connect_B_Channel( 1 );
+        }
+
+    Check( "B-Channel HDLC", ok, "frame lost or corrupted" );
+    }
+#endif
+
+static void TestLostFraming( void )
+{
+    int pt = 1 < hfc.GetPortCount () ? 1 : 0;
+    int chip = hfc.port[ pt ].GetChip ();
+
+    int first = pt; // First port of the chip
+    while ( first > 0 && hfc.port[ first - 1 ].GetChip () == chip )
+        --first;
+
+    model[ chip ].LoseFraming( pt - first, 3 * XHFC_Model::STEP_PER_MS );
+
+    Run( 2 );
+    bool lost = hfc.port[ pt ].GetL1State () == XHFC_Model::TE_F8;
+
+    Run( 20 );
+
+    Check( "F8 lost framing", lost && hfc.port[ pt ].GetL1State () == XHFC_Model::TE_F7
+        && hfc.port[ pt ].IsActivated (), "no recovery to F7" );
+    }
+
+#ifdef XHFC_L1_LOG
+
+// Every port activated once, the F8 port has seen F8 and F7 again
+//
+static void TestL1Log( void )
+{
+    bool ok = true;
+    int f8_port = 1 < hfc.GetPortCount () ? 1 : 0;
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        L1_Log& log = hfc.port[ pt ].Get_L1_Log ();
+
+        int activations = 0;
+        for ( int i = 0; i < L1_Log::HIST_BUCKETS; i++ )
+            activations += log.hist[ i ];
+
+        bool f8 = false;
+        int n = 0;
+        L1_Log::Event ev;
+        unsigned long last = 0;
+
+        while ( log.Get( ev ) )
+        {
+            if ( ev.time < last )
+                ok = false;
+            last = ev.time;
+
+            if ( ev.code == ( L1_Log::EV_STATE | XHFC_Model::TE_F8 ) )
+                f8 = true;
+            ++n;
+            }
+
+        if ( activations != 1 || log.failed || log.t3_expired || n == 0 )
+            ok = false;
+
+        if ( pt == f8_port && ! hfc.port[ pt ].IsNT ()
+            && ( log.lost_framing != 1 || ( ! f8 && ! log.dropped ) ) )
+            ok = false;
+        }
+
+    Check( "L1 event log", ok, "activation or F8 not logged" );
+    }
+
+#endif
+
+#ifdef XHFC_BERT
+
+// PRBS on all B-Channels, every channel checks its peer; bit errors are
+// sent on channel 0, slips are made on RX of channel 0 (two per service)
+//
+static void TestBERT( void )
+{
+    static const int pattern[ 2 ] = { BER_Tester::PRBS_11, BER_Tester::PRBS_15 };
+
+    bool ok = true;
+    char why[ 80 ] = "";
+
+    for ( int p = 0; p < 2; p++ )
+    {
+        for ( int ch = 0; ch < 2 * hfc.GetPortCount (); ch++ )
+            bert.Start( ch, pattern[ p ] );
+
+        Run( 200 );
+        bert.SendRecords (); // Sync period
+
+        bert_tx_errors = 10;
+        bert_rx_slips = 3;
+
+        Run( 1000 );
+
+        usb_out_len = 0;
+        bert.SendRecords ();
+
+        // FLG1, FLG2, BC, CTL, ADDR, PATTERN, FLAGS, SEQ, BITS, ERRORS,
+        // SLIPS, LOSSES, ...
+        //
+        for ( int i = 0; i + 5 < usb_out_len; i += 2 + usb_out[ i + 2 ] )
+        {
+            const unsigned char* rec = usb_out + i + 5;
+            int ch = usb_out[ i + 4 ];
+            int bits = ( rec[ 3 ] << 8 ) | rec[ 4 ];
+            int errors = ( rec[ 5 ] << 8 ) | rec[ 6 ];
+            int slips = ( rec[ 7 ] << 8 ) | rec[ 8 ];
+            int losses = ( rec[ 9 ] << 8 ) | rec[ 10 ];
+
+            // Errors sent on channel 0 arrive at its peer
+            //
+            int exp_errors = ch == 2 * GetPeer( 0 ) ? 10 : 0;
+            int exp_slips = ch == 0 ? 2 * 3 : 0;
+
+            if ( rec[ 0 ] != pattern[ p ] || ! ( rec[ 1 ] & BER_Tester::FL_SYNC )
+                || bits < 63800 || errors != exp_errors || slips != exp_slips || losses )
+            {
+                sprintf( why, "PRBS %d B%d: %d bits, %d errors, %d slips, %d losses",
+                    pattern[ p ], ch, bits, errors, slips, losses );
+                ok = false;
+                }
+            }
+
+        if ( usb_out_len == 0 )
+            ok = false;
+        }
+
+    for ( int ch = 0; ch < 2 * hfc.GetPortCount (); ch++ )
+        bert.Start( ch, BER_Tester::PRBS_OFF );
+
+    Check( "BERT", ok, why );
+    }
+
+#endif
+
+static void TestDeactivation( void )
+{
+    int nt_ports = 0;
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        if ( hfc.port[ pt ].IsNT () )
+        {
+            hfc.port[ pt ].PH_DeactivateRequest ();
+            ++nt_ports;
+            }
+        }
+
+    Run( 600 ); // T4 in TE
+
+    // TE port without cable stays activated by its ideal NT
+    //
+    bool deactivated = true;
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        if ( hfc.port[ pt ].IsActivated () && GetPeer( pt ) != pt )
+            deactivated = false;
+        }
+
+    if ( nt_ports )
+        Check( "L1 deactivation", deactivated, "port still activated" );
+    else
+        printf( "%-20s skipped: no NT\n", "L1 deactivation" );
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        hfc.port[ pt ].Disable_B_Channel( 0 );
+        hfc.port[ pt ].Disable_B_Channel( 1 );
+        }
+
+    ResetBusStats ();
+    Run( 1000 );
+    ReportBusStats( "B off 1ms" );
+
+    bool ok = hfc.SetModeration( 1, 1, 6 );
+
+    ResetBusStats ();
+    Run( 1000 );
+
+    Check( "moderation", ok && bus.irqs <= 1000 / 16 + 1, "timer not slowed down" );
+    ReportBusStats( "B off 16ms" );
+
+    // Transparent FIFOs are serviced every 1ms tick
+    //
+    hfc.Connect_B_Channel( 0 );
+
+    Check( "moderation reset", hfc.GetTickMs () == 1, "tick kept with transparent B FIFO" );
+
+    hfc.port[ 0 ].Disable_B_Channel( 0 );
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main( int argc, char** argv )
+{
+    int chip_id = CHIP_ID_2SU;
+    int ports = 2;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strcmp( argv[ i ], "-v" ) == 0 )
+            verbose = true;
+        else if ( strcmp( argv[ i ], "1su" ) == 0 )
+            chip_id = CHIP_ID_1SU, ports = 1;
+        else if ( strcmp( argv[ i ], "2su" ) == 0 )
+            chip_id = CHIP_ID_2SU, ports = 2;
+        else if ( strcmp( argv[ i ], "4su" ) == 0 )
+            chip_id = CHIP_ID_4SU, ports = 4;
+        else
+        {
+            fprintf( stderr, "Usage: xhfcsim [-v] [1su|2su|4su]\n" );
+            return -1;
+            }
+        }
+
+    TestInitialize( chip_id, ports );
+    TestActivation ();
+    TestDChannel ();
+    TestBChannels ();
+#ifdef XHFC_B_HDLC
+    TestBChannelHDLC ();
+#endif
+    TestLostFraming ();
+#ifdef XHFC_L1_LOG
+    TestL1Log ();
+#endif
+#ifdef XHFC_BERT
+    TestBERT ();
+#endif
+    TestDeactivation ();
+
+    printf( "%d failed\n", failures );
+
+    return failures ? 1 : 0;
+    }
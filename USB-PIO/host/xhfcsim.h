@@ -0,0 +1,818 @@
+#ifndef _XHFCSIM_H_INCLUDED
+#define _XHFCSIM_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+// XHFC_Model Class: Behavioral model of one XHFC chip for host builds of
+// xhfc.h (XHFC_SIM)
+//
+// Models only what the driver uses: address register, FIFO selection,
+// Z1/Z2/F1/F2 counters and data of every FIFO, FIFO thresholds and
+// interrupts, R_IRQ_OVIEW, R_MISC_IRQ with the timer, R_SU_IRQ and
+// A_SU_RD_STA state transitions, and the F0 counter. Registers without
+// model are stored on write and read back as written.
+//
+// Time advances in 125us frames with Step(). S/U interfaces 0-1 and 2-3 are
+// connected by a cable, which needs NT mode at one end and TE at the other;
+// an interface without partner sees an ideal peer (NT for TE, TE for NT)
+// and gets its own B- and D-Channel data looped back. Transparent FIFOs
+// run with the frame clock, receiving all ones unless both ends are
+// activated; HDLC data flows only while both ends are activated.
+// B-Channels run at 64 kbit/s, D-Channel at 16 kbit/s (one octet every
+// 4 frames), without bit stuffing.
+//
+// Bus cycles are counted per kind, for benchmarks of the driver.
+//
+class XHFC_Model
+{
+public:
+
+    enum // instead of #defines
+    {
+        MAX_PORTS         = 4,
+        MAX_FIFOS         = 16,   // Per direction
+        MAX_DEPTH         = 256,
+        MAX_FRAMES        = 8,    // F counter modulus
+
+        STEP_PER_MS       = 8,    // 125us frames per ms
+        L1_DELAY          = 8,    // Frames per L1 state transition
+        D_OCTET_STEPS     = 4,    // Frames per D-Channel octet
+
+        // A_SU_RD_STA states, as in XHFC_Port
+        //
+        TE_F3             = 3,
+        TE_F6             = 6,
+        TE_F7             = 7,
+        TE_F8             = 8,
+        NT_G1             = 1,
+        NT_G2             = 2,
+        NT_G3             = 3,
+        NT_G4             = 4,
+
+        // R_IRQ_OVIEW bits
+        //
+        OVIEW_MISC        = 0x10, // Blocks 0..3 are bits 0..3
+        OVIEW_SU          = 0x40,
+
+        // Values written by the driver
+        //
+        WR_STA_ACT_MASK   = 0x60,
+        WR_STA_ACTIVATE   = 0x60,
+        WR_STA_DEACTIVATE = 0x40,
+        CON_HDLC_TRP      = 0x02, // A_CON_HDLC transparent mode
+        CON_HDLC_FLOW     = 0xE0, // A_CON_HDLC data flow; 0 = FIFO <-> S/U
+        RX_STAT_CRC_ERROR = 0x01  // Last octet of received frame
+        };
+
+    // Bus cycles since reset
+    //
+    unsigned long addr_writes;
+    unsigned long addr_reads;
+    unsigned long data_reads;
+    unsigned long data_writes;
+
+private:
+
+    struct FIFO
+    {
+        unsigned char data[ MAX_DEPTH ];
+        int z1;                 // Write position
+        int z2;                 // Read position
+        int f1;                 // Frames written
+        int f2;                 // Frames read
+        int frame_end[ MAX_FRAMES ]; // z1 at end of frame f
+        int con_hdlc;
+        int fifo_ctrl;
+        bool err;               // Overflow (A_FIFO_STA M_FIFO_ERR)
+
+        unsigned short crc;     // HDLC: FCS of octets sent or received
+        };
+
+    struct Port
+    {
+        int su_ctrl0;
+        int su_ctrl2;
+        int state;              // A_SU_RD_STA
+        int delay;              // Frames until next state transition
+        bool enabled;           // State machine released by A_SU_WR_STA
+        bool act_req;           // Activation requested
+        bool deact_req;         // NT: deactivation requested
+        bool g2_g3;             // NT: M_SU_SET_G2_G3 written
+        int lost_framing;       // TE: frames left in F8
+        bool crc_error;         // Next received D-Channel frame has CRC error
+        };
+
+    int chip_id;
+    int reg[ 256 ];             // Registers without model
+    int addr;                   // Address register
+
+    int depth;                  // Octets per FIFO
+    int thres_tx;               // Octets
+    int thres_rx;
+    int fifo_sel;               // Selected FIFO: number * 2 + direction (RX = 1)
+    int su_sel;
+
+    FIFO fifo[ MAX_FIFOS ][ 2 ];
+    Port port[ MAX_PORTS ];
+    int num_ports;
+
+    int irq_ctrl;
+    int misc_irq;
+    int misc_irqmsk;
+    int su_irq;
+    int su_irqmsk;
+    int fifo_irq[ MAX_PORTS ];  // Block irq bits: FIFO number % 4 * 2 + direction
+
+    int timer_ti;               // R_TI_WD
+    int timer_cnt;              // Frames until timer interrupt
+    unsigned short f0_cnt;      // F0 counter (frames)
+    int f0_high;                // Latched at R_F0_CNTL read
+    unsigned long steps;
+
+    static unsigned short CrcUpdate( unsigned short crc, int octet )
+    {
+        crc ^= octet;
+
+        for ( int i = 0; i < 8; i++ )
+            crc = ( crc & 1 ) ? ( crc >> 1 ) ^ 0x8408 : crc >> 1;
+
+        return crc;
+        }
+
+    FIFO& Selected( void )
+    {
+        return fifo[ ( fifo_sel >> 1 ) & ( MAX_FIFOS - 1 ) ][ fifo_sel & 1 ];
+        }
+
+    int Usage( const FIFO& f ) const
+    {
+        return ( f.z1 - f.z2 ) & ( depth - 1 );
+        }
+
+    static bool IsHDLC( const FIFO& f )
+    {
+        return ! ( f.con_hdlc & CON_HDLC_TRP );
+        }
+
+    static bool IsOnLine( const FIFO& f )
+    {
+        return ( f.con_hdlc & CON_HDLC_FLOW ) == 0;
+        }
+
+    void ResetFIFO( FIFO& f )
+    {
+        f.z1 = f.z2 = 0;
+        f.f1 = f.f2 = 0;
+        f.err = false;
+        f.crc = 0xFFFF;
+        }
+
+    void SetFifoIrq( int num, int dir )
+    {
+        if ( fifo[ num ][ dir ].fifo_ctrl & M_FIFO_IRQMSK )
+            fifo_irq[ num >> 2 ] |= 1 << ( ( num & 3 ) * 2 + dir );
+        }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    // Octet received from line into RX FIFO
+    //
+    void PutOctet( int num, int octet )
+    {
+        FIFO& f = fifo[ num ][ 1 ];
+
+        if ( Usage( f ) >= depth - 1 )
+        {
+            f.err = true;
+            return;
+            }
+
+        f.data[ f.z1 ] = octet;
+        f.z1 = ( f.z1 + 1 ) & ( depth - 1 );
+
+        if ( ! IsHDLC( f ) && Usage( f ) == thres_rx + 1 )
+            SetFifoIrq( num, 1 );
+        }
+
+    void PutFrameEnd( int num, bool crc_error )
+    {
+        FIFO& f = fifo[ num ][ 1 ];
+
+        if ( ( ( f.f1 - f.f2 ) & ( MAX_FRAMES - 1 ) ) == MAX_FRAMES - 1 )
+        {
+            f.err = true;
+            return;
+            }
+
+        unsigned short fcs = ~f.crc;
+        PutOctet( num, fcs & 0xFF );
+        PutOctet( num, fcs >> 8 );
+        PutOctet( num, crc_error ? RX_STAT_CRC_ERROR : 0x00 );
+
+        f.frame_end[ f.f1 ] = f.z1;
+        f.f1 = ( f.f1 + 1 ) & ( MAX_FRAMES - 1 );
+        f.crc = 0xFFFF;
+
+        SetFifoIrq( num, 1 );
+        }
+
+    // Transparent B-Channel FIFOs of all interfaces for one frame: TX FIFO
+    // is drained (all ones on underrun), RX FIFO gets the octet from the
+    // line or all ones
+    //
+    void StepTransparent( void )
+    {
+        int line[ MAX_PORTS ][ 2 ];
+
+        for ( int pt = 0; pt < num_ports; pt++ )
+        {
+            for ( int ch = 0; ch < 2; ch++ )
+            {
+                FIFO& tx = fifo[ pt * 4 + ch ][ 0 ];
+                line[ pt ][ ch ] = 0xFF;
+
+                if ( ! IsOnLine( tx ) || IsHDLC( tx ) || Usage( tx ) == 0 )
+                    continue;
+
+                if ( port[ pt ].su_ctrl0 & ( ch ? M_B2_TX_EN : M_B1_TX_EN ) )
+                    line[ pt ][ ch ] = tx.data[ tx.z2 ];
+
+                tx.z2 = ( tx.z2 + 1 ) & ( depth - 1 );
+
+                if ( Usage( tx ) == thres_tx )
+                    SetFifoIrq( pt * 4 + ch, 0 );
+                }
+            }
+
+        for ( int pt = 0; pt < num_ports; pt++ )
+        {
+            int peer = GetPeer( pt );
+            bool active = IsActive( pt ) && IsActive( peer );
+
+            for ( int ch = 0; ch < 2; ch++ )
+            {
+                const FIFO& rx = fifo[ pt * 4 + ch ][ 1 ];
+
+                if ( ! IsOnLine( rx ) || IsHDLC( rx ) )
+                    continue;
+
+                if ( port[ pt ].su_ctrl2 & ( ch ? M_B2_RX_EN : M_B1_RX_EN ) )
+                    PutOctet( pt * 4 + ch, active ? line[ peer ][ ch ] : 0xFF );
+                else
+                    PutOctet( pt * 4 + ch, 0xFF );
+                }
+            }
+        }
+
+    // Moves one octet of HDLC FIFO of HFC-channel ch from port pt to its peer
+    //
+    void TransferOctet( int pt, int ch )
+    {
+        int peer = GetPeer( pt );
+        FIFO& tx = fifo[ pt * 4 + ch ][ 0 ];
+        FIFO& rx = fifo[ peer * 4 + ch ][ 1 ];
+
+        if ( ! IsOnLine( tx ) || ! IsHDLC( tx ) )
+            return;
+
+        if ( ch < 2 ) // B-Channel enables
+        {
+            if ( ! ( port[ pt ].su_ctrl0 & ( ch ? M_B2_TX_EN : M_B1_TX_EN ) ) )
+                return;
+            }
+
+        bool deliver = IsOnLine( rx ) && IsHDLC( rx )
+            && ( ch == 2 || ( port[ peer ].su_ctrl2 & ( ch ? M_B2_RX_EN : M_B1_RX_EN ) ) );
+
+        // Frames are sent only when complete
+        //
+        if ( tx.f1 == tx.f2 )
+            return;
+
+        if ( tx.z2 != tx.frame_end[ tx.f2 ] )
+        {
+            int octet = tx.data[ tx.z2 ];
+            tx.z2 = ( tx.z2 + 1 ) & ( depth - 1 );
+
+            if ( deliver )
+            {
+                rx.crc = CrcUpdate( rx.crc, octet );
+                PutOctet( peer * 4 + ch, octet );
+                }
+            }
+
+        if ( tx.z2 == tx.frame_end[ tx.f2 ] )
+        {
+            tx.f2 = ( tx.f2 + 1 ) & ( MAX_FRAMES - 1 );
+
+            if ( deliver )
+            {
+                PutFrameEnd( peer * 4 + ch, ch == 2 && port[ peer ].crc_error );
+                if ( ch == 2 )
+                    port[ peer ].crc_error = false;
+                }
+            }
+        }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    bool IsNT( int pt ) const
+    {
+        return ( port[ pt ].su_ctrl0 & M_SU_MD ) != 0;
+        }
+
+    bool IsActive( int pt ) const
+    {
+        return port[ pt ].state == ( IsNT( pt ) ? NT_G3 : TE_F7 );
+        }
+
+    void SetState( int pt, int state, int delay = L1_DELAY )
+    {
+        if ( port[ pt ].state != state )
+            su_irq |= 1 << pt;
+
+        port[ pt ].state = state;
+        port[ pt ].delay = delay;
+        }
+
+    // Advances L1 state machine of port pt by one frame
+    //
+    void StepL1( int pt )
+    {
+        Port& p = port[ pt ];
+        int peer = GetPeer( pt );
+        bool ideal = peer == pt;
+
+        if ( ! p.enabled )
+            return;
+
+        if ( p.delay > 0 )
+        {
+            --p.delay;
+            return;
+            }
+
+        if ( IsNT( pt ) )
+        {
+            bool te_req = ideal ? p.act_req
+                : ! IsNT( peer ) && port[ peer ].act_req && port[ peer ].enabled;
+
+            switch ( p.state )
+            {
+                case NT_G1:
+                    if ( p.act_req || te_req )
+                        SetState( pt, NT_G2 );
+                    break;
+
+                case NT_G2:
+                    if ( p.deact_req )
+                        SetState( pt, NT_G4 );
+                    else if ( p.g2_g3 && ( ideal || ( ! IsNT( peer ) && port[ peer ].enabled ) ) )
+                        SetState( pt, NT_G3 );
+                    break;
+
+                case NT_G3:
+                    if ( p.deact_req )
+                        SetState( pt, NT_G4, 2 * L1_DELAY );
+                    break;
+
+                case NT_G4:
+                    p.deact_req = false;
+                    p.act_req = false;
+                    p.g2_g3 = false;
+                    SetState( pt, NT_G1 );
+                    break;
+
+                default:
+                    SetState( pt, NT_G1 );
+                    break;
+                }
+
+            return;
+            }
+
+        bool nt_active = ideal ? p.act_req || p.state >= TE_F6
+            : IsNT( peer ) && port[ peer ].state == NT_G3;
+
+        switch ( p.state )
+        {
+            case TE_F3:
+                if ( nt_active )
+                    SetState( pt, TE_F6 );
+                break;
+
+            case TE_F6:
+                SetState( pt, nt_active ? TE_F7 : TE_F3 );
+                break;
+
+            case TE_F7:
+                p.act_req = false;
+                if ( ! nt_active )
+                    SetState( pt, TE_F3 );
+                else if ( p.lost_framing > 0 )
+                    SetState( pt, TE_F8, 0 );
+                break;
+
+            case TE_F8:
+                if ( p.lost_framing > 0 && --p.lost_framing > 0 )
+                    break;
+                SetState( pt, nt_active ? TE_F7 : TE_F3 );
+                break;
+
+            default:
+                SetState( pt, TE_F3 );
+                break;
+            }
+        }
+
+    void WriteSuState( int pt, int value )
+    {
+        Port& p = port[ pt ];
+
+        if ( ! p.enabled )
+        {
+            p.enabled = true;
+            p.delay = L1_DELAY;
+            }
+
+        if ( ( value & WR_STA_ACT_MASK ) == WR_STA_ACTIVATE )
+            p.act_req = true;
+        else if ( ( value & WR_STA_ACT_MASK ) == WR_STA_DEACTIVATE && IsNT( pt ) )
+            p.deact_req = true;
+
+        if ( value & M_SU_SET_G2_G3 )
+            p.g2_g3 = true;
+        }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    int ReadData( void )
+    {
+        if ( addr >= R_FIFO_BL0_IRQ && addr <= R_FIFO_BL3_IRQ )
+        {
+            int bl = addr - R_FIFO_BL0_IRQ;
+            int value = fifo_irq[ bl ];
+            fifo_irq[ bl ] = 0;
+            return value;
+            }
+
+        if ( addr >= R_FILL_BL0 && addr <= R_FILL_BL0 + 3 )
+        {
+            int bl = addr - R_FILL_BL0;
+            int value = 0;
+
+            for ( int i = 0; i < 8; i++ )
+            {
+                const FIFO& f = fifo[ bl * 4 + ( i >> 1 ) ][ i & 1 ];
+                if ( Usage( f ) > ( ( i & 1 ) ? thres_rx : thres_tx ) )
+                    value |= 1 << i;
+                }
+
+            return value;
+            }
+
+        FIFO& f = Selected ();
+
+        switch( addr )
+        {
+            case R_CHIP_ID:
+                return chip_id;
+
+            case R_STATUS:
+                return 0; // Never busy
+
+            case R_IRQ_OVIEW:
+                return GetOverview ();
+
+            case R_MISC_IRQ:
+            {
+                int value = misc_irq & misc_irqmsk;
+                misc_irq &= ~value;
+                return value;
+                }
+
+            case R_SU_IRQ:
+            {
+                int value = su_irq & su_irqmsk;
+                su_irq &= ~value;
+                return value;
+                }
+
+            case R_F0_CNTL:
+                f0_high = f0_cnt >> 8;
+                return f0_cnt & 0xFF;
+
+            case R_F0_CNTH:
+                return f0_high;
+
+            case A_SU_RD_STA:
+                return port[ su_sel ].state;
+
+            case A_Z1:
+                if ( ( fifo_sel & 1 ) && f.f1 != f.f2 )
+                {
+                    // First complete frame: Z1 is its last octet
+                    //
+                    return ( f.frame_end[ f.f2 ] - 1 ) & ( depth - 1 );
+                    }
+                return f.z1;
+
+            case A_Z2:
+                return f.z2;
+
+            case A_F1:
+                return f.f1;
+
+            case A_F2:
+                return f.f2;
+
+            case A_USAGE:
+                return Usage( f );
+
+            case A_FIFO_STA:
+                return f.err ? M_FIFO_ERR : 0;
+
+            case A_FIFO_DATA:
+            {
+                if ( ! ( fifo_sel & 1 ) || f.z2 == f.z1 )
+                    return 0;
+
+                int octet = f.data[ f.z2 ];
+                f.z2 = ( f.z2 + 1 ) & ( depth - 1 );
+                return octet;
+                }
+            }
+
+        return reg[ addr ];
+        }
+
+    void WriteData( int value )
+    {
+        FIFO& f = Selected ();
+
+        switch( addr )
+        {
+            case R_CIRM:
+                if ( value & M_SRES )
+                    Reset( chip_id, num_ports, false );
+                return;
+
+            case R_FIFO_MD:
+                depth = 64 << ( ( value / M1_FIFO_MD ) & 3 );
+                return;
+
+            case R_FIFO_THRES:
+                thres_tx = ( ( value / M1_THRES_TX ) & 0x0F ) * 16;
+                thres_rx = ( ( value / M1_THRES_RX ) & 0x0F ) * 16;
+                return;
+
+            case R_FIFO:
+                fifo_sel = value & 0x1F; // M_REV is not modelled
+                return;
+
+            case R_SU_SEL:
+                su_sel = value & ( MAX_PORTS - 1 );
+                return;
+
+            case R_IRQ_CTRL:
+                irq_ctrl = value;
+                return;
+
+            case R_MISC_IRQMSK:
+                misc_irqmsk = value;
+                return;
+
+            case R_SU_IRQMSK:
+                su_irqmsk = value;
+                return;
+
+            case R_TI_WD:
+                timer_ti = value & 0x0F;
+                timer_cnt = 2 << timer_ti;
+                return;
+
+            case A_SU_CTRL0:
+                port[ su_sel ].su_ctrl0 = value;
+                return;
+
+            case A_SU_CTRL2:
+                port[ su_sel ].su_ctrl2 = value;
+                return;
+
+            case A_SU_WR_STA:
+                WriteSuState( su_sel, value );
+                return;
+
+            case A_CON_HDLC:
+                f.con_hdlc = value;
+                return;
+
+            case A_FIFO_CTRL:
+                f.fifo_ctrl = value;
+                return;
+
+            case A_INC_RES_FIFO:
+                if ( value & M_RES_FIFO )
+                    ResetFIFO( f );
+                if ( value & M_RES_FIFO_ERR )
+                    f.err = false;
+                if ( value & M_INC_F )
+                {
+                    if ( fifo_sel & 1 ) // RX: skip to next frame
+                    {
+                        if ( f.f1 != f.f2 )
+                        {
+                            f.z2 = f.frame_end[ f.f2 ];
+                            f.f2 = ( f.f2 + 1 ) & ( MAX_FRAMES - 1 );
+                            }
+                        }
+                    else // TX: terminate frame
+                    {
+                        f.frame_end[ f.f1 ] = f.z1;
+                        f.f1 = ( f.f1 + 1 ) & ( MAX_FRAMES - 1 );
+                        }
+                    }
+                return;
+
+            case A_FIFO_DATA:
+                if ( ( fifo_sel & 1 ) || Usage( f ) >= depth - 1 )
+                {
+                    f.err = true;
+                    return;
+                    }
+
+                f.data[ f.z1 ] = value;
+                f.z1 = ( f.z1 + 1 ) & ( depth - 1 );
+                return;
+            }
+
+        reg[ addr ] = value;
+        }
+
+    int GetOverview( void ) const
+    {
+        int value = 0;
+
+        if ( irq_ctrl & M_FIFO_IRQ_EN )
+        {
+            for ( int bl = 0; bl < MAX_PORTS; bl++ )
+            {
+                if ( fifo_irq[ bl ] )
+                    value |= 1 << bl;
+                }
+            }
+
+        if ( misc_irq & misc_irqmsk )
+            value |= OVIEW_MISC;
+
+        if ( su_irq & su_irqmsk )
+            value |= OVIEW_SU;
+
+        return value;
+        }
+
+public:
+
+    XHFC_Model( void )
+    {
+        Reset( CHIP_ID_2SU, 2 );
+        }
+
+    // Power-on reset (soft reset keeps counters and line state)
+    //
+    void Reset( int id, int ports, bool power_on = true )
+    {
+        chip_id = id;
+        num_ports = ports;
+
+        if ( power_on )
+        {
+            memset( reg, 0, sizeof( reg ) );
+            memset( port, 0, sizeof( port ) );
+            addr = 0;
+            depth = 64;
+            f0_cnt = 0;
+            f0_high = 0;
+            steps = 0;
+            addr_writes = addr_reads = data_reads = data_writes = 0;
+            }
+
+        thres_tx = thres_rx = 16;
+        fifo_sel = 0;
+        su_sel = 0;
+        irq_ctrl = 0;
+        misc_irq = misc_irqmsk = 0;
+        su_irq = su_irqmsk = 0;
+        memset( fifo_irq, 0, sizeof( fifo_irq ) );
+        timer_ti = 0;
+        timer_cnt = 2;
+
+        for ( int i = 0; i < MAX_FIFOS; i++ )
+        {
+            for ( int dir = 0; dir < 2; dir++ )
+            {
+                ResetFIFO( fifo[ i ][ dir ] );
+                fifo[ i ][ dir ].con_hdlc = 0;
+                fifo[ i ][ dir ].fifo_ctrl = 0;
+                }
+            }
+        }
+
+    // Partner of S/U interface on the cable, or itself
+    //
+    int GetPeer( int pt ) const
+    {
+        int peer = pt ^ 1;
+        return peer < num_ports ? peer : pt;
+        }
+
+    int GetState( int pt ) const
+    {
+        return port[ pt ].state;
+        }
+
+    // TE goes to F8 for the given number of frames
+    //
+    void LoseFraming( int pt, int frames )
+    {
+        port[ pt ].lost_framing = frames;
+        }
+
+    // Next D-Channel frame received by pt gets a CRC error
+    //
+    void InjectCrcError( int pt )
+    {
+        port[ pt ].crc_error = true;
+        }
+
+    unsigned long GetSteps( void ) const
+    {
+        return steps;
+        }
+
+    // INT# (active) level
+    //
+    bool IsIrqAsserted( void ) const
+    {
+        return ( irq_ctrl & M_GLOB_IRQ_EN ) && GetOverview () != 0;
+        }
+
+    // Advances time by one 125us frame
+    //
+    void Step( void )
+    {
+        ++steps;
+        ++f0_cnt;
+
+        if ( --timer_cnt <= 0 )
+        {
+            timer_cnt = 2 << timer_ti;
+            misc_irq |= M_TI_IRQ;
+            }
+
+        for ( int pt = 0; pt < num_ports; pt++ )
+            StepL1( pt );
+
+        StepTransparent ();
+
+        for ( int pt = 0; pt < num_ports; pt++ )
+        {
+            if ( ! IsActive( pt ) || ! IsActive( GetPeer( pt ) ) )
+                continue;
+
+            TransferOctet( pt, 0 );
+            TransferOctet( pt, 1 );
+
+            if ( steps % D_OCTET_STEPS == 0 )
+                TransferOctet( pt, 2 );
+            }
+        }
+
+    // Bus cycles
+    //
+    int Read( bool addr_reg )
+    {
+        if ( addr_reg )
+        {
+            ++addr_reads;
+            return addr;
+            }
+
+        ++data_reads;
+        return ReadData () & 0xFF;
+        }
+
+    void Write( bool addr_reg, int value )
+    {
+        if ( addr_reg )
+        {
+            ++addr_writes;
+            addr = value & 0xFF;
+            return;
+            }
+
+        ++data_writes;
+        WriteData( value & 0xFF );
+        }
+    };
+
+#endif // _XHFCSIM_H_INCLUDED
@@ -0,0 +1,514 @@
+#ifndef _HOSTCMD_H_INCLUDED
+#define _HOSTCMD_H_INCLUDED
+
+#include "usblink.h"
+
+#ifdef XHFC_BERT
+#include "bert.h"
+#endif
+
+extern class XHFC hfc;
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Host commands
+//
+// Every CMD frame is answered with exactly one CMD_ACK frame, in order of
+// reception. The host chosen TAG is echoed back, so that the host may send
+// several commands without waiting for their acknowledgements.
+//
+class HostCommand
+{
+/*
+    CMD frame (Host -> USB-PIO), ADDR = port:
+
+    +---+---+---+---+---+---+---+---+
+    |            OPCODE             |
+    +---+---+---+---+---+---+---+---+
+    |              TAG              |  Echoed in CMD_ACK
+    +---+---+---+---+---+---+---+---+
+    |            PARAMS             |  Depends on OPCODE
+    +---+---+---+---+---+---+---+---+
+
+    CMD_ACK frame (USB-PIO -> Host), ADDR = port:
+
+    +---+---+---+---+---+---+---+---+
+    |            OPCODE             |
+    +---+---+---+---+---+---+---+---+
+    |              TAG              |
+    +---+---+---+---+---+---+---+---+
+    |            RESULT             |  RC_*
+    +---+---+---+---+---+---+---+---+
+    |             REPLY             |  Depends on OPCODE
+    +---+---+---+---+---+---+---+---+
+
+    OPCODE          PARAMS                  REPLY
+
+    OP_D_TX         { LEN, DATA[LEN] } ...  QUEUED, FREE
+    OP_L1_ACTIVATE  -                       L1 STATE, ACTIVATED
+    OP_L1_DEACTIVATE -                      L1 STATE, ACTIVATED
+    OP_B_ENABLE     BC                      -
+    OP_B_DISABLE    BC                      -
+    OP_B_LOOP       BC                      -
+    OP_PEEK         REG                     VALUE
+    OP_POKE         REG, VALUE              -
+    OP_STATS        -                       see below
+    OP_LAPD         PRIM, PARAMS            STATE, TEI, QUEUED (see lapd.h)
+    OP_XC_CONNECT   BC, PEER PORT, PEER BC  -
+    OP_XC_PCM       BC, SLOT                -
+    OP_XC_TABLE     -                       ENTRY for every B-Channel
+    OP_MODERATION   [THRES TX, THRES RX, TIMER] see below
+    OP_B_HDLC       BC                      -
+    OP_B_TX         BC, { LEN, DATA[LEN] } ... QUEUED, FREE
+    OP_B_STATS      BC                      see below
+    OP_L1_LOG       [CLEAR]                 see below
+    OP_L1_EVENTS    -                       DROPPED, PENDING, EVENT ...
+    OP_BERT         BC, PATTERN             -
+
+    OP_D_TX:    Queues one or more HDLC frames (without FCS) for
+                transmission. QUEUED is the number of frames taken; if it
+                is less than given, RESULT is RC_FULL and the rest has to
+                be sent again. FREE is the room left in the TX ring.
+
+    OP_B_ENABLE: Connects B-Channel to the transparent FIFOs, i.e. it also
+                ends OP_B_LOOP and cross-connects.
+
+    OP_B_LOOP:  Same as OP_XC_CONNECT with itself.
+
+    OP_B_HDLC:  Connects B-Channel to its FIFOs in HDLC mode (64 kbit/s,
+                flags as interframe fill). Received frames are sent as
+                B_RX frames (see dstream.h), frames to send are queued with
+                OP_B_TX like OP_D_TX. OP_B_ENABLE switches back to
+                transparent mode. OP_B_HDLC, OP_B_TX and OP_B_STATS are only
+                in builds with XHFC_B_HDLC; RC_BAD_OPCODE otherwise.
+
+    OP_XC_CONNECT: Switches B-Channel to B-Channel of peer port on the same
+                XHFC chip over PCM (both directions), see XHFC.
+
+    OP_XC_PCM:  Switches B-Channel to external PCM timeslot 16 .. 31.
+
+    OP_XC_TABLE: ENTRY of B-Channel port * 2 + bc is the partner B-Channel
+                (same numbering), 0x80 + PCM timeslot, or 0xFF if connected
+                to FIFOs. ADDR is ignored.
+
+    OP_MODERATION: Sets FIFO thresholds (units of 16 octets) and timer
+                interval (R_TI_WD value, 2 = 1 ms .. 6 = 16 ms) of all chips;
+                without PARAMS only reports. Values other than 1, 1, 2 are
+                rejected while a transparent B-Channel is enabled, and
+                enabling one (OP_B_ENABLE, OP_BERT, or reconnecting FIFOs
+                after OP_XC_*) restores 1, 1, 2. REPLY is
+                THRES TX, THRES RX, TIMER, IRQ/S (32-bit), BUS CYCLES/S
+                (32-bit, 0 unless built with XHFC_BENCHMARK) of last second.
+                Presets: voice 1, 1, 2; bulk HDLC 3, 3, 2; idle 1, 1, 6.
+                ADDR is ignored.
+
+    OP_STATS:   DTX SENT, DTX UNDERRUN, DTX DROPPED, DTX QUEUED, DRX FRAMES,
+                DRX CRC ERROR, DRX INVALID, DRX OVERRUN, DRX DROPPED,
+                L1 STATE, ACTIVATED, IRQ COUNT (32-bit)
+
+    OP_B_STATS: Same as OP_STATS up to DRX DROPPED, for B-Channel in HDLC
+                mode; RC_BAD_PARAM if it is not.
+
+    OP_L1_LOG:  FAILED, MAX ACT MS, T1 EXPIRED, T3 EXPIRED, T4 EXPIRED,
+                F8 ENTERED, HIST[8]: activations by time to PH_ACTIVATE,
+                < 16, 32, 64 .. 1024, >= 1024 ms (see L1_Log in xhfc.h).
+                With CLEAR != 0 the counters are cleared after the reply.
+
+    OP_L1_EVENTS: Removes up to 4 events from the L1 event log: DROPPED
+                (events overwritten since OP_L1_LOG CLEAR), PENDING (events
+                left in log), then EVENT = TIME (32-bit, ms since startup),
+                CODE (L1_Log::EV_*). OP_L1_LOG and OP_L1_EVENTS are only in
+                builds with XHFC_L1_LOG; RC_BAD_OPCODE otherwise.
+
+    OP_BERT:    Starts bit error rate test on B-Channel with PATTERN 11
+                (PRBS 2^11-1) or 15 (PRBS 2^15-1), or stops it with 0. The
+                B-Channel is connected to its transparent FIFOs as with
+                OP_B_ENABLE, and is not streamed while under test. Results
+                are sent as BERT frames every second, see bert.h. Only in
+                builds with XHFC_BERT; RC_BAD_OPCODE otherwise.
+
+    OP_PEEK, OP_POKE: Register of the XHFC chip the port belongs to.
+
+    OP_LAPD:    Only in builds with XHFC_LAPD; RC_BAD_OPCODE otherwise.
+
+    Counters are 16-bit words, MSB first; octet fields are single octets.
+*/
+
+public:
+
+    enum // Opcodes
+    {
+        OP_D_TX           = 0x01,
+        OP_L1_ACTIVATE    = 0x02,
+        OP_L1_DEACTIVATE  = 0x03,
+        OP_B_ENABLE       = 0x04,
+        OP_B_DISABLE      = 0x05,
+        OP_B_LOOP         = 0x06,
+        OP_PEEK           = 0x07,
+        OP_POKE           = 0x08,
+        OP_STATS          = 0x09,
+        OP_LAPD           = 0x0A,
+        OP_XC_CONNECT     = 0x0B,
+        OP_XC_PCM         = 0x0C,
+        OP_XC_TABLE       = 0x0D,
+        OP_MODERATION     = 0x0E,
+        OP_B_HDLC         = 0x0F,
+        OP_B_TX           = 0x10,
+        OP_B_STATS        = 0x11,
+        OP_L1_LOG         = 0x12,
+        OP_L1_EVENTS      = 0x13,
+        OP_BERT           = 0x14
+        };
+
+    enum // Results
+    {
+        RC_OK             = 0x00,
+        RC_BAD_OPCODE     = 0x01,
+        RC_BAD_PARAM      = 0x02,
+        RC_FULL           = 0x03
+        };
+
+private:
+
+    enum // instead of #defines
+    {
+        MAX_REPLY         = 28,
+        MAX_L1_EVENTS     = 4     // Events per OP_L1_EVENTS reply
+        };
+
+    USB_Link& link;
+
+    static void PutWord( unsigned char*& p, unsigned int value )
+    {
+        *p++ = ( value >> 8 ) & 0xFF;
+        *p++ = value & 0xFF;
+        }
+
+    // Queues { LEN, DATA[LEN] } ... in TX ring; appends QUEUED, FREE
+    //
+    static int QueueFrames( FrameRing& ring,
+        const unsigned char* par, int len, unsigned char*& p )
+    {
+        int queued = 0;
+        int rc = RC_OK;
+
+        while ( len > 0 )
+        {
+            int flen = par[ 0 ];
+            if ( flen == 0 || flen >= len )
+            {
+                rc = RC_BAD_PARAM;
+                break;
+                }
+
+            ring.Put( par + 1, flen );
+            if ( ! ring.Commit () )
+            {
+                rc = RC_FULL;
+                break;
+                }
+
+            ++queued;
+            par += 1 + flen;
+            len -= 1 + flen;
+            }
+
+        *p++ = queued;
+        *p++ = ring.GetFree ();
+        return rc;
+        }
+
+    // Appends frame counters of HDLC FIFO pair (OP_STATS, OP_B_STATS)
+    //
+    static void PutCounters( const HDLC_Channel& hc, unsigned char*& p )
+    {
+        PutWord( p, hc.tx_sent );
+        PutWord( p, hc.tx_underrun );
+        PutWord( p, hc.tx_ring.dropped );
+        PutWord( p, hc.tx_ring.GetCount () );
+        PutWord( p, hc.rx_frames );
+        PutWord( p, hc.rx_crc_error );
+        PutWord( p, hc.rx_invalid );
+        PutWord( p, hc.rx_overrun );
+        PutWord( p, hc.rx_ring.dropped );
+        }
+
+    // Returns RC; reply octets are appended at p
+    //
+    int Execute( int opcode, XHFC_Port& port,
+        const unsigned char* par, int len, unsigned char*& p )
+    {
+        switch( opcode )
+        {
+            case OP_D_TX:
+                return QueueFrames( port.Get_D_TX_Ring (), par, len, p );
+
+            case OP_L1_ACTIVATE:
+            case OP_L1_DEACTIVATE:
+                if ( opcode == OP_L1_ACTIVATE )
+                    port.PH_ActivateRequest ();
+                else
+                    port.PH_DeactivateRequest ();
+
+                *p++ = port.GetL1State ();
+                *p++ = port.IsActivated ();
+                return RC_OK;
+
+            case OP_B_ENABLE:
+            case OP_B_DISABLE:
+            case OP_B_LOOP:
+            {
+                if ( len < 1 || par[ 0 ] > 1 )
+                    return RC_BAD_PARAM;
+
+                int ch = ( &port - hfc.port ) * 2 + par[ 0 ];
+
+                if ( opcode == OP_B_LOOP )
+                {
+                    hfc.XC_Connect( ch, ch );
+                    return RC_OK;
+                    }
+
+                hfc.XC_Disconnect( ch );
+
+                if ( opcode == OP_B_ENABLE )
+                    hfc.Connect_B_Channel( ch );
+                else
+                    port.Disable_B_Channel( par[ 0 ] );
+                return RC_OK;
+                }
+
+            case OP_XC_CONNECT:
+            {
+                if ( len < 3 || par[ 0 ] > 1 || par[ 2 ] > 1 )
+                    return RC_BAD_PARAM;
+
+                int ch = ( &port - hfc.port ) * 2 + par[ 0 ];
+
+                return hfc.XC_Connect( ch, par[ 1 ] * 2 + par[ 2 ] ) ? RC_OK : RC_BAD_PARAM;
+                }
+
+            case OP_XC_PCM:
+            {
+                if ( len < 2 || par[ 0 ] > 1 )
+                    return RC_BAD_PARAM;
+
+                int ch = ( &port - hfc.port ) * 2 + par[ 0 ];
+
+                return hfc.XC_ConnectPCM( ch, par[ 1 ] ) ? RC_OK : RC_BAD_PARAM;
+                }
+
+            case OP_XC_TABLE:
+                for ( int ch = 0; ch < hfc.GetChannelCount (); ch++ )
+                    *p++ = hfc.GetCrossConnect( ch );
+                return RC_OK;
+
+            case OP_MODERATION:
+            {
+                int rc = RC_OK;
+
+                if ( len >= 3 && ! hfc.SetModeration( par[ 0 ], par[ 1 ], par[ 2 ] ) )
+                    rc = RC_BAD_PARAM;
+                else if ( len != 0 && len < 3 )
+                    rc = RC_BAD_PARAM;
+
+                *p++ = hfc.GetThresholdTX ();
+                *p++ = hfc.GetThresholdRX ();
+                *p++ = hfc.GetTimerValue ();
+
+                unsigned long rate = hfc.GetIrqRate ();
+                PutWord( p, rate >> 16 );
+                PutWord( p, rate );
+
+                rate = hfc.GetBusRate ();
+                PutWord( p, rate >> 16 );
+                PutWord( p, rate );
+                return rc;
+                }
+
+            case OP_PEEK:
+                if ( len < 1 )
+                    return RC_BAD_PARAM;
+
+                *p++ = hfc.ReadPortReg( &port - hfc.port, par[ 0 ] );
+                return RC_OK;
+
+            case OP_POKE:
+                if ( len < 2 )
+                    return RC_BAD_PARAM;
+
+                hfc.WritePortReg( &port - hfc.port, par[ 0 ], par[ 1 ] );
+                return RC_OK;
+
+            case OP_STATS:
+            {
+                PutCounters( port.Get_D_Channel (), p );
+                *p++ = port.GetL1State ();
+                *p++ = port.IsActivated ();
+
+                unsigned long irq_cnt = hfc.GetIrqCount ();
+                PutWord( p, irq_cnt >> 16 );
+                PutWord( p, irq_cnt );
+                return RC_OK;
+                }
+
+#ifdef XHFC_B_HDLC
+            case OP_B_HDLC:
+            {
+                if ( len < 1 || par[ 0 ] > 1 )
+                    return RC_BAD_PARAM;
+
+                int ch = ( &port - hfc.port ) * 2 + par[ 0 ];
+
+                hfc.XC_Disconnect( ch );
+                hfc.Connect_B_Channel( ch, true );
+                return RC_OK;
+                }
+
+            case OP_B_TX:
+            case OP_B_STATS:
+                if ( len < 1 || par[ 0 ] > 1 || ! port.Is_B_HDLC( par[ 0 ] ) )
+                    return RC_BAD_PARAM;
+
+                if ( opcode == OP_B_TX )
+                    return QueueFrames( port.Get_B_HDLC( par[ 0 ] ).tx_ring, par + 1, len - 1, p );
+
+                PutCounters( port.Get_B_HDLC( par[ 0 ] ), p );
+                return RC_OK;
+#endif
+
+#ifdef XHFC_L1_LOG
+            case OP_L1_LOG:
+            {
+                L1_Log& log = port.Get_L1_Log ();
+
+                PutWord( p, log.failed );
+                PutWord( p, log.max_act_ms );
+                PutWord( p, log.t1_expired );
+                PutWord( p, log.t3_expired );
+                PutWord( p, log.t4_expired );
+                PutWord( p, log.lost_framing );
+
+                for ( int i = 0; i < L1_Log::HIST_BUCKETS; i++ )
+                    PutWord( p, log.hist[ i ] );
+
+                if ( len >= 1 && par[ 0 ] )
+                    log.Clear ();
+                return RC_OK;
+                }
+
+            case OP_L1_EVENTS:
+            {
+                L1_Log& log = port.Get_L1_Log ();
+                L1_Log::Event ev;
+
+                PutWord( p, log.dropped );
+                unsigned char* pending = p++;
+
+                for ( int i = 0; i < MAX_L1_EVENTS && log.Get( ev ); i++ )
+                {
+                    PutWord( p, ev.time >> 16 );
+                    PutWord( p, ev.time );
+                    *p++ = ev.code;
+                    }
+
+                *pending = log.GetCount ();
+                return RC_OK;
+                }
+#endif
+
+#ifdef XHFC_BERT
+            case OP_BERT:
+            {
+                if ( len < 2 || par[ 0 ] > 1 )
+                    return RC_BAD_PARAM;
+
+                int ch = ( &port - hfc.port ) * 2 + par[ 0 ];
+
+                if ( ! bert.Start( ch, par[ 1 ] ) )
+                    return RC_BAD_PARAM;
+
+                if ( par[ 1 ] != BER_Tester::PRBS_OFF )
+                {
+                    hfc.XC_Disconnect( ch );
+                    hfc.Connect_B_Channel( ch );
+                    }
+                return RC_OK;
+                }
+#endif
+
+#ifdef XHFC_LAPD
+            case OP_LAPD:
+            {
+                if ( len < 1 )
+                    return RC_BAD_PARAM;
+
+                LAPD& dl = lapd[ &port - hfc.port ];
+                int rc = LAPD::REQ_INVALID;
+
+                switch( par[ 0 ] )
+                {
+                    case LAPD::DL_ESTABLISH_REQ:
+                        rc = dl.DL_EstablishRequest ();
+                        break;
+
+                    case LAPD::DL_RELEASE_REQ:
+                        rc = dl.DL_ReleaseRequest ();
+                        break;
+
+                    case LAPD::DL_DATA_REQ:
+                        rc = dl.DL_DataRequest( par + 1, len - 1 );
+                        break;
+
+                    case LAPD::DL_UNITDATA_REQ:
+                        rc = dl.DL_UnitDataRequest( par + 1, len - 1 );
+                        break;
+
+                    case LAPD::MDL_CONFIG_REQ:
+                        if ( len >= 4 )
+                            rc = dl.Configure( par[ 1 ], par[ 2 ], par[ 3 ] );
+                        break;
+                    }
+
+                *p++ = dl.GetState ();
+                *p++ = dl.GetTei ();
+                *p++ = dl.GetQueued ();
+
+                return rc == LAPD::REQ_OK ? RC_OK
+                     : rc == LAPD::REQ_FULL ? RC_FULL : RC_BAD_PARAM;
+                }
+#endif
+            }
+
+        return RC_BAD_OPCODE;
+        }
+
+public:
+
+    HostCommand( USB_Link& p_link )
+        : link( p_link )
+    {
+        }
+
+    // CMD frame received from host
+    //
+    void OnCommand( int addr, const unsigned char* data, int len )
+    {
+        if ( len < 2 ) // No OPCODE and TAG; cannot be acknowledged
+            return;
+
+        unsigned char reply[ 3 + MAX_REPLY ];
+        unsigned char* p = reply + 3;
+
+        reply[ 0 ] = data[ 0 ]; // OPCODE
+        reply[ 1 ] = data[ 1 ]; // TAG
+
+        if ( addr >= hfc.GetPortCount () )
+            reply[ 2 ] = RC_BAD_PARAM;
+        else
+            reply[ 2 ] = Execute( data[ 0 ], hfc.port[ addr ], data + 2, len - 2, p );
+
+        link.SendFrame( USB_Link::FRM_CTL_CMD_ACK, addr, reply, p - reply );
+        }
+    };
+
+#endif // _HOSTCMD_H_INCLUDED
@@ -0,0 +1,1104 @@
+#ifndef _LAPD_H_INCLUDED
+#define _LAPD_H_INCLUDED
+
+#include "usblink.h"
+
+extern class XHFC hfc;
+
+//////////////////////////////////////////////////////////////////////////////////////
+// LAPD (Q.921) data link entity for SAPI 0, one per port
+//
+// Runs on top of the port's D-Channel frame rings, so that layer 2
+// acknowledgements do not wait for the host; only layer 3 messages and
+// DL/MDL primitives are exchanged with the host. Received frames are
+// processed in the main loop (see D_Stream::Poll). Timers T200, T202 and
+// T203 are counted down by EH_TimerTicks; their expiry is handled by Poll()
+// in the main loop as well.
+//
+// Not implemented: own receiver busy (frames are passed to the host at
+// once), XID, and TEI assignment on the network side (NT uses fixed TEI).
+//
+class LAPD
+{
+/*
+    OP_LAPD command (Host -> USB-PIO, see hostcmd.h), ADDR = port:
+
+    +---+---+---+---+---+---+---+---+
+    |             PRIM              |
+    +---+---+---+---+---+---+---+---+
+    |            PARAMS             |
+    +---+---+---+---+---+---+---+---+
+
+    PRIM                PARAMS
+
+    DL_ESTABLISH_REQ    -
+    DL_RELEASE_REQ      -
+    DL_DATA_REQ         L3 message (max. MAX_L3_LEN octets)
+    DL_UNITDATA_REQ     L3 message (max. MAX_L3_LEN octets)
+    MDL_CONFIG_REQ      ENABLE, TEI, K
+
+        TEI: 0..126 fixed TEI, 127 automatic TEI assignment (TE only)
+        K:   window size (1..7), 0 = default
+
+    Reply: STATE, TEI, QUEUED (I-frames queued or not acknowledged)
+    Result is RC_FULL if DL_DATA_REQ did not fit into the I-frame queue.
+
+    LAPD_IND frame (USB-PIO -> Host), ADDR = port:
+
+    +---+---+---+---+---+---+---+---+
+    |             PRIM              |
+    +---+---+---+---+---+---+---+---+
+    |            PARAMS             |
+    +---+---+---+---+---+---+---+---+
+
+    PRIM                PARAMS
+
+    DL_ESTABLISH_IND    -
+    DL_ESTABLISH_CONF   -
+    DL_RELEASE_IND      -
+    DL_RELEASE_CONF     -
+    DL_DATA_IND         L3 message
+    DL_UNITDATA_IND     L3 message
+    MDL_ERROR_IND       ERROR ('A'..'O' as in Q.921 Appendix II)
+    MDL_TEI_IND         TEI (127 if TEI was removed)
+
+    Unacknowledged I-frames are discarded on link (re)establishment and
+    release; the host learns it from DL_ESTABLISH_IND or DL_RELEASE_IND.
+*/
+
+public:
+
+    enum // Primitives
+    {
+        DL_ESTABLISH_REQ  = 0x01,
+        DL_RELEASE_REQ    = 0x02,
+        DL_DATA_REQ       = 0x03,
+        DL_UNITDATA_REQ   = 0x04,
+        MDL_CONFIG_REQ    = 0x05,
+
+        DL_ESTABLISH_IND  = 0x81,
+        DL_ESTABLISH_CONF = 0x82,
+        DL_RELEASE_IND    = 0x83,
+        DL_RELEASE_CONF   = 0x84,
+        DL_DATA_IND       = 0x85,
+        DL_UNITDATA_IND   = 0x86,
+        MDL_ERROR_IND     = 0x87,
+        MDL_TEI_IND       = 0x88
+        };
+
+    enum STATE // Q.921 data link states
+    {
+        TEI_UNASSIGNED              = 1,
+        AWAITING_TEI                = 2,
+        TEI_ASSIGNED                = 4,
+        AWAITING_ESTABLISHMENT      = 5,
+        AWAITING_RELEASE            = 6,
+        MULTIPLE_FRAME_ESTABLISHED  = 7,
+        TIMER_RECOVERY              = 8
+        };
+
+    enum // Request results
+    {
+        REQ_OK            = 0,
+        REQ_INVALID       = 1, // Bad parameters or state
+        REQ_FULL          = 2  // No room in I-frame queue
+        };
+
+    enum
+    {
+        TEI_AUTO          = 127,
+        MAX_L3_LEN        = FrameRing::MAX_LEN - 4 // Minus address & control
+        };
+
+private:
+
+    enum // instead of #defines
+    {
+        T200              = 1000, // Retransmission timer (in ms)
+        T202              = 2000, // TEI identity request timer (in ms)
+        T203              = 10000, // Max time without frames (in ms)
+        N200              = 3,    // Max retransmissions
+        N202              = 3,    // Max TEI identity requests
+        K_DEFAULT         = 1,    // Window size for SAPI 0 on basic access
+        K_MAX             = 7,
+
+        SAPI_CALL_CONTROL = 0,
+        SAPI_TEI_MGMT     = 63,
+        GROUP_TEI         = 127,
+
+        // Control field (modulo 128)
+        //
+        CTL_RR            = 0x01,
+        CTL_RNR           = 0x05,
+        CTL_REJ           = 0x09,
+        CTL_SABME         = 0x6F,
+        CTL_DM            = 0x0F,
+        CTL_UI            = 0x03,
+        CTL_DISC          = 0x43,
+        CTL_UA            = 0x63,
+        CTL_FRMR          = 0x87,
+        CTL_PF            = 0x10, // P/F bit in U frames
+
+        // TEI management
+        //
+        TEI_MEI           = 0x0F,
+        TM_ID_REQUEST     = 1,
+        TM_ID_ASSIGNED    = 2,
+        TM_ID_DENIED      = 3,
+        TM_ID_CHECK_REQ   = 4,
+        TM_ID_CHECK_RESP  = 5,
+        TM_ID_REMOVE      = 6,
+
+        // Expired timer bits
+        //
+        EXP_T200          = 0x01,
+        EXP_T202          = 0x02,
+        EXP_T203          = 0x04
+        };
+
+    USB_Link* link;
+    unsigned char pt;           // Port ID
+
+    unsigned char state;
+    unsigned char tei;          // Current TEI, TEI_AUTO if none
+    unsigned char fixed_tei;    // Configured TEI, TEI_AUTO for assignment
+    unsigned char k;            // Window size
+
+    unsigned char VS;           // Send state variable
+    unsigned char VA;           // Acknowledge state variable
+    unsigned char VR;           // Receive state variable
+    unsigned char rc;           // Retransmission counter
+    unsigned short ri;          // TEI assignment reference
+
+    struct
+    {
+        bool enabled          : 1;
+        bool network          : 1; // Network side; affects C/R bit
+        bool peer_busy        : 1;
+        bool reject_exception : 1;
+        bool ack_pending      : 1;
+        bool layer3_initiated : 1;
+        bool establish_pending: 1; // DL_ESTABLISH_REQ while awaiting TEI
+        } flags;
+
+    unsigned short t200;        // Timer counters in ms, 0 = stopped
+    unsigned short t202;
+    unsigned short t203;
+    unsigned char expired;      // EXP_* bits
+
+    FrameRing iq;               // I-frames: not acknowledged, then not sent
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // Timers
+
+    void StartT200( void ) { t200 = T200; expired &= ~EXP_T200; }
+    void StopT200( void )  { t200 = 0;    expired &= ~EXP_T200; }
+    void StartT202( void ) { t202 = T202; expired &= ~EXP_T202; }
+    void StopT202( void )  { t202 = 0;    expired &= ~EXP_T202; }
+    void StartT203( void ) { t203 = T203; expired &= ~EXP_T203; }
+    void StopT203( void )  { t203 = 0;    expired &= ~EXP_T203; }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // Host indications
+
+    void Indicate( int prim, int arg = -1 )
+    {
+        unsigned char buf[ 2 ];
+        buf[ 0 ] = prim;
+        buf[ 1 ] = arg;
+
+        link->SendFrame( USB_Link::FRM_CTL_LAPD_IND, pt, buf, arg < 0 ? 1 : 2 );
+        }
+
+    // Sends L3 message from received frame at the tail of ring
+    //
+    void IndicateData( int prim, const FrameRing& ring, int offset, int len )
+    {
+        unsigned char hdr = prim;
+
+        link->BeginFrame( USB_Link::FRM_CTL_LAPD_IND, pt, 1 + len );
+        link->PutData( &hdr, 1 );
+
+        while ( len > 0 )
+        {
+            const unsigned char* p;
+            int n = ring.GetChunk( offset, p );
+            if ( n > len )
+                n = len;
+
+            link->PutData( p, n );
+            offset += n;
+            len -= n;
+            }
+
+        link->EndFrame ();
+        }
+
+    void MdlError( int code )
+    {
+        Indicate( MDL_ERROR_IND, code );
+        }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // Frame transmission
+
+    FrameRing& TX( void )
+    {
+        return hfc.port[ pt ].Get_D_TX_Ring ();
+        }
+
+    void PutAddress( FrameRing& tx, int sapi, bool command, int t )
+    {
+        // User side sends commands with C/R = 0, network side with C/R = 1
+        //
+        int cr = command == flags.network ? 0x02 : 0x00;
+
+        tx.Put( ( sapi << 2 ) | cr );
+        tx.Put( ( t << 1 ) | 0x01 );
+        }
+
+    void SendU( int ctl, bool command, bool pf )
+    {
+        FrameRing& tx = TX ();
+
+        PutAddress( tx, SAPI_CALL_CONTROL, command, tei );
+        tx.Put( ctl | ( pf ? CTL_PF : 0 ) );
+        tx.Commit ();
+        }
+
+    void SendS( int ctl, bool command, bool pf )
+    {
+        FrameRing& tx = TX ();
+
+        PutAddress( tx, SAPI_CALL_CONTROL, command, tei );
+        tx.Put( ctl );
+        tx.Put( ( VR << 1 ) | ( pf ? 0x01 : 0x00 ) );
+        tx.Commit ();
+
+        flags.ack_pending = false;
+        }
+
+    void SendUI( int sapi, int t, const unsigned char* data, int len )
+    {
+        FrameRing& tx = TX ();
+
+        PutAddress( tx, sapi, true, t );
+        tx.Put( CTL_UI );
+        tx.Put( data, len );
+        tx.Commit ();
+        }
+
+    // Sends I-frame from iq; returns false if there is no room in TX ring
+    //
+    bool SendI( int pos )
+    {
+        FrameRing& tx = TX ();
+
+        int len = iq.GetLenAt( pos );
+        if ( tx.GetFree () < 4 + len )
+            return false;
+
+        PutAddress( tx, SAPI_CALL_CONTROL, true, tei );
+        tx.Put( VS << 1 );
+        tx.Put( VR << 1 );
+
+        for ( int offset = 0; offset < len; )
+        {
+            const unsigned char* p;
+            int n = iq.GetChunkAt( pos, offset, p );
+
+            tx.Put( p, n );
+            offset += n;
+            }
+
+        return tx.Commit ();
+        }
+
+    // RR command with P = 1
+    //
+    void TransmitEnquiry( void )
+    {
+        SendS( CTL_RR, true, true );
+        }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // Data link procedures
+
+    void ResetLink( void )
+    {
+        VS = VA = VR = 0;
+        rc = 0;
+        flags.peer_busy = false;
+        flags.reject_exception = false;
+        flags.ack_pending = false;
+        iq.Reset ();
+        }
+
+    void EstablishDataLink( void )
+    {
+        rc = 0;
+        flags.peer_busy = false;
+        flags.reject_exception = false;
+
+        SendU( CTL_SABME, true, true );
+        StartT200 ();
+        StopT203 ();
+        state = AWAITING_ESTABLISHMENT;
+        }
+
+    void ReleaseLink( int prim )
+    {
+        iq.Reset ();
+        StopT200 ();
+        StopT203 ();
+        state = TEI_ASSIGNED;
+        Indicate( prim );
+        }
+
+    bool IsValidNR( int nr ) const
+    {
+        return ( ( nr - VA ) & 0x7F ) <= ( ( VS - VA ) & 0x7F );
+        }
+
+    void AckIFrames( int nr )
+    {
+        while ( VA != nr )
+        {
+            iq.Pop ();
+            VA = ( VA + 1 ) & 0x7F;
+            }
+        }
+
+    void OnNRError( void )
+    {
+        MdlError( 'J' );
+        EstablishDataLink ();
+        flags.layer3_initiated = false;
+        }
+
+    // N(R) of I-frame or RR in MULTIPLE_FRAME_ESTABLISHED
+    //
+    void OnNR( int nr )
+    {
+        if ( state == TIMER_RECOVERY || flags.peer_busy )
+        {
+            AckIFrames( nr );
+            }
+        else if ( nr == VS )
+        {
+            AckIFrames( nr );
+            StopT200 ();
+            StartT203 ();
+            }
+        else if ( nr != VA )
+        {
+            AckIFrames( nr );
+            StartT200 ();
+            }
+        }
+
+    void OnIFrame( int ns, int nr, bool p, const FrameRing& ring, int len )
+    {
+        if ( state != MULTIPLE_FRAME_ESTABLISHED && state != TIMER_RECOVERY )
+            return;
+
+        if ( ns == VR )
+        {
+            VR = ( VR + 1 ) & 0x7F;
+            flags.reject_exception = false;
+
+            IndicateData( DL_DATA_IND, ring, 4, len - 4 );
+
+            if ( p )
+                SendS( CTL_RR, false, true );
+            else
+                flags.ack_pending = true;
+            }
+        else if ( flags.reject_exception )
+        {
+            if ( p )
+                SendS( CTL_RR, false, true );
+            }
+        else
+        {
+            flags.reject_exception = true;
+            SendS( CTL_REJ, false, p );
+            }
+
+        if ( ! IsValidNR( nr ) )
+        {
+            OnNRError ();
+            return;
+            }
+
+        OnNR( nr );
+        }
+
+    void OnSFrame( int ctl, bool command, int nr, bool pf )
+    {
+        if ( state != MULTIPLE_FRAME_ESTABLISHED && state != TIMER_RECOVERY )
+            return;
+
+        if ( ctl != CTL_RR && ctl != CTL_RNR && ctl != CTL_REJ )
+            return;
+
+        flags.peer_busy = ctl == CTL_RNR;
+
+        if ( command && pf ) // Enquiry
+            SendS( CTL_RR, false, true );
+
+        if ( ! IsValidNR( nr ) )
+        {
+            OnNRError ();
+            return;
+            }
+
+        if ( state == TIMER_RECOVERY )
+        {
+            AckIFrames( nr );
+
+            if ( ! command && pf ) // Answer to our enquiry
+            {
+                if ( flags.peer_busy )
+                    StartT200 ();
+                else
+                {
+                    StopT200 ();
+                    StartT203 ();
+                    }
+
+                VS = VA; // Retransmit not acknowledged I-frames
+                state = MULTIPLE_FRAME_ESTABLISHED;
+                }
+            return;
+            }
+
+        if ( ! command && pf )
+            MdlError( 'A' );
+
+        if ( ctl == CTL_RR )
+        {
+            OnNR( nr );
+            }
+        else if ( ctl == CTL_REJ )
+        {
+            AckIFrames( nr );
+            StopT200 ();
+            StartT203 ();
+            VS = VA; // Retransmit not acknowledged I-frames
+            }
+        else // RNR
+        {
+            AckIFrames( nr );
+            StopT203 ();
+            StartT200 ();
+            }
+        }
+
+    void OnUFrame( int ctl, bool command, bool pf )
+    {
+        switch( ctl )
+        {
+            case CTL_SABME:
+                if ( ! command )
+                    break;
+
+                if ( state == AWAITING_RELEASE )
+                {
+                    SendU( CTL_DM, false, pf );
+                    break;
+                    }
+
+                SendU( CTL_UA, false, pf );
+
+                if ( state == AWAITING_ESTABLISHMENT ) // Collision
+                    break;
+
+                if ( state != TEI_ASSIGNED )
+                    MdlError( 'F' );
+
+                ResetLink ();
+                StopT200 ();
+                StartT203 ();
+                state = MULTIPLE_FRAME_ESTABLISHED;
+                Indicate( DL_ESTABLISH_IND );
+                break;
+
+            case CTL_DISC:
+                if ( ! command )
+                    break;
+
+                if ( state == TEI_ASSIGNED || state == AWAITING_ESTABLISHMENT )
+                {
+                    SendU( CTL_DM, false, pf );
+                    }
+                else if ( state == AWAITING_RELEASE )
+                {
+                    SendU( CTL_UA, false, pf );
+                    }
+                else // Multiple frame established, timer recovery
+                {
+                    SendU( CTL_UA, false, pf );
+                    ReleaseLink( DL_RELEASE_IND );
+                    }
+                break;
+
+            case CTL_UA:
+                if ( command )
+                    break;
+
+                if ( state == AWAITING_ESTABLISHMENT )
+                {
+                    if ( ! pf )
+                    {
+                        MdlError( 'D' );
+                        break;
+                        }
+
+                    ResetLink ();
+                    StopT200 ();
+                    StartT203 ();
+                    state = MULTIPLE_FRAME_ESTABLISHED;
+                    Indicate( flags.layer3_initiated ? DL_ESTABLISH_CONF : DL_ESTABLISH_IND );
+                    }
+                else if ( state == AWAITING_RELEASE )
+                {
+                    if ( ! pf )
+                    {
+                        MdlError( 'D' );
+                        break;
+                        }
+
+                    ReleaseLink( DL_RELEASE_CONF );
+                    }
+                else if ( state >= MULTIPLE_FRAME_ESTABLISHED )
+                {
+                    MdlError( pf ? 'C' : 'D' );
+                    }
+                break;
+
+            case CTL_DM:
+                if ( command )
+                    break;
+
+                if ( state == AWAITING_ESTABLISHMENT )
+                {
+                    if ( pf )
+                        ReleaseLink( DL_RELEASE_IND );
+                    }
+                else if ( state == AWAITING_RELEASE )
+                {
+                    if ( pf )
+                        ReleaseLink( DL_RELEASE_CONF );
+                    }
+                else if ( state >= MULTIPLE_FRAME_ESTABLISHED )
+                {
+                    MdlError( pf ? 'B' : 'E' );
+                    EstablishDataLink ();
+                    flags.layer3_initiated = false;
+                    }
+                else if ( state == TEI_ASSIGNED && ! pf ) // Peer asks for establishment
+                {
+                    EstablishDataLink ();
+                    flags.layer3_initiated = false;
+                    }
+                break;
+
+            case CTL_FRMR:
+                if ( state >= MULTIPLE_FRAME_ESTABLISHED )
+                {
+                    MdlError( 'K' );
+                    EstablishDataLink ();
+                    flags.layer3_initiated = false;
+                    }
+                break;
+            }
+        }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // TEI management (user side)
+
+    void NewReference( void )
+    {
+        ri = (unsigned short)( hfc.GetF0Count () * 31421u + ri + 6927u );
+        }
+
+    void SendTeiMessage( int type, int ai )
+    {
+        unsigned char msg[ 5 ];
+        msg[ 0 ] = TEI_MEI;
+        msg[ 1 ] = ri >> 8;
+        msg[ 2 ] = ri & 0xFF;
+        msg[ 3 ] = type;
+        msg[ 4 ] = ( ai << 1 ) | 0x01;
+
+        SendUI( SAPI_TEI_MGMT, GROUP_TEI, msg, sizeof( msg ) );
+        }
+
+    void StartTeiAssignment( void )
+    {
+        rc = 0;
+        NewReference ();
+        SendTeiMessage( TM_ID_REQUEST, GROUP_TEI );
+        StartT202 ();
+        state = AWAITING_TEI;
+        }
+
+    void RemoveTei( void )
+    {
+        bool was_up = state >= AWAITING_ESTABLISHMENT;
+
+        iq.Reset ();
+        StopT200 ();
+        StopT203 ();
+
+        if ( was_up )
+            Indicate( DL_RELEASE_IND );
+
+        tei = TEI_AUTO;
+        state = TEI_UNASSIGNED;
+        Indicate( MDL_TEI_IND, TEI_AUTO );
+        }
+
+    void OnTeiManagement( const FrameRing& ring, int len )
+    {
+        if ( len < 3 + 5 || fixed_tei != TEI_AUTO )
+            return;
+
+        unsigned char msg[ 5 ];
+        for ( int i = 0; i < 5; i++ )
+            msg[ i ] = Octet( ring, 3 + i );
+
+        if ( msg[ 0 ] != TEI_MEI )
+            return;
+
+        unsigned short ref = ( msg[ 1 ] << 8 ) | msg[ 2 ];
+        int ai = msg[ 4 ] >> 1;
+
+        switch( msg[ 3 ] )
+        {
+            case TM_ID_ASSIGNED:
+                if ( state != AWAITING_TEI || ref != ri )
+                    break;
+
+                StopT202 ();
+                tei = ai;
+                state = TEI_ASSIGNED;
+                Indicate( MDL_TEI_IND, tei );
+
+                if ( flags.establish_pending )
+                {
+                    flags.establish_pending = false;
+                    EstablishDataLink ();
+                    flags.layer3_initiated = true;
+                    }
+                break;
+
+            case TM_ID_DENIED: // Retried on T202 expiry
+                break;
+
+            case TM_ID_CHECK_REQ:
+                if ( state >= TEI_ASSIGNED && ( ai == GROUP_TEI || ai == tei ) )
+                {
+                    NewReference ();
+                    SendTeiMessage( TM_ID_CHECK_RESP, tei );
+                    }
+                break;
+
+            case TM_ID_REMOVE:
+                if ( state >= TEI_ASSIGNED && ( ai == GROUP_TEI || ai == tei ) )
+                    RemoveTei ();
+                break;
+            }
+        }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // Timer expiry
+
+    void OnT200( void )
+    {
+        switch( state )
+        {
+            case AWAITING_ESTABLISHMENT:
+                if ( rc >= N200 )
+                {
+                    MdlError( 'G' );
+                    ReleaseLink( DL_RELEASE_IND );
+                    break;
+                    }
+                ++rc;
+                SendU( CTL_SABME, true, true );
+                StartT200 ();
+                break;
+
+            case AWAITING_RELEASE:
+                if ( rc >= N200 )
+                {
+                    MdlError( 'H' );
+                    ReleaseLink( DL_RELEASE_CONF );
+                    break;
+                    }
+                ++rc;
+                SendU( CTL_DISC, true, true );
+                StartT200 ();
+                break;
+
+            case MULTIPLE_FRAME_ESTABLISHED:
+                rc = 0;
+                TransmitEnquiry ();
+                StartT200 ();
+                state = TIMER_RECOVERY;
+                break;
+
+            case TIMER_RECOVERY:
+                if ( rc >= N200 )
+                {
+                    MdlError( 'I' );
+                    EstablishDataLink ();
+                    flags.layer3_initiated = false;
+                    break;
+                    }
+                ++rc;
+                TransmitEnquiry ();
+                StartT200 ();
+                break;
+            }
+        }
+
+    void OnT202( void )
+    {
+        if ( state != AWAITING_TEI )
+            return;
+
+        if ( ++rc >= N202 )
+        {
+            state = TEI_UNASSIGNED;
+
+            if ( flags.establish_pending )
+            {
+                flags.establish_pending = false;
+                Indicate( DL_RELEASE_IND );
+                }
+            return;
+            }
+
+        NewReference ();
+        SendTeiMessage( TM_ID_REQUEST, GROUP_TEI );
+        StartT202 ();
+        }
+
+    void OnT203( void )
+    {
+        if ( state != MULTIPLE_FRAME_ESTABLISHED )
+            return;
+
+        rc = 0;
+        TransmitEnquiry ();
+        StartT200 ();
+        state = TIMER_RECOVERY;
+        }
+
+    static int Octet( const FrameRing& ring, int offset )
+    {
+        const unsigned char* p;
+        ring.GetChunk( offset, p );
+        return *p;
+        }
+
+public:
+
+    LAPD( void )
+    {
+        link = 0;
+        pt = 0;
+        t200 = t202 = t203 = 0;
+        expired = 0;
+        flags.enabled = false;
+        Configure( false, TEI_AUTO, K_DEFAULT );
+        }
+
+    void Initialize( int p_pt, USB_Link& p_link )
+    {
+        pt = p_pt;
+        link = &p_link;
+        }
+
+    bool IsEnabled( void ) const
+    {
+        return flags.enabled;
+        }
+
+    int GetState( void ) const
+    {
+        return state;
+        }
+
+    int GetTei( void ) const
+    {
+        return tei;
+        }
+
+    int GetQueued( void ) const
+    {
+        return iq.GetCount ();
+        }
+
+    // Enables/disables data link entity; the link is reset in any case
+    //
+    int Configure( bool enable, int p_tei, int p_k )
+    {
+        // Rejected requests leave the entity as it is
+        //
+        bool network = link && hfc.port[ pt ].IsNT ();
+
+        if ( p_tei > TEI_AUTO || p_k > K_MAX || ( network && p_tei == TEI_AUTO && enable ) )
+            return REQ_INVALID;
+
+        flags.enabled = enable;
+        flags.network = network;
+        flags.layer3_initiated = false;
+        flags.establish_pending = false;
+
+        fixed_tei = p_tei;
+        tei = p_tei;
+        k = p_k ? p_k : K_DEFAULT;
+        ri = 0;
+
+        ResetLink ();
+        StopT200 ();
+        StopT202 ();
+        StopT203 ();
+
+        state = tei == TEI_AUTO ? TEI_UNASSIGNED : TEI_ASSIGNED;
+        return REQ_OK;
+        }
+
+    // Decrements running timer; true when it expires
+    //
+    static bool Elapse( unsigned short& t, int ms )
+    {
+        if ( ! t )
+            return false;
+
+        t = t > ms ? t - ms : 0;
+        return t == 0;
+        }
+
+    // Called from EH_TimerTicks every timer tick of ms milliseconds
+    //
+    void TimerTick( int ms )
+    {
+        if ( Elapse( t200, ms ) )
+            expired |= EXP_T200;
+
+        if ( Elapse( t202, ms ) )
+            expired |= EXP_T202;
+
+        if ( Elapse( t203, ms ) )
+            expired |= EXP_T203;
+        }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // Requests from host
+
+    int DL_EstablishRequest( void )
+    {
+        if ( ! flags.enabled )
+            return REQ_INVALID;
+
+        if ( ! hfc.port[ pt ].IsActivated () )
+            hfc.port[ pt ].PH_ActivateRequest ();
+
+        switch( state )
+        {
+            case TEI_UNASSIGNED:
+                flags.establish_pending = true;
+                StartTeiAssignment ();
+                break;
+
+            case AWAITING_TEI:
+                flags.establish_pending = true;
+                break;
+
+            case AWAITING_RELEASE:
+                return REQ_INVALID;
+
+            default:
+                iq.Reset ();
+                EstablishDataLink ();
+                flags.layer3_initiated = true;
+                break;
+            }
+
+        return REQ_OK;
+        }
+
+    int DL_ReleaseRequest( void )
+    {
+        if ( ! flags.enabled )
+            return REQ_INVALID;
+
+        switch( state )
+        {
+            case TEI_UNASSIGNED:
+            case AWAITING_TEI:
+            case TEI_ASSIGNED:
+                flags.establish_pending = false;
+                Indicate( DL_RELEASE_CONF );
+                break;
+
+            case AWAITING_RELEASE:
+                break;
+
+            default:
+                iq.Reset ();
+                rc = 0;
+                SendU( CTL_DISC, true, true );
+                StopT203 ();
+                StartT200 ();
+                state = AWAITING_RELEASE;
+                break;
+            }
+
+        return REQ_OK;
+        }
+
+    int DL_DataRequest( const unsigned char* data, int len )
+    {
+        if ( ! flags.enabled || len < 1 || len > MAX_L3_LEN
+            || state < AWAITING_ESTABLISHMENT || state == AWAITING_RELEASE )
+        {
+            return REQ_INVALID;
+            }
+
+        if ( ! iq.Put( data, len ) || ! iq.Commit () )
+        {
+            iq.Discard ();
+            return REQ_FULL;
+            }
+
+        return REQ_OK;
+        }
+
+    int DL_UnitDataRequest( const unsigned char* data, int len )
+    {
+        if ( ! flags.enabled || len < 1 || len > MAX_L3_LEN || state < TEI_ASSIGNED )
+            return REQ_INVALID;
+
+        SendUI( SAPI_CALL_CONTROL, tei, data, len );
+        return REQ_OK;
+        }
+
+    //////////////////////////////////////////////////////////////////////////////////
+
+    // Frame at the tail of RX ring (data, FCS, STAT) received
+    //
+    void OnFrame( const FrameRing& ring )
+    {
+        int len = ring.GetLen () - 3; // Without FCS and STAT
+
+        if ( len < 3 || Octet( ring, len + 2 ) != 0x00 ) // Too short, CRC error
+            return;
+
+        int a0 = Octet( ring, 0 );
+        int a1 = Octet( ring, 1 );
+        int c0 = Octet( ring, 2 );
+
+        if ( ( a0 & 0x01 ) || ! ( a1 & 0x01 ) ) // EA bits
+            return;
+
+        int sapi = a0 >> 2;
+        int t = a1 >> 1;
+
+        // Commands from network side have C/R = 1, from user side C/R = 0
+        //
+        bool command = ( ( a0 & 0x02 ) != 0 ) != flags.network;
+
+        if ( ( c0 & ~CTL_PF ) == CTL_UI )
+        {
+            if ( sapi == SAPI_TEI_MGMT && t == GROUP_TEI )
+                OnTeiManagement( ring, len );
+            else if ( sapi == SAPI_CALL_CONTROL && ( t == GROUP_TEI || t == tei ) )
+                IndicateData( DL_UNITDATA_IND, ring, 3, len - 3 );
+            return;
+            }
+
+        if ( sapi != SAPI_CALL_CONTROL || t != tei || state < TEI_ASSIGNED )
+            return;
+
+        if ( ! ( c0 & 0x01 ) ) // I-frame
+        {
+            if ( len >= 4 && command )
+            {
+                int c1 = Octet( ring, 3 );
+                OnIFrame( c0 >> 1, c1 >> 1, c1 & 0x01, ring, len );
+                }
+            }
+        else if ( ( c0 & 0x03 ) == 0x01 ) // S-frame
+        {
+            if ( len >= 4 )
+            {
+                int c1 = Octet( ring, 3 );
+                OnSFrame( c0, command, c1 >> 1, c1 & 0x01 );
+                }
+            }
+        else // U-frame
+        {
+            OnUFrame( c0 & ~CTL_PF, command, ( c0 & CTL_PF ) != 0 );
+            }
+        }
+
+    // Handles expired timers, transmits I-frames and pending
+    // acknowledgement. Called from main loop.
+    //
+    void Poll( void )
+    {
+        if ( ! flags.enabled )
+            return;
+
+        if ( expired & EXP_T200 )
+        {
+            expired &= ~EXP_T200;
+            OnT200 ();
+            }
+
+        if ( expired & EXP_T202 )
+        {
+            expired &= ~EXP_T202;
+            OnT202 ();
+            }
+
+        if ( expired & EXP_T203 )
+        {
+            expired &= ~EXP_T203;
+            OnT203 ();
+            }
+
+        while ( state == MULTIPLE_FRAME_ESTABLISHED && ! flags.peer_busy )
+        {
+            int outstanding = ( VS - VA ) & 0x7F;
+
+            if ( outstanding >= k || outstanding >= iq.GetCount () )
+                break;
+
+            if ( ! SendI( iq.Seek( outstanding ) ) )
+                break;
+
+            VS = ( VS + 1 ) & 0x7F;
+            flags.ack_pending = false; // N(R) was sent with I-frame
+
+            if ( ! t200 )
+            {
+                StopT203 ();
+                StartT200 ();
+                }
+            }
+
+        if ( flags.ack_pending )
+            SendS( CTL_RR, false, false );
+        }
+    };
+
+extern LAPD lapd[];
+
+#endif // _LAPD_H_INCLUDED
@@ -0,0 +1,216 @@
+#ifndef _TRACE_H_INCLUDED
+#define _TRACE_H_INCLUDED
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "usblink.h"
+
+extern bool usb_TxReady( void );
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Trace: non-blocking tracef() output
+//
+// tracef() only stores a binary record (format address and raw argument
+// values) in a RAM ring and never waits for the USB FIFO. Poll() sends
+// one record per call as a TRACE frame, and only when the FIFO accepts
+// data. MAX_FORMAT bounds the frame to the FT245 transmit buffer, so a
+// frame started on asserted TXE# does not stall the main loop (which
+// runs with INT2 masked) for more than one USB transfer. Formatting to
+// hex is done by the host. Records that do not fit into the ring, or
+// whose format is longer than MAX_FORMAT, are dropped and counted.
+//
+class Trace
+{
+/*
+    TRACE frame (USB-PIO -> Host), ADDR = 0:
+
+    +---+---+---+---+---+---+---+---+
+    |          DROPPED HI           |  Records dropped, mod 2^16
+    +---+---+---+---+---+---+---+---+
+    |          DROPPED LO           |
+    +---+---+---+---+---+---+---+---+
+    |            FORMAT             |  tracef() format, NUL terminated
+    +---+---+---+---+---+---+---+---+
+    |             ARGS              |  Argument values in format order
+    +---+---+---+---+---+---+---+---+
+
+    Conversion  ARGS                    Printed by host as
+
+    %c          VALUE                   2 hex digits
+    %s          VALUE HI, VALUE LO      4 hex digits
+    %l          VALUE (4 octets, MSB)   8 hex digits
+    %a          COUNT, OCTETS[COUNT]    hex octets separated by space
+    %%          -                       '%'
+
+    The host ends every record with a new line. %a dumps are cut at
+    MAX_DUMP octets.
+
+    Ring record: LEN, FORMAT address (sizeof(char*) octets), ARGS.
+*/
+
+    enum // instead of #defines
+    {
+        RING_SIZE         = 64,   // Must be power of 2
+        MAX_ARGS          = 24,   // Argument octets per record
+        MAX_DUMP          = 16,   // Octets of %a dump
+        TX_FIFO           = 128,  // FT245 transmit buffer
+        FRAME_OVERHEAD    = 8,    // FLG1, FLG2, BC, CTL, ADDR, DROPPED, CS
+        MAX_FORMAT        = TX_FIFO - FRAME_OVERHEAD - MAX_ARGS // Incl. NUL
+        };
+
+    USB_Link& link;
+
+    unsigned char ring[ RING_SIZE ];
+    unsigned char head;           // Next octet to put
+    unsigned char tail;           // Next octet to send
+
+    unsigned int dropped;
+
+    int GetFree( void ) const
+    {
+        return ( tail - head - 1 ) & ( RING_SIZE - 1 );
+        }
+
+    void PutOctet( int octet )
+    {
+        ring[ head ] = octet;
+        head = ( head + 1 ) & ( RING_SIZE - 1 );
+        }
+
+    int GetOctet( void )
+    {
+        int octet = ring[ tail ];
+        tail = ( tail + 1 ) & ( RING_SIZE - 1 );
+        return octet;
+        }
+
+public:
+
+    Trace( USB_Link& p_link )
+        : link( p_link )
+    {
+        head = tail = 0;
+        dropped = 0;
+        }
+
+    unsigned int GetDropped( void ) const
+    {
+        return dropped;
+        }
+
+    // Stores tracef() record
+    //
+    void Put( const char* format, va_list marker )
+    {
+        unsigned char args[ MAX_ARGS ];
+        int n = 0;
+
+        for ( const char* f = format; *f; f++ )
+        {
+            if ( *f != '%' || *++f == 0 )
+                continue;
+
+            if ( *f == 'c' && n + 1 <= MAX_ARGS )
+            {
+                args[ n++ ] = va_arg( marker, int );
+                }
+            else if ( *f == 's' && n + 2 <= MAX_ARGS )
+            {
+                int x = va_arg( marker, int );
+                args[ n++ ] = x >> 8;
+                args[ n++ ] = x;
+                }
+            else if ( *f == 'l' && n + 4 <= MAX_ARGS )
+            {
+                long x = va_arg( marker, long );
+                args[ n++ ] = x >> 24;
+                args[ n++ ] = x >> 16;
+                args[ n++ ] = x >> 8;
+                args[ n++ ] = x;
+                }
+            else if ( *f == 'a' && n + 1 <= MAX_ARGS )
+            {
+                const unsigned char* p = va_arg( marker, const unsigned char* );
+                int count = va_arg( marker, int );
+
+                if ( count > MAX_DUMP )
+                    count = MAX_DUMP;
+                if ( count > MAX_ARGS - n - 1 )
+                    count = MAX_ARGS - n - 1;
+                if ( count < 0 )
+                    count = 0;
+
+                args[ n++ ] = count;
+                for ( ; count > 0; count-- )
+                    args[ n++ ] = *p++;
+                }
+            else if ( *f != '%' ) // Arguments do not fit; host gets short record
+            {
+                break;
+                }
+            }
+
+        int len = 1 + sizeof( format ) + n;
+
+        if ( GetFree () < len )
+        {
+            ++dropped;
+            return;
+            }
+
+        PutOctet( len );
+
+        const unsigned char* p = (const unsigned char*)&format;
+        for ( unsigned int i = 0; i < sizeof( format ); i++ )
+            PutOctet( p[ i ] );
+
+        for ( int i = 0; i < n; i++ )
+            PutOctet( args[ i ] );
+        }
+
+    // Sends at most one record. Called from main loop.
+    // Returns true if a record was taken from the ring.
+    //
+    bool Poll( void )
+    {
+        if ( head == tail || ! usb_TxReady () )
+            return false;
+
+        int len = GetOctet () - 1;
+
+        const char* format;
+        unsigned char* p = (unsigned char*)&format;
+        for ( unsigned int i = 0; i < sizeof( format ); i++ )
+            *p++ = GetOctet ();
+
+        len -= sizeof( format );
+
+        unsigned char args[ MAX_ARGS ];
+        for ( int i = 0; i < len; i++ )
+            args[ i ] = GetOctet ();
+
+        int flen = strlen( format ) + 1;
+        if ( flen > MAX_FORMAT )
+        {
+            ++dropped; // Host sees it in next record
+            return true;
+            }
+
+        unsigned char hdr[ 2 ];
+        hdr[ 0 ] = dropped >> 8;
+        hdr[ 1 ] = dropped;
+
+        link.BeginFrame( USB_Link::FRM_CTL_TRACE, 0, sizeof( hdr ) + flen + len );
+        link.PutData( hdr, sizeof( hdr ) );
+        link.PutData( (const unsigned char*)format, flen );
+        link.PutData( args, len );
+        link.EndFrame ();
+
+        return true;
+        }
+    };
+
+extern Trace trace;
+
+#endif // _TRACE_H_INCLUDED
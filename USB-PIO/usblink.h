@@ -0,0 +1,267 @@
+#ifndef _USBLINK_H_INCLUDED
+#define _USBLINK_H_INCLUDED
+
+extern void usb_Put( int ch );
+
+//////////////////////////////////////////////////////////////////////////////////////
+// USB Link: binary frames between host and USB-PIO
+//
+// All output, including tracef() (see trace.h), is sent in frames. All
+// commands from the host are frames (see hostcmd.h); octets received
+// outside of a frame are reported as RX_CONSOLE and ignored.
+//
+class USB_Link
+{
+/*
+    Host <-> USB-PIO frame format (same as in USB-TAU-D):
+
+    +---+---+---+---+---+---+---+---+
+    | 7 | 6 | 5 | 4 | 3 | 2 | 1 | 0 |
+    +---+---+---+---+---+---+---+---+
+    | 0   0   0   1   0   1   0   1 |  FRM_FLG1  (0x15)
+    +---+---+---+---+---+---+---+---+
+    | 0   0   0   1   0   1   0   1 |  FRM_FLG2  (0x15)
+    +---+---+---+---+---+---+---+---+
+    | x   x   x   x   x   x   x   x |  FRM_BC    (4 .. 4 + MAX_DATA)
+    +---+---+---+---+---+---+---+---+
+    |      SN       |     TYPE      |  FRM_CTL
+    +---+---+---+---+---+---+---+---+
+    | x   x   x   x   x   x   x   x |  FRM_ADDR
+    +---+---+---+---+---+---+---+---+
+    | x   x   x   x   x   x   x   x |  FRM_DATA  (optional)
+    +---+---+---+---+---+---+---+---+
+    | x   x   x   x   x   x   x   x |  FRM_CS
+    +---+---+---+---+---+---+---+---+
+
+    BC: byte count (including FRM_BC and FRM_CS, excluding FRM_FLG*)
+
+    CS: checksum ( (sum - 1) mod 256, including BC, CTL, ADDR & DATA)
+
+    SN: sequence number mod 16 (0..15), incremented for every frame sent
+
+    TYPE:
+
+        Bit 3:    0 = Request (host -> USB-PIO), 1 = Response or indication
+        Bit 2..0: Frame type
+
+        AUDIO           0 0 0 0    0x00   both directions, see bstream.h
+        AUDIO_STATS_REQ 0 0 0 1    0x01
+        BERT            1 0 0 0    0x08   see bert.h (XHFC_BERT builds only)
+        AUDIO_STATS     1 0 0 1    0x09
+        CMD             0 0 1 1    0x03   see hostcmd.h
+        D_RX            1 0 1 0    0x0A   see dstream.h
+        CMD_ACK         1 0 1 1    0x0B   see hostcmd.h
+        LAPD_IND        1 1 0 0    0x0C   see lapd.h (XHFC_LAPD builds only)
+        TRACE           1 1 0 1    0x0D   see trace.h
+        B_RX            1 1 1 0    0x0E   see dstream.h (XHFC_B_HDLC builds only)
+        CLOCK           1 1 1 1    0x0F   see clockmon.h (XHFC_CLOCKMON builds only)
+*/
+
+public:
+
+    enum // Frame Header Flags
+    {
+        FRM_FLG1            = 0x15,
+        FRM_FLG2            = 0x15
+        };
+
+    enum // Frame Control
+    {
+        // Bits 7..4: Sequence Number
+        //
+        FRM_SN_SHIFT        = 4,
+        FRM_SN_MASK         = 0x0F,
+
+        // Bits 3..0: Frame Type
+        //
+        FRM_CTL_MASK            = 0x0F,
+        FRM_CTL_AUDIO           = 0x00,
+        FRM_CTL_AUDIO_STATS_REQ = 0x01,
+        FRM_CTL_CMD             = 0x03,
+        FRM_CTL_BERT            = 0x08,
+        FRM_CTL_AUDIO_STATS     = 0x09,
+        FRM_CTL_D_RX            = 0x0A,
+        FRM_CTL_CMD_ACK         = 0x0B,
+        FRM_CTL_LAPD_IND        = 0x0C,
+        FRM_CTL_TRACE           = 0x0D,
+        FRM_CTL_B_RX            = 0x0E,
+        FRM_CTL_CLOCK           = 0x0F
+        };
+
+    enum // OnReceivedOctet() return codes
+    {
+        RX_NONE             = 0, // Octet consumed by the frame receiver
+        RX_CONSOLE          = 1, // Octet is not part of a frame
+        RX_FRAME            = 2  // Valid frame received
+        };
+
+    enum
+    {
+        MAX_DATA            = 72 // Max received data length (CMD with D frame)
+        };
+
+private:
+
+    enum STATE // Receiver state-machine
+    {
+        WAIT_FLG1    = 0,
+        WAIT_FLG2    = 1,
+        WAIT_BC      = 2,
+        WAIT_CTL     = 3,
+        WAIT_ADDR    = 4,
+        WAIT_DATA    = 5,
+        WAIT_CS      = 6
+        };
+
+    STATE state;
+    int CTL;   // Frame control
+    int ADDR;  // Frame address
+    int CS;    // Frame checksum
+
+    int data_len;
+    int data_p;
+    unsigned char data[ MAX_DATA ];
+
+    int sn_to_host;
+    int tx_cs; // Checksum of frame being sent
+
+public:
+
+    USB_Link( void )
+    {
+        state = WAIT_FLG1;
+        CTL = 0;
+        ADDR = 0;
+        CS = 0;
+        data_len = 0;
+        data_p = 0;
+        sn_to_host = 0;
+        tx_cs = 0;
+        }
+
+    int getType( void ) const
+    {
+        return CTL & FRM_CTL_MASK;
+        }
+
+    int getAddr( void ) const
+    {
+        return ADDR;
+        }
+
+    unsigned char* getData( void )
+    {
+        return data;
+        }
+
+    int getDataLen( void ) const
+    {
+        return data_len;
+        }
+
+    int OnReceivedOctet( int octet )
+    {
+        switch( state )
+        {
+            case WAIT_FLG1:
+                if ( octet != FRM_FLG1 )
+                    return RX_CONSOLE;
+                state = WAIT_FLG2;
+                break;
+
+            case WAIT_FLG2:
+                state = octet == FRM_FLG2 ? WAIT_BC : WAIT_FLG1;
+                break;
+
+            case WAIT_BC:
+                CS = octet;
+                if ( octet < 4 || octet > 4 + MAX_DATA )
+                {
+                    state = WAIT_FLG1;
+                    break;
+                    }
+                data_len = octet - 4;
+                data_p = 0;
+                state = WAIT_CTL;
+                break;
+
+            case WAIT_CTL:
+                CS += octet;
+                CTL = octet;
+                state = WAIT_ADDR;
+                break;
+
+            case WAIT_ADDR:
+                CS += octet;
+                ADDR = octet;
+                state = data_len == 0 ? WAIT_CS : WAIT_DATA;
+                break;
+
+            case WAIT_DATA:
+                CS += octet;
+                data[ data_p++ ] = octet;
+                if ( data_p >= data_len )
+                    state = WAIT_CS;
+                break;
+
+            case WAIT_CS:
+                state = WAIT_FLG1;
+                if ( ( ( CS - 1 ) & 0xFF ) == octet )
+                    return RX_FRAME;
+                break;
+            }
+
+        return RX_NONE;
+        }
+
+    // Sends frame header; len is the total data length, which has
+    // to be sent with PutData() before EndFrame().
+    //
+    void BeginFrame( int ctl, int addr, int len )
+    {
+        ++sn_to_host;
+
+        usb_Put( FRM_FLG1 );
+        usb_Put( FRM_FLG2 );
+
+        int BC = 4 + len;
+        usb_Put( BC );
+        tx_cs = BC;
+
+        int CTL = ( ( sn_to_host & FRM_SN_MASK ) << FRM_SN_SHIFT )
+                  | ( ctl & FRM_CTL_MASK );
+        usb_Put( CTL );
+        tx_cs += CTL;
+
+        usb_Put( addr );
+        tx_cs += addr;
+        }
+
+    void PutData( const unsigned char* buf, int len )
+    {
+        for ( int i = 0; i < len; i++ )
+        {
+            usb_Put( buf[ i ] );
+            tx_cs += buf[ i ];
+            }
+        }
+
+    void EndFrame( void )
+    {
+        usb_Put( ( tx_cs - 1 ) & 0xFF );
+        }
+
+    // Sends frame. Data may be given in two parts (e.g. header and payload).
+    //
+    void SendFrame( int ctl, int addr,
+        const unsigned char* buf = 0, int len = 0,
+        const unsigned char* buf2 = 0, int len2 = 0 )
+    {
+        BeginFrame( ctl, addr, len + len2 );
+        PutData( buf, len );
+        PutData( buf2, len2 );
+        EndFrame ();
+        }
+    };
+
+#endif // _USBLINK_H_INCLUDED
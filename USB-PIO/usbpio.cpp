@@ -14,6 +14,15 @@
 #include <stdarg.h>
 
 #include "xhfc.h"
+#include "usblink.h"
+#include "bstream.h"
+#include "dstream.h"
+#include "hostcmd.h"
+#include "trace.h"
+
+#ifdef XHFC_CLOCKMON
+#include "clockmon.h"
+#endif
 
 /*
     MCU:    ATMega16  (Signature 1E 94 03)
@@ -50,6 +59,7 @@
 
     HPI (Host Port Interface)
 
+      PA7   OUT                HPI CS# of 2nd XHFC (XHFC_MAX_CHIPS = 2)
       PA6   OUT                HPI CS#
       PA5   OUT                HPI RESET#
       PA4   OUT                HPI DS#
@@ -58,7 +68,7 @@
       PB0   OUT                HPI A1 (HCNTL0)
       PB1   OUT                HPI A2 (HCNTL1)
 
-      PB2   IN    INT2         HPI INT    (positive level interrupt)
+      PB2   IN    INT2         HPI INT    (XHFC INT# inverted, rising edge interrupt)
 */
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -80,6 +90,11 @@ void usb_Put( int ch )
     PORTC = 0x00;                             // Tri-state PC[0:7]
     }
 
+bool usb_TxReady( void )
+{
+    return ! ( PIND & _BV(PD3) );             // Return true if TXE# is asserted
+    }
+
 bool usb_RxAvailable( void )
 {
     return ! ( PIND & _BV(PD2) );             // Return true if RXF# is asserted
@@ -103,168 +118,170 @@ int usb_Get( void )
 
 void tracef( const char* format... )
 {
-    static const char hextab [] = "0123456789ABCDEF";
-
     va_list marker;
     va_start( marker, format ); // Initialize variable arguments.
 
+    trace.Put( format, marker );
 
-	while( *format )
-	{
-		if ( *format != '%' )
-		{
-			usb_Put( *format++ );
-			continue;
-			}
-
-		format++; // Advance to next character
-
-		if ( *format == '%' )
-		{
-			usb_Put( '%' );
-			}
-		else if ( *format == 'c' )
-		{
-			int c = va_arg( marker, int );
-			usb_Put( hextab[ ( c >>  4 ) & 0xF ] );
-			usb_Put( hextab[ ( c       ) & 0xF ] );
-			}
-		else if ( *format == 'a' )
-		{
-			unsigned char* c = va_arg( marker, unsigned char* );
-			int c_count = va_arg( marker, int );
-			for( ; c_count > 0; c_count--, c++ )
-			{
-				usb_Put( hextab[ ( *c >>  4 ) & 0xF ] );
-				usb_Put( hextab[ ( *c       ) & 0xF ] );
-				if ( c_count > 1 )
-					usb_Put( ' ' );
-				}
-			}
-		else if ( *format == 's' )
-		{
-			int x = va_arg( marker, int );
-			usb_Put( hextab[ ( x >> 12 ) & 0xF ] );
-			usb_Put( hextab[ ( x >>  8 ) & 0xF ] );
-			usb_Put( hextab[ ( x >>  4 ) & 0xF ] );
-			usb_Put( hextab[ ( x       ) & 0xF ] );
-			}
-		else if ( *format == 'l' )
-		{
-			long x = va_arg( marker, long );
-			usb_Put( hextab[ ( x >> 28 ) & 0xF ] );
-			usb_Put( hextab[ ( x >> 24 ) & 0xF ] );
-			usb_Put( hextab[ ( x >> 20 ) & 0xF ] );
-			usb_Put( hextab[ ( x >> 16 ) & 0xF ] );
-			usb_Put( hextab[ ( x >> 12 ) & 0xF ] );
-			usb_Put( hextab[ ( x >>  8 ) & 0xF ] );
-			usb_Put( hextab[ ( x >>  4 ) & 0xF ] );
-			usb_Put( hextab[ ( x       ) & 0xF ] );
-			}
-		else if ( *format == 's' )
-		{
-			const char* str = va_arg( marker, const char* );
-			while( *str )
-				usb_Put( *str++ );
-			}
-
-		format++; // Advance to next character
-		}
-
-	usb_Put( '\r' );
-	usb_Put( '\n' );
-
-   	va_end( marker ); // Reset variable arguments.
-	}
+    va_end( marker ); // Reset variable arguments.
+    }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+int XHFC_HW::addr_latch[ XHFC_MAX_CHIPS ]; // Invalidated by hfc.Initialize()
+
+#ifdef XHFC_BENCHMARK
+unsigned long XHFC_HW::addr_cycles = 0;
+unsigned long XHFC_HW::data_cycles = 0;
+#endif
+
 XHFC hfc;
+USB_Link usb_link;
+B_Stream bstream( usb_link );
+D_Stream dstream( usb_link );
+HostCommand hostcmd( usb_link );
+Trace trace( usb_link );
+
+#ifdef XHFC_BERT
+BER_Tester bert( usb_link );
+#endif
+
+#ifdef XHFC_CLOCKMON
+ClockMonitor clockmon( usb_link );
+
+SIGNAL( SIG_OVERFLOW2 ) // Timer2 overflow, every 17.8ms
+{
+    clockmon.OnOverflow ();
+    }
+#endif
+
+#ifdef XHFC_LAPD
+LAPD lapd[ XHFC_MAX_PORTS ];
+
+void D_TimerTick( int port, int ms )
+{
+    lapd[ port ].TimerTick( ms );
+    }
+#endif
 unsigned int sysTimer = 0;
 
 ///////////////////////////////////////////////////////////////////////////////
-
-void Fill_TX_Buffer( int ch )
+// XHFC interrupt
+//
+// The XHFC top half (hfc.InterruptHandler) runs from INT2 on rising edge of
+// PB2 (inverted INT#); it only collects the interrupt status bits and queues
+// the bottom half, which is run from the main loop. Out of interrupt context
+// INT2 is masked while the main loop touches the chip or state shared with
+// the top half; an edge seen meanwhile is latched in INTF2 and serviced
+// when INT2 is unmasked.
+//
+// Define XHFC_POLL to poll PB2 from the main loop instead (no INT2, no sleep).
+//
+#ifndef XHFC_POLL
+
+volatile unsigned char bh_pending = 0; // Bottom half queued by top half
+
+#ifdef XHFC_BENCHMARK
+unsigned int bench_irq_stamp;   // TCNT1 at top half that queued the bottom half
+unsigned long bench_isr = 0;    // Cycles spent in top half
+#endif
+
+SIGNAL( SIG_INTERRUPT2 ) // External Interrupt Request 2
 {
-    static int nibble_count = 0;
-    static int tx_octet = 0;
-    static int port_id = 0;
+#ifdef XHFC_BENCHMARK
+    unsigned int start = TCNT1;
+#endif
 
-    if ( ch == '\r' )
-    {
-        nibble_count = 0;
-        tx_octet = 0;
-        hfc.port[ port_id ].D_TX_Send ();
-        }
-    else if ( ch == 27 ) // escape
-    {
-        nibble_count = 0;
-        tx_octet = 0;
-        hfc.port[ port_id ].D_TX_Abort ();
-        }
-    else if ( ch == '?' ) // query
+    if ( hfc.InterruptHandler () )
     {
-        hfc.port[ port_id ].D_TX_Query ();
+#ifdef XHFC_BENCHMARK
+        if ( ! bh_pending )
+            bench_irq_stamp = start;
+#endif
+#ifdef XHFC_CLOCKMON
+        clockmon.Stamp ();
+#endif
+        bh_pending = 1;
         }
-    else if ( ch == 'x' ) // activate
-    {
-        nibble_count = 0;
-        tx_octet = 0;
-        hfc.port[ port_id ].PH_ActivateRequest ();
-        }
-    else if ( ch == 'y' ) // deactivate
-    {
-        nibble_count = 0;
-        tx_octet = 0;
-        hfc.port[ port_id ].PH_DeactivateRequest ();
-        }
-    else if ( ch >= '0' && ch <= '9' )
+
+#ifdef XHFC_BENCHMARK
+    bench_isr += TCNT1 - start;
+#endif
+    }
+
+// USB RXF# low level on INT0 wakes the main loop from sleep when the host
+// sends data, also if XHFC interrupts have stopped (no chip found, or F0
+// stalled, see XHFC::UpdateF0Count). INT0 is enabled only while sleeping,
+// as the level interrupt repeats until the FIFO is read.
+//
+SIGNAL( SIG_INTERRUPT0 ) // External Interrupt Request 0
+{
+    GICR &= ~_BV(INT0);
+    }
+
+inline void MaskXhfcIrq( void )
+{
+    GICR &= ~_BV(INT2);
+    }
+
+inline void UnmaskXhfcIrq( void )
+{
+    GICR |= _BV(INT2);
+    }
+
+#else
+
+inline void MaskXhfcIrq( void ) {}
+inline void UnmaskXhfcIrq( void ) {}
+
+#endif // XHFC_POLL
+
+///////////////////////////////////////////////////////////////////////////////
+
+void B_RX_Data( int chan, const unsigned char* data, int len, int discarded )
+{
+#ifdef XHFC_BERT
+    if ( bert.IsRunning( chan ) )
     {
-        tx_octet <<= 4; ++nibble_count;
-        tx_octet += ch - '0';
-        if ( nibble_count == 1 )
-        {
-            port_id = tx_octet & 0x01;
-            tx_octet = 0;
-            }
-        else if ( nibble_count & 1 )
-        {
-            hfc.port[ port_id ].D_TX_Append( tx_octet );
-            tx_octet = 0;
-            }
+        bert.OnRxData( chan, data, len, discarded );
+        return;
         }
-    else if ( ch >= 'a' && ch <= 'f' )
+#endif
+    bstream.OnRxData( chan, data, len, discarded );
+    }
+
+void B_TX_Data( int chan, unsigned char* data, int len )
+{
+#ifdef XHFC_BERT
+    if ( bert.IsRunning( chan ) )
     {
-        tx_octet <<= 4; ++nibble_count;
-        tx_octet += ch - 'a' + 10;
-        if ( nibble_count == 1 )
-        {
-            port_id = tx_octet & 0x01;
-            tx_octet = 0;
-            }
-        else if ( nibble_count & 1 )
-        {
-            hfc.port[ port_id ].D_TX_Append( tx_octet );
-            tx_octet = 0;
-            }
+        bert.OnTxData( chan, data, len );
+        return;
         }
-    else if ( ch >= 'A' && ch <= 'F' )
+#endif
+    bstream.OnTxData( chan, data, len );
+    }
+
+void OnFrameReceived( void )
+{
+    switch( usb_link.getType () )
     {
-        tx_octet <<= 4; ++nibble_count;
-        tx_octet += ch - 'A' + 10;
-        if ( nibble_count == 1 )
-        {
-            port_id = tx_octet & 0x01;
-            tx_octet = 0;
-            }
-        else if ( nibble_count & 1 )
-        {
-            hfc.port[ port_id ].D_TX_Append( tx_octet );
-            tx_octet = 0;
-            }
+        case USB_Link::FRM_CTL_AUDIO:
+            bstream.OnAudioFrame( usb_link.getAddr (), usb_link.getData (), usb_link.getDataLen () );
+            break;
+
+        case USB_Link::FRM_CTL_AUDIO_STATS_REQ:
+            bstream.SendStatistics ();
+            break;
+
+        case USB_Link::FRM_CTL_CMD:
+            hostcmd.OnCommand( usb_link.getAddr (), usb_link.getData (), usb_link.getDataLen () );
+            break;
         }
     }
 
+///////////////////////////////////////////////////////////////////////////////
+
 int
 main( void )
 {
@@ -295,35 +312,216 @@ main( void )
 
     // Hello world
     //
-    tracef( "\r\n\n\nXHFC Ready." );
+    tracef( "XHFC Ready." );
 
     // Get XHFC out of reset
     //
     PORTA |= _BV(PA5); // RESET# = 1
 
     hfc.Initialize( 0x01 );
-    hfc.port[ 0 ].Startup ();
-    hfc.port[ 1 ].Startup ();
+
+    for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+    {
+        hfc.port[ pt ].Startup ();
+
+#ifdef XHFC_LAPD
+        lapd[ pt ].Initialize( pt, usb_link );
+#endif
+        }
 
     PORTB &= ~_BV(PB3); // Trun off red LED
 
+#ifdef XHFC_CLOCKMON
+    clockmon.Start ();
+#endif
+
+#ifndef XHFC_POLL
+    // XHFC interrupt on rising edge of INT2. ISC2 may be changed only
+    // while INT2 is disabled, and changing it may set INTF2.
+    //
+    GICR &= ~_BV(INT2);
+    MCUCSR |= _BV(ISC2);
+    GIFR = _BV(INTF2);
+    GICR |= _BV(INT2);
+
+    // USB RXF# wakes from sleep on low level of INT0 (enabled only while
+    // sleeping)
+    //
+    MCUCR &= ~_BV(ISC01) & ~_BV(ISC00);
+
+    set_sleep_mode( SLEEP_MODE_IDLE );
+    sei ();
+#endif
+
+#ifdef XHFC_BENCHMARK
+    // XHFC service time is measured in CPU cycles with Timer1 running at
+    // clk/1 (overflows after 4.4ms, i.e. well above 1ms service period).
+    //
+    // Latency is the time from XHFC interrupt to start of the FIFO service:
+    // from INT2 top half, or when polling, from the last poll which found
+    // INT# deasserted (i.e. upper bound).
+    //
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    unsigned long bench_total = 0;  // Cycles spent in XHFC service
+    unsigned int bench_max = 0;     // Longest single service
+    unsigned int bench_lat = 0;     // Worst-case latency
+    unsigned long bench_addr = 0;   // Bus cycles at start of period
+    unsigned long bench_data = 0;
+#ifdef XHFC_POLL
+    unsigned int bench_irq_stamp = 0; // TCNT1 at last poll with INT# deasserted
+#endif
+#endif
+
     for ( ;; )
     {
-        if ( usb_RxAvailable () )
-            Fill_TX_Buffer( usb_Get () );
+        bool was_busy = false;
+
+        MaskXhfcIrq ();
+
+        // Audio from host arrives at up to 4 x 9 octets per ms, so take
+        // several octets per loop, but do not starve the XHFC.
+        //
+        for ( int i = 0; i < 16 && usb_RxAvailable (); i++ )
+        {
+            // Octets outside of frames are ignored
+            //
+            if ( usb_link.OnReceivedOctet( usb_Get () ) == USB_Link::RX_FRAME )
+                OnFrameReceived ();
+
+            was_busy = true;
+            }
+
+        // Deliver received D-Channel frames and B-Channel audio
+        //
+        dstream.Poll ();
+        bstream.Poll ();
+
+        // Send trace output when USB FIFO has room
+        //
+        if ( trace.Poll () )
+            was_busy = true;
+
+#ifdef XHFC_LAPD
+        for ( int pt = 0; pt < hfc.GetPortCount (); pt++ )
+            lapd[ pt ].Poll ();
+#endif
+
+#ifdef XHFC_CLOCKMON
+        // Runs at least every Timer2 overflow, also when XHFC is stalled
+        //
+        clockmon.Poll ();
+#endif
 
+#ifdef XHFC_POLL
         if ( ! hfc.IsIrqAsserted () ) // Poll interrupt pin
+        {
+#ifdef XHFC_BENCHMARK
+            bench_irq_stamp = TCNT1;
+#endif
             continue;
+            }
+
+        bool schedule_BH = hfc.InterruptHandler ();
+
+#ifdef XHFC_CLOCKMON
+        if ( schedule_BH )
+            clockmon.Stamp ();
+#endif
 
-        if ( ! hfc.InterruptHandler () )
+#ifdef XHFC_BENCHMARK
+        // INT# raised after the top half has read the status is serviced
+        // at next poll; count its latency from here.
+        //
+        unsigned int bench_th_end = TCNT1;
+#endif
+
+        if ( ! schedule_BH )
+        {
+#ifdef XHFC_BENCHMARK
+            bench_irq_stamp = bench_th_end;
+#endif
             continue;
+            }
+#else
+        // Edge triggered INT2 misses INT# raised again before the top half
+        // has returned, so check the pin as well.
+        //
+        if ( ! bh_pending && hfc.IsIrqAsserted () )
+        {
+#ifdef XHFC_BENCHMARK
+            unsigned int start = TCNT1;
+#endif
+            if ( hfc.InterruptHandler () )
+            {
+#ifdef XHFC_BENCHMARK
+                bench_irq_stamp = start;
+#endif
+#ifdef XHFC_CLOCKMON
+                clockmon.Stamp ();
+#endif
+                bh_pending = 1;
+                }
+            }
 
-        if ( ! hfc.BottomHalf_EH () )
+        if ( ! bh_pending )
+        {
+            // Sleep until next interrupt: XHFC timer interrupt (every
+            // 1..16ms, see OP_MODERATION) or USB RXF# on INT0. sei()
+            // enables interrupts only after the next instruction, so an
+            // interrupt between the test and sleep cannot be lost.
+            //
+            cli ();
+            UnmaskXhfcIrq ();
+            if ( ! was_busy && ! bh_pending )
+            {
+                GICR |= _BV(INT0);
+                MCUCR |= _BV(SE);
+                sei ();
+                _SLEEP ();
+                MCUCR &= ~_BV(SE);
+                GICR &= ~_BV(INT0);
+                }
+            sei ();
+            continue;
+            }
+
+        bh_pending = 0;
+#endif
+
+#ifdef XHFC_BENCHMARK
+        unsigned int bench_start = TCNT1;
+        unsigned int bench_latency = bench_start - bench_irq_stamp;
+        if ( bench_latency > bench_lat )
+            bench_lat = bench_latency;
+#ifdef XHFC_POLL
+        bench_irq_stamp = bench_th_end;
+#endif
+#endif
+
+        bool was_TimerIrq = hfc.BottomHalf_EH ();
+
+#ifdef XHFC_BENCHMARK
+        unsigned int bench_cycles = TCNT1 - bench_start;
+        bench_total += bench_cycles;
+        if ( bench_cycles > bench_max )
+            bench_max = bench_cycles;
+#endif
+
+#ifdef XHFC_CLOCKMON
+        if ( was_TimerIrq )
+            clockmon.OnTick ();
+#endif
+
+        UnmaskXhfcIrq ();
+
+        if ( ! was_TimerIrq )
             continue;
 
-        // We are here every 1ms
+        // We are here every timer tick (1ms by default)
         //
-        if ( ++ sysTimer < 1000 )
+        if ( ( sysTimer += hfc.GetTickMs () ) < 1000 )
             continue;
 
         sysTimer = 0;
@@ -332,7 +530,36 @@ main( void )
         //
         PORTD ^= _BV(PD4);
 
-        // tracef( "%l %l", hfc.GetIrqCount (), hfc.GetF0Count () );
+        MaskXhfcIrq ();
+        hfc.UpdateRates ();
+#ifdef XHFC_BERT
+        bert.SendRecords ();
+#endif
+        UnmaskXhfcIrq ();
+
+#ifdef XHFC_BENCHMARK
+        MaskXhfcIrq ();
+
+#ifndef XHFC_POLL
+        bench_total += bench_isr;
+        bench_isr = 0;
+#endif
+
+        // Average and max CPU cycles per 1ms tick, worst-case latency in
+        // CPU cycles, address and data register bus cycles per second
+        //
+        tracef( "Bench: avg %s max %s lat %s addr %l data %l",
+            int( bench_total / 1000 ), bench_max, bench_lat,
+            XHFC_HW::addr_cycles - bench_addr, XHFC_HW::data_cycles - bench_data );
+
+        bench_total = 0;
+        bench_max = 0;
+        bench_lat = 0;
+        bench_addr = XHFC_HW::addr_cycles;
+        bench_data = XHFC_HW::data_cycles;
+
+        UnmaskXhfcIrq ();
+#endif
         }
 
     return 0;
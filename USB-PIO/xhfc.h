@@ -6,34 +6,149 @@ extern "C"
     #include "mISDN/xhfc24succ.h"
 }
 
+//////////////////////////////////////////////////////////////////////////////////////
+// Board configuration
+//
+// Up to XHFC_MAX_CHIPS XHFC chips share data bus, control lines and INT#;
+// chip n is selected with CS# on PA(6 + n). XHFC_MAX_PORTS is the number of
+// S/U ports over all chips (max. 8, e.g. two XHFC-4SU), numbered in chip
+// order. Each port takes about 300 octets of RAM, so more than two ports
+// need a bigger MCU than ATmega16 (see Makefile).
+//
+#ifndef XHFC_MAX_CHIPS
+#define XHFC_MAX_CHIPS      1
+#endif
+
+#ifndef XHFC_MAX_PORTS
+#define XHFC_MAX_PORTS      2
+#endif
+
+#if XHFC_MAX_CHIPS > 2 || XHFC_MAX_PORTS > 8
+#error "At most 2 XHFC chips (CS# on PA6, PA7) and 8 S/U ports"
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////
 
 extern void tracef( const char* format... );
 extern void usb_Put( int ch );
 
+// B-Channel data hooks, called with channel = port * 2 + bc
+//
+extern void B_RX_Data( int chan, const unsigned char* data, int len, int discarded );
+extern void B_TX_Data( int chan, unsigned char* data, int len );
+
+#ifdef XHFC_LAPD
+// D-Channel timer tick hook (LAPD timers), ms = tick interval
+//
+extern void D_TimerTick( int port, int ms );
+#endif
+
+#ifdef XHFC_SIM
+// Host build: bus cycles go to the register model (see host/xhfcsim.h),
+// addr_reg selects the address register (A0 = 1)
+//
+extern int  XHFC_SimRead( int chip, bool addr_reg );
+extern void XHFC_SimWrite( int chip, bool addr_reg, int value );
+extern bool XHFC_SimIrq( void );
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////
 // XHFC Controller Low Level I/O
 //
+// The XHFC address register keeps its value between accesses, so it is
+// shadowed in addr_latch and the address cycle is skipped when the
+// register is already latched. addr_latch is kept per chip and shared by
+// all XHFC_HW instances (controller and ports) accessing that chip.
+//
+// Define XHFC_NO_ADDR_CACHE to always write the address register and to
+// access FIFO data octet by octet instead of in bursts, and XHFC_BENCHMARK
+// to count bus cycles (see main loop). XHFC_SIM replaces the port I/O with
+// calls to a register model for host builds.
+//
 class XHFC_HW
 {
+#ifndef XHFC_SIM
     enum
     {
-        NCS    = _BV(PA6),
+        NCS0   = _BV(PA6),      // CS# of chip 0
         NRESET = _BV(PA5),
         NDS    = _BV(PA4),
         R_NW   = _BV(PA3),
         A0     = _BV(PA2)
         };
+#endif
 
     // void* mem_base;
 
+protected:
+
+    static int addr_latch[ XHFC_MAX_CHIPS ]; // Latched address register, -1 if unknown
+
+    int chip;                       // Chip accessed by this instance
+
+    void SetChip( int c )
+    {
+        chip = c;
+        }
+
+#ifndef XHFC_SIM
+    // CS# of the accessed chip; constant in single chip builds
+    //
+    unsigned char ChipSelect( void ) const
+    {
+        return XHFC_MAX_CHIPS > 1 ? NCS0 << chip : NCS0;
+        }
+#endif
+
+    int& AddrLatch( void )
+    {
+        return addr_latch[ XHFC_MAX_CHIPS > 1 ? chip : 0 ];
+        }
+
 public:
 
+#ifdef XHFC_BENCHMARK
+    static unsigned long addr_cycles; // Address register write cycles
+    static unsigned long data_cycles; // Data register cycles
+    #define XHFC_COUNT_CYCLES( counter, n ) ( counter += (n) )
+#else
+    #define XHFC_COUNT_CYCLES( counter, n )
+#endif
+
+#ifdef XHFC_SIM
+    bool IsIrqAsserted( void ) const
+    {
+        return XHFC_SimIrq ();
+        }
+#else
     bool IsIrqAsserted( void ) const
     {
         return PINB & _BV(PB2);      // PB2 is inverted INT#
         }
+#endif
+
+    // Forget latched address, e.g. after chip reset
+    //
+    void InvalidateAddrReg( void )
+    {
+        AddrLatch () = -1;
+        }
 
+#ifdef XHFC_SIM
+    int ReadAddrReg( void )
+    {
+        int data = XHFC_SimRead( chip, true );
+        AddrLatch () = data;
+        return data;
+        }
+
+    void WriteAddrReg( int value )
+    {
+        XHFC_SimWrite( chip, true, value & 0xFF );
+        AddrLatch () = value & 0xFF;
+        XHFC_COUNT_CYCLES( addr_cycles, 1 );
+        }
+#else
     // NOTE: Following values have to be kept between low level IO calls: 
     //
     //    CS# = 1, DS# = 1, R/W# = 1
@@ -41,6 +156,8 @@ public:
 
     int ReadAddrReg( void )
     {
+        const unsigned char NCS = ChipSelect ();
+
         PORTA |= A0;                 // A0 = 1 (addr register access)
         PORTA &= ~NCS & ~NDS;        // CS# = 0, DS# = 0
 
@@ -49,11 +166,15 @@ public:
 
         PORTA |= NDS | NCS;          // DS# = 1, CS# = 1
 
+        AddrLatch () = data;
+
         return data;
         }
 
     void WriteAddrReg( int value )
     {
+        const unsigned char NCS = ChipSelect ();
+
         PORTA |= A0;                // A0 = 1 (addr register access)
         PORTA &= ~NCS & ~R_NW;      // CS# = 0, R/W# = 0
 
@@ -68,59 +189,183 @@ public:
         PORTC = 0x00;               // Tri-state PC[0:7]
 
         PORTA |= NCS | R_NW;        // CS# = 1, R/W# = 1
+
+        AddrLatch () = value & 0xFF;
+        XHFC_COUNT_CYCLES( addr_cycles, 1 );
         }
+#endif
 
+    void SelectAddr( int addr )
+    {
+#ifndef XHFC_NO_ADDR_CACHE
+        if ( addr == AddrLatch () )
+            return;
+#endif
+        WriteAddrReg( addr );
+        }
+
+#ifdef XHFC_SIM
     int Read( int addr )
     {
-        PORTA |= A0;                // A0 = 1 (addr register access)
-        PORTA &= ~NCS & ~R_NW;      // CS# = 0, R/W# = 0
+        SelectAddr( addr );
+        XHFC_COUNT_CYCLES( data_cycles, 1 );
+        return XHFC_SimRead( chip, false );
+        }
 
-        DDRC = 0xFF;                // PC[0:7] as output
-        PORTC = addr & 0xFF;        // Set data on PC[0:7]
+    void Write( int addr, int value )
+    {
+        SelectAddr( addr );
+        XHFC_SimWrite( chip, false, value & 0xFF );
+        XHFC_COUNT_CYCLES( data_cycles, 1 );
+        }
 
-        PORTA &= ~NDS;              // DS# = 0
-        _NOP ();                    // Wait
-        PORTA |= NDS;               // DS# = 1
+#ifndef XHFC_NO_ADDR_CACHE
+    void ReadBurst( int addr, unsigned char* buf, int len )
+    {
+        SelectAddr( addr );
+        XHFC_COUNT_CYCLES( data_cycles, len );
 
-        DDRC = 0x00;                // PC[0:7] as input
-        PORTC = 0x00;               // Tri-state PC[0:7]
+        for ( ; len > 0; len-- )
+        {
+            unsigned char data = XHFC_SimRead( chip, false );
+            if ( buf )
+                *buf++ = data;
+            }
+        }
+
+    void WriteBurst( int addr, const unsigned char* buf, int len )
+    {
+        SelectAddr( addr );
+        XHFC_COUNT_CYCLES( data_cycles, len );
+
+        for ( ; len > 0; len-- )
+            XHFC_SimWrite( chip, false, *buf++ );
+        }
+#endif
+#else
+    int Read( int addr )
+    {
+        const unsigned char NCS = ChipSelect ();
+
+        SelectAddr( addr );
 
-        PORTA |= R_NW;              // R/W# = 1
         PORTA &= ~A0;               // A0 = 0 (data register access)
-        PORTA &= ~NDS;              // DS# = 0
+        PORTA &= ~NCS & ~NDS;       // CS# = 0, DS# = 0
 
         _NOP ();                    // Wait
         unsigned char data = PINC;  // Read octet from PC[0:7]
 
         PORTA |= NDS | NCS;         // DS# = 1, CS# = 1
 
+        XHFC_COUNT_CYCLES( data_cycles, 1 );
+
         return data;
         }
 
     void Write( int addr, int value )
     {
-        PORTA |= A0;                // A0 = 1 (addr register access)
+        const unsigned char NCS = ChipSelect ();
+
+        SelectAddr( addr );
+
+        PORTA &= ~A0;               // A0 = 0 (data register access)
         PORTA &= ~NCS & ~R_NW;      // CS# = 0, R/W# = 0
 
         DDRC = 0xFF;                // PC[0:7] as output
-        PORTC = addr & 0xFF;        // Set data on PC[0:7]
+        PORTC = value & 0xFF;       // Set data on PC[0:7]
 
         PORTA &= ~NDS;              // DS# = 0
         _NOP ();                    // Wait
         PORTA |= NDS;               // DS# = 1
 
+        DDRC = 0x00;                // PC[0:7] as input
+        PORTC = 0x00;               // Tri-state PC[0:7]
+
+        PORTA |= NCS | R_NW;        // CS# = 1, R/W# = 1
+
+        XHFC_COUNT_CYCLES( data_cycles, 1 );
+        }
+
+#ifndef XHFC_NO_ADDR_CACHE
+    // Reads len octets from the same register (e.g. A_FIFO_DATA) keeping
+    // CS# asserted. Octets are discarded if buf is NULL.
+    //
+    void ReadBurst( int addr, unsigned char* buf, int len )
+    {
+        const unsigned char NCS = ChipSelect ();
+
+        SelectAddr( addr );
+
         PORTA &= ~A0;               // A0 = 0 (data register access)
-        PORTC = value & 0xFF;       // Set data on PC[0:7]
+        PORTA &= ~NCS;              // CS# = 0
 
-        PORTA &= ~NDS;              // DS# = 0
-        _NOP ();                    // Wait
-        PORTA |= NDS;               // DS# = 1
+        XHFC_COUNT_CYCLES( data_cycles, len );
+
+        for ( ; len > 0; len-- )
+        {
+            PORTA &= ~NDS;          // DS# = 0
+            _NOP ();                // Wait
+            unsigned char data = PINC; // Read octet from PC[0:7]
+            PORTA |= NDS;           // DS# = 1
+
+            if ( buf )
+                *buf++ = data;
+            }
+
+        PORTA |= NCS;               // CS# = 1
+        }
+
+    // Writes len octets to the same register (e.g. A_FIFO_DATA) keeping
+    // CS# asserted and data bus driven.
+    //
+    void WriteBurst( int addr, const unsigned char* buf, int len )
+    {
+        const unsigned char NCS = ChipSelect ();
+
+        SelectAddr( addr );
+
+        PORTA &= ~A0;               // A0 = 0 (data register access)
+        PORTA &= ~NCS & ~R_NW;      // CS# = 0, R/W# = 0
+
+        DDRC = 0xFF;                // PC[0:7] as output
+
+        XHFC_COUNT_CYCLES( data_cycles, len );
+
+        for ( ; len > 0; len-- )
+        {
+            PORTC = *buf++;         // Set data on PC[0:7]
+            PORTA &= ~NDS;          // DS# = 0
+            _NOP ();                // Wait
+            PORTA |= NDS;           // DS# = 1
+            }
 
         DDRC = 0x00;                // PC[0:7] as input
         PORTC = 0x00;               // Tri-state PC[0:7]
 
         PORTA |= NCS | R_NW;        // CS# = 1, R/W# = 1
         }
+#endif
+#endif
+
+#ifdef XHFC_NO_ADDR_CACHE
+    // Benchmark reference: one address and one data cycle per octet
+    //
+    void ReadBurst( int addr, unsigned char* buf, int len )
+    {
+        for ( ; len > 0; len-- )
+        {
+            unsigned char data = Read( addr );
+            if ( buf )
+                *buf++ = data;
+            }
+        }
+
+    void WriteBurst( int addr, const unsigned char* buf, int len )
+    {
+        for ( ; len > 0; len-- )
+            Write( addr, *buf++ );
+        }
+#endif
 
     int ReadIndirect( int addr )
     {
@@ -128,25 +373,567 @@ public:
         return Read( R_INT_DATA );  // Read the target register value
         }
 
-    void SelectFIFO( int fifo )
+    void SelectFIFO( int fifo )
+    {
+        Write( R_FIFO, fifo );
+        do ; while( Read( R_STATUS ) & M_BUSY );
+        }
+
+    void ResetFIFO( void )
+    {
+        Write( A_INC_RES_FIFO, M_RES_FIFO | M_RES_FIFO_ERR );
+        do ; while( Read( R_STATUS ) & M_BUSY );
+        }
+
+    void IncF( void )
+    {
+        Write( A_INC_RES_FIFO, M_INC_F );
+        do ; while( Read( R_STATUS ) & M_BUSY );
+        }
+    };
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Adaptive jitter buffer for transparent B-Channel FIFOs
+//
+// Tracks the FIFO fill level at every 1ms service. The level is normalized
+// with the F0 counter (one F0 pulse per sample), so that a late or early
+// service is not mistaken for drift, and then smoothed. When the smoothed
+// level stays off the target, one sample is inserted or deleted, but at
+// most once every HOLDOFF services, so drift between the S/U line clock
+// and the local clock is absorbed in inaudible single-sample slips.
+//
+class JitterBuffer
+{
+    enum // instead of #defines
+    {
+        CHUNK        = 8,   // Samples moved per service (= B_CH_BUFSIZE)
+        LEVEL_SHIFT  = 4,   // Level is kept in 1/16 samples
+        SMOOTH_SHIFT = 3,   // Smoothing: level += ( fill - level ) / 8
+        HYSTERESIS   = 2,   // Allowed deviation from target (in samples)
+        HOLDOFF      = 8    // Min services between two slips
+        };
+
+    unsigned short f0_last;     // F0 counter at previous service
+    short level;                // Smoothed fill level
+    unsigned char holdoff;
+
+public:
+
+    unsigned short inserted;    // Samples inserted (repeated)
+    unsigned short deleted;     // Samples deleted (skipped)
+
+    JitterBuffer( void )
+    {
+        Reset( 0, 0 );
+        inserted = 0;
+        deleted = 0;
+        }
+
+    void Reset( int target, unsigned short f0 )
+    {
+        f0_last = f0;
+        level = target << LEVEL_SHIFT;
+        holdoff = HOLDOFF;
+        }
+
+    int GetLevel( void ) const
+    {
+        return level >> LEVEL_SHIFT;
+        }
+
+    // Returns > 0 if one sample should be removed from the stream,
+    // < 0 if one sample should be added, and 0 if none.
+    // RX FIFOs fill (rx = true) and TX FIFOs drain with F0.
+    //
+    int Update( int fill, unsigned short f0, int target, bool rx )
+    {
+        int late = int( f0 - f0_last ) - CHUNK; // in samples
+        f0_last = f0;
+
+        if ( late > CHUNK )
+            late = CHUNK;
+        else if ( late < -CHUNK )
+            late = -CHUNK;
+
+        fill += rx ? -late : late;
+
+        level += ( ( fill << LEVEL_SHIFT ) - level ) >> SMOOTH_SHIFT;
+
+        if ( holdoff )
+        {
+            --holdoff;
+            return 0;
+            }
+
+        if ( level > ( ( target + HYSTERESIS ) << LEVEL_SHIFT ) )
+        {
+            holdoff = HOLDOFF;
+            return 1;
+            }
+
+        if ( level < ( ( target - HYSTERESIS ) << LEVEL_SHIFT ) )
+        {
+            holdoff = HOLDOFF;
+            return -1;
+            }
+
+        return 0;
+        }
+    };
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Ring of HDLC frames
+//
+// Frames are stored back to back, each one preceded by its length octet.
+// A frame is built with Put() after the last committed frame and becomes
+// visible to the reader only on Commit(). A frame that does not fit is
+// dropped as a whole, so frames already queued are never corrupted.
+//
+class FrameRing
+{
+public:
+
+    enum // instead of #defines
+    {
+        SIZE         = 80,  // Ring size in octets (including length octets)
+        MAX_LEN      = 64   // Max frame length
+        };
+
+private:
+
+    unsigned char buf[ SIZE ];
+    unsigned char head;     // Length octet position of the frame being built
+    unsigned char tail;     // Length octet position of the oldest frame
+    unsigned char fill;     // Octets used by committed frames
+    unsigned char frames;   // Committed frames
+    unsigned char plen;     // Length of the frame being built
+    bool overflow;          // Frame being built did not fit
+
+    static int Index( int pos, int offset )
+    {
+        pos += offset;
+        return pos >= SIZE ? pos - SIZE : pos;
+        }
+
+    // Contiguous octets of a frame from offset on
+    //
+    int Chunk( int pos, int len, int offset, const unsigned char*& p ) const
+    {
+        int start = Index( pos, 1 + offset );
+        int n = len - offset;
+
+        if ( start + n > SIZE )
+            n = SIZE - start;
+
+        p = buf + start;
+        return n;
+        }
+
+public:
+
+    unsigned short dropped; // Frames dropped because of full ring
+
+    FrameRing( void )
+    {
+        Reset ();
+        }
+
+    void Reset( void )
+    {
+        head = tail = 0;
+        fill = frames = plen = 0;
+        overflow = false;
+        dropped = 0;
+        }
+
+    bool IsEmpty( void ) const
+    {
+        return frames == 0;
+        }
+
+    int GetCount( void ) const
+    {
+        return frames;
+        }
+
+    // Room for the data of a new frame
+    //
+    int GetFree( void ) const
+    {
+        int n = SIZE - 1 - fill;
+        return n > MAX_LEN ? MAX_LEN : n;
+        }
+
+    // Writer side
+
+    int GetPendingLen( void ) const
+    {
+        return plen;
+        }
+
+    int GetPendingChunk( int offset, const unsigned char*& p ) const
+    {
+        return Chunk( head, plen, offset, p );
+        }
+
+    // Contiguous room after the frame being built, to be filled directly
+    // (e.g. by FIFO burst read) and then accounted with Advance().
+    //
+    int GetPutChunk( unsigned char*& p )
+    {
+        int start = Index( head, 1 + plen );
+        int n = overflow ? 0 : SIZE - 1 - fill - plen;
+
+        if ( n > MAX_LEN - plen )
+            n = MAX_LEN - plen;
+        if ( start + n > SIZE )
+            n = SIZE - start;
+
+        p = buf + start;
+        return n;
+        }
+
+    void Advance( int n )
+    {
+        plen += n;
+        }
+
+    void SetOverflow( void )
+    {
+        overflow = true;
+        }
+
+    bool Put( int octet )
+    {
+        if ( overflow || plen >= MAX_LEN || fill + 1 + plen >= SIZE )
+        {
+            overflow = true;
+            return false;
+            }
+
+        buf[ Index( head, 1 + plen ) ] = octet;
+        ++plen;
+        return true;
+        }
+
+    bool Put( const unsigned char* data, int len )
+    {
+        while ( len-- > 0 )
+        {
+            if ( ! Put( *data++ ) )
+                return false;
+            }
+
+        return true;
+        }
+
+    // Makes frame being built visible to the reader. Returns false
+    // if frame was empty or did not fit (it is dropped then).
+    //
+    bool Commit( void )
+    {
+        if ( overflow || plen == 0 )
+        {
+            if ( overflow )
+                ++dropped;
+            Discard ();
+            return false;
+            }
+
+        buf[ head ] = plen;
+        head = Index( head, 1 + plen );
+        fill += 1 + plen;
+        ++frames;
+        plen = 0;
+        return true;
+        }
+
+    void Discard( void )
+    {
+        plen = 0;
+        overflow = false;
+        }
+
+    // Reader side
+
+    int GetLen( void ) const
+    {
+        return buf[ tail ];
+        }
+
+    int GetChunk( int offset, const unsigned char*& p ) const
+    {
+        return Chunk( tail, buf[ tail ], offset, p );
+        }
+
+    // Random access to committed frames: position of the n-th oldest one
+    //
+    int Seek( int n ) const
+    {
+        int pos = tail;
+
+        while ( n-- > 0 )
+            pos = Index( pos, 1 + buf[ pos ] );
+
+        return pos;
+        }
+
+    int GetLenAt( int pos ) const
+    {
+        return buf[ pos ];
+        }
+
+    int GetChunkAt( int pos, int offset, const unsigned char*& p ) const
+    {
+        return Chunk( pos, buf[ pos ], offset, p );
+        }
+
+    void Pop( void )
+    {
+        if ( ! frames )
+            return;
+
+        int len = 1 + buf[ tail ];
+        tail = Index( tail, len );
+        fill -= len;
+        --frames;
+        }
+    };
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Frame buffers and statistics of a FIFO pair in HDLC mode: the D-Channel,
+// and B-Channels switched to HDLC mode (XHFC_B_HDLC builds)
+//
+class HDLC_Channel
+{
+public:
+
+    FrameRing rx_ring;          // Received frames: data, FCS (2 octets), STAT
+    FrameRing tx_ring;          // Frames to transmit
+    int tx_indx;                // Octets of oldest frame already in TX FIFO
+
+    // Transmit statistics
+    //
+    unsigned short tx_sent;     // Frames written to TX FIFO
+    unsigned short tx_underrun; // Frames restarted after TX FIFO underrun
+
+    // Receive statistics
+    //
+    unsigned short rx_frames;   // Frames queued for delivery
+    unsigned short rx_crc_error; // Frames with CRC error (queued, too)
+    unsigned short rx_invalid;  // Aborted or too short frames
+    unsigned short rx_overrun;  // RX FIFO overflows
+
+    void Reset( void )
+    {
+        rx_ring.Reset ();
+        tx_ring.Reset ();
+        tx_indx         = 0;
+        tx_sent         = 0;
+        tx_underrun     = 0;
+        rx_frames       = 0;
+        rx_crc_error    = 0;
+        rx_invalid      = 0;
+        rx_overrun      = 0;
+        }
+    };
+
+//////////////////////////////////////////////////////////////////////////////////////
+// L1 event log of a port (XHFC_L1_LOG builds)
+//
+// Keeps the last MAX_EVENTS state transitions, timer expiries and PH
+// primitives with their time, and counters over all activations since
+// startup or Clear(). Time is in ms since startup, advanced by the timer
+// ticks of the port, so its resolution is the XHFC timer interval.
+//
+// An activation starts with PH_ActivateRequest, NT state G2 or TE states
+// F4 .. F6; it ends successfully with PH_ACTIVATE (activation time goes
+// into hist[]) or fails with PH_DEACTIVATE, T3 expiry or TE state F3.
+//
+class L1_Log
+{
+public:
+
+    enum // Event codes
+    {
+        EV_STATE          = 0x00, // | new L1 state
+        EV_T1             = 0x10, // Timer expired
+        EV_T3             = 0x11,
+        EV_T4             = 0x12,
+        EV_ACTIVATE_REQ   = 0x20, // PH_ACTIVATE | REQUEST
+        EV_DEACTIVATE_REQ = 0x21, // PH_DEACTIVATE | REQUEST
+        EV_ACTIVATED      = 0x22, // PH_ACTIVATE | INDICATION or CONFIRM
+        EV_DEACTIVATED    = 0x23  // PH_DEACTIVATE | INDICATION
+        };
+
+    enum // instead of #defines
+    {
+        MAX_EVENTS        = 8,
+        HIST_BUCKETS      = 8     // Activation time < 16, 32, .. 1024, >= 1024 ms
+        };
+
+    struct Event
+    {
+        unsigned long time;     // ms since startup
+        unsigned char code;     // EV_*
+        };
+
+private:
+
+    Event event[ MAX_EVENTS ];
+    unsigned char head;         // Oldest event
+    unsigned char count;        // Events in log
+
+    unsigned long now;          // ms since startup
+    unsigned long act_start;    // Time activation has started
+    bool activating;
+
+    void ActivationEnd( bool ok )
+    {
+        if ( ! activating )
+            return;
+
+        activating = false;
+
+        if ( ! ok )
+        {
+            ++failed;
+            return;
+            }
+
+        unsigned long ms = now - act_start;
+
+        if ( ms > max_act_ms )
+            max_act_ms = ms > 0xFFFF ? 0xFFFF : ms;
+
+        int b = 0;
+        for ( unsigned long t = ms >> 4; t && b < HIST_BUCKETS - 1; t >>= 1 )
+            ++b;
+
+        ++hist[ b ];
+        }
+
+public:
+
+    // Counters; cleared by Clear()
+    //
+    unsigned short dropped;     // Events overwritten before read
+    unsigned short failed;      // Failed activations
+    unsigned short max_act_ms;  // Longest successful activation
+    unsigned short t1_expired;
+    unsigned short t3_expired;
+    unsigned short t4_expired;
+    unsigned short lost_framing; // TE state F8 entered
+    unsigned short hist[ HIST_BUCKETS ]; // Successful activations by time
+
+    void Reset( void )
+    {
+        head = count = 0;
+        now = act_start = 0;
+        activating = false;
+        Clear ();
+        }
+
+    void Clear( void )
+    {
+        dropped = failed = max_act_ms = 0;
+        t1_expired = t3_expired = t4_expired = lost_framing = 0;
+        memset( hist, 0, sizeof( hist ) );
+        }
+
+    void Tick( int ms )
+    {
+        now += ms;
+        }
+
+    void Log( int code )
+    {
+        if ( count == MAX_EVENTS )
+        {
+            head = ( head + 1 ) % MAX_EVENTS;
+            --count;
+            ++dropped;
+            }
+
+        Event& ev = event[ ( head + count ) % MAX_EVENTS ];
+        ev.time = now;
+        ev.code = code;
+        ++count;
+        }
+
+    // Removes oldest event; false if log is empty
+    //
+    bool Get( Event& ev )
+    {
+        if ( ! count )
+            return false;
+
+        ev = event[ head ];
+        head = ( head + 1 ) % MAX_EVENTS;
+        --count;
+        return true;
+        }
+
+    int GetCount( void ) const
+    {
+        return count;
+        }
+
+    void ActivationStart( void )
+    {
+        if ( activating )
+            return;
+
+        activating = true;
+        act_start = now;
+        }
+
+    void Activated( void )
+    {
+        Log( EV_ACTIVATED );
+        ActivationEnd( true );
+        }
+
+    void Deactivated( void )
+    {
+        Log( EV_DEACTIVATED );
+        ActivationEnd( false );
+        }
+
+    void ActivationFailed( void )
+    {
+        ActivationEnd( false );
+        }
+
+    void StateChanged( int state )
     {
-        Write( R_FIFO, fifo );
-        do ; while( Read( R_STATUS ) & M_BUSY );
+        Log( EV_STATE | state );
         }
 
-    void ResetFIFO( void )
+    void LostFraming( void )
     {
-        Write( A_INC_RES_FIFO, M_RES_FIFO | M_RES_FIFO_ERR );
-        do ; while( Read( R_STATUS ) & M_BUSY );
+        ++lost_framing;
         }
 
-    void IncF( void )
+    void TimerExpired( int code )
     {
-        Write( A_INC_RES_FIFO, M_INC_F );
-        do ; while( Read( R_STATUS ) & M_BUSY );
+        Log( code );
+
+        if ( code == EV_T1 )
+            ++t1_expired;
+        else if ( code == EV_T3 )
+            ++t3_expired;
+        else
+            ++t4_expired;
         }
     };
 
+#ifdef XHFC_L1_LOG
+    #define XHFC_L1_EVENT( ev ) ( l1_log.ev )
+#else
+    #define XHFC_L1_EVENT( ev ) ( (void)0 )
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////
 // XHFC S/U Port
 //
@@ -155,7 +942,9 @@ class XHFC_Port : XHFC_HW
     enum // instead of #defines
     {
         B_CH_BUFSIZE                =      8, // B-Channel buffer size
-        MAX_DFRAME_LEN_L1           =     64, // D-Channel buffer size
+        B_RX_TARGET                 =     20, // RX FIFO level at service (irq at > 16)
+        B_TX_TARGET                 =     16, // TX FIFO level at service
+        B_MAX_EXCESS                =     16, // Bulk drop when RX level exceeds target by
 
         // L1 States as in I.430
         //  
@@ -225,12 +1014,12 @@ class XHFC_Port : XHFC_HW
             counter = -1;
             }
 
-        bool DecAndTestExpired( void )
+        bool DecAndTestExpired( int ms )
         {
             if ( counter == -1 ) // Timer is stopped
                 return false;
         
-            if ( --counter > 0 ) // Timer is still running
+            if ( ( counter -= ms ) > 0 ) // Timer is still running
                 return false;
 
             // Timer expired
@@ -241,7 +1030,8 @@ class XHFC_Port : XHFC_HW
 
     //////////////////////////////////////////////////////////////////////////////////
 
-    int ID;                     // Port ID
+    int ID;                     // Port ID (S/U interface of the chip)
+    int PN;                     // Port number (index in XHFC::port[])
     int max_Z;                  // FIFO depth (= 2^N) minus one
 
     struct
@@ -268,16 +1058,20 @@ class XHFC_Port : XHFC_HW
     unsigned char brx_buf[ 2 ][ B_CH_BUFSIZE ];
     unsigned char btx_buf[ 2 ][ B_CH_BUFSIZE ];
 
+    JitterBuffer brx_jb[ 2 ];
+    JitterBuffer btx_jb[ 2 ];
+    unsigned short f0_now; // F0 counter at current service
+
     // D-Channel related buffers
     //
-    unsigned char drx_buf[ MAX_DFRAME_LEN_L1 ];
-    int drx_indx;
-    int bytes2receive;
+    HDLC_Channel dch;
 
-    unsigned char dtx_buf[ MAX_DFRAME_LEN_L1 ];  
-    int dtx_indx;
-    int dtx_append_indx;
-    int bytes2transmit;
+#ifdef XHFC_B_HDLC
+    // B-Channels in HDLC mode
+    //
+    HDLC_Channel bch[ 2 ];
+    int b_hdlc;                 // Bit bc set if B-Channel FIFOs are in HDLC mode
+#endif
 
     // Layer 1 state & timers
     //
@@ -286,15 +1080,25 @@ class XHFC_Port : XHFC_HW
     Timer T4;
     Timer T1;
 
+#ifdef XHFC_L1_LOG
+    L1_Log l1_log;
+#endif
+
     //////////////////////////////////////////////////////////////////////////////////
 
 private:
 
     // Setup FIFO using A_CON_HDLC, A_SUBCH_CFG, A_FIFO_CTRL
-    // FIFO number is given always relative to port.
+    // FIFO number is given always relative to port, as are the bits of
+    // the port's FIFO block interrupt registers.
     //
     void SetupFIFO( int fifo, int conhdlc, int subcfg, int fifoctrl, bool enable = true )
     {
+        if ( enable )
+            fifo_irqmsk |= ( 1 << fifo );
+        else
+            fifo_irqmsk &= ~( 1 << fifo );
+
         fifo += ( ID << 3 );
 
         SelectFIFO( fifo );
@@ -302,11 +1106,6 @@ private:
         Write( A_SUBCH_CFG, subcfg );
         Write( A_FIFO_CTRL, fifoctrl );
 
-        if ( enable )
-            fifo_irqmsk |= ( 1 << fifo );
-        else
-            fifo_irqmsk &= ~( 1 << fifo );
-
         ResetFIFO ();
         SelectFIFO( fifo );
 #if 0
@@ -330,10 +1129,12 @@ private:
                     mode.IsActivated = false;
                     T1.Stop ();
                     // L1->L2: PH_DEACTIVATE | INDICATION
-                    tracef( "%c L1->L2: D|I", ID );
+                    tracef( "%c L1->L2: D|I", PN );
+                    XHFC_L1_EVENT( Deactivated () );
                     break;
 
                 case NT_STA_PENDING_ACTIVATION: // G2
+                    XHFC_L1_EVENT( ActivationStart () );
                     T1.Restart( TIMER_T1 );
                     Write( R_SU_SEL, ID );
                     Write( A_SU_WR_STA, M_SU_SET_G2_G3 );
@@ -343,7 +1144,8 @@ private:
                     mode.IsActivated = true;
                     T1.Stop ();
                     // L1->L2: PH_ACTIVATE | INDICATION
-                    tracef( "%c L1->L2: A|I", ID );
+                    tracef( "%c L1->L2: A|I", PN );
+                    XHFC_L1_EVENT( Activated () );
                     break;
 
                 case NT_STA_PENDING_DEACTIVATION: // G4
@@ -359,6 +1161,11 @@ private:
                 T3.Stop ();
                 }
 
+            if ( L1_state <= TE_STA_DEACTIVATED )
+                XHFC_L1_EVENT( ActivationFailed () );
+            else if ( L1_state < TE_STA_ACTIVATED && ! mode.IsActivated )
+                XHFC_L1_EVENT( ActivationStart () );
+
             switch ( L1_state ) 
             {
                 case TE_STA_DEACTIVATED: // F3
@@ -377,7 +1184,8 @@ private:
                         mode.IsActivating = false;
                         mode.IsActivated = true;
                         // L1->L2: PH_ACTIVATE | CONFIRM
-                        tracef( "%c L1->L2: A|C", ID );
+                        tracef( "%c L1->L2: A|C", PN );
+                        XHFC_L1_EVENT( Activated () );
                         } 
                     else 
                     {
@@ -385,7 +1193,8 @@ private:
                         {
                             mode.IsActivated = true;
                             // L1->L2: PH_ACTIVATE | INDICATION
-                            tracef( "%c L1->L2: A|I", ID );
+                            tracef( "%c L1->L2: A|I", PN );
+                            XHFC_L1_EVENT( Activated () );
                             }
                         else
                         {
@@ -396,6 +1205,7 @@ private:
 
                 case TE_STA_LOST_FRAMING: // F8
                     T4.Stop ();
+                    XHFC_L1_EVENT( LostFraming () );
                     break;
                 }
             }
@@ -408,36 +1218,65 @@ private:
         SelectFIFO( ID * 8 + bc * 2 + 1 + M_REV );
         int rcnt = Read( A_USAGE ) - 1;
 
-        if ( rcnt < B_CH_BUFSIZE ) 
+        unsigned char* buf = brx_buf[ bc ];
+        JitterBuffer& jb = brx_jb[ bc ];
+
+        if ( rcnt < B_CH_BUFSIZE - 1 ) 
         {
-            // Not enough data in FIFO
+            // Not enough data in FIFO even with one sample inserted
             //
             // tracef( "Warning: FIFO fill level is too low" );
 
-            memset( brx_buf[ bc ], 0xFF, B_CH_BUFSIZE );
+            memset( buf, 0xFF, B_CH_BUFSIZE );
+            jb.Reset( B_RX_TARGET, f0_now );
+            B_RX_Data( PN * 2 + bc, 0, 0, 0 );
             return;
             }
 
-        if ( rcnt > 2 * B_CH_BUFSIZE ) 
+        int discarded = 0;
+
+        if ( rcnt > B_RX_TARGET + B_MAX_EXCESS ) 
         {
-            // Too much data in FIFO, so reduce it to 2 * B_CH_BUFSIZE
+            // Far too much data in FIFO (e.g. after service stall), so
+            // reduce it at once to target level
             //
             // tracef( "Warning: FIFO fill level is too high" );
             
-            int mumbojumbo = rcnt - 2 * B_CH_BUFSIZE; 
-            rcnt -= mumbojumbo;
-            while ( mumbojumbo-- )
-                Read( A_FIFO_DATA );
+            discarded = rcnt - B_RX_TARGET; 
+            rcnt -= discarded;
+            ReadBurst( A_FIFO_DATA, 0, discarded );
 
             SelectFIFO( ID * 8 + bc * 2 + 1 + M_REV );
+            jb.Reset( B_RX_TARGET, f0_now );
             }
 
-        for ( int i = 0; i < B_CH_BUFSIZE; i++ )
+        int slip = jb.Update( rcnt, f0_now, B_RX_TARGET, true );
+
+        if ( slip < 0 || rcnt < B_CH_BUFSIZE ) 
+        {
+            // Insert sample: read one less, repeat the last one
+            //
+            ReadBurst( A_FIFO_DATA, buf, B_CH_BUFSIZE - 1 );
+
+            buf[ B_CH_BUFSIZE - 1 ] = buf[ B_CH_BUFSIZE - 2 ];
+            ++jb.inserted;
+            }
+        else
         {
-            brx_buf[ bc ][ i ] = Read( A_FIFO_DATA );
+            ReadBurst( A_FIFO_DATA, buf, B_CH_BUFSIZE );
+
+            if ( slip > 0 ) 
+            {
+                // Delete sample: skip one
+                //
+                Read( A_FIFO_DATA );
+                ++jb.deleted;
+                }
             }
     
         SelectFIFO( ID * 8 + bc * 2 + 1 + M_REV );
+
+        B_RX_Data( PN * 2 + bc, buf, B_CH_BUFSIZE, discarded );
         }
 
     // Write transparent audio data to FIFO
@@ -446,25 +1285,53 @@ private:
     {
         SelectFIFO( ID * 8 + bc * 2 + M_REV );
     
-        int free = max_Z - Read( A_USAGE );
+        int usage = Read( A_USAGE );
+        int free = max_Z - usage;
 
-        if ( free < B_CH_BUFSIZE )
+        JitterBuffer& jb = btx_jb[ bc ];
+
+        if ( free < B_CH_BUFSIZE + 1 )
         {
             // tracef( "Warning: Critical FIFO overrun" );
+            jb.Reset( B_TX_TARGET, f0_now );
             return;
             }
 
-        for ( int i = 0; i < B_CH_BUFSIZE; i++ )
+        unsigned char* buf = btx_buf[ bc ];
+
+        B_TX_Data( PN * 2 + bc, buf, B_CH_BUFSIZE );
+
+        int slip = jb.Update( usage, f0_now, B_TX_TARGET, false );
+
+        if ( slip > 0 )
+        {
+            // Delete sample: skip the last one
+            //
+            WriteBurst( A_FIFO_DATA, buf, B_CH_BUFSIZE - 1 );
+
+            ++jb.deleted;
+            }
+        else
         {
-            Write( A_FIFO_DATA, btx_buf[ bc ][ i ] );
+            WriteBurst( A_FIFO_DATA, buf, B_CH_BUFSIZE );
+
+            if ( slip < 0 ) 
+            {
+                // Insert sample: repeat the last one
+                //
+                WriteBurst( A_FIFO_DATA, buf + B_CH_BUFSIZE - 1, 1 );
+                ++jb.inserted;
+                }
             }
         }
 
-    void EH_ReadFIFO_D_Channel( void )
+    // Reads received HDLC frames from RX FIFO (relative to port)
+    //
+    void EH_ReadFIFO_HDLC( int fifo, HDLC_Channel& hc )
     {
-        // Select D-RX FIFO
+        // Select RX FIFO
         //
-        SelectFIFO( ID * 8 + 5 );
+        SelectFIFO( ID * 8 + fifo );
 
 	    // Check for RX FIFO overflow
         //
@@ -472,87 +1339,113 @@ private:
 	    if ( fstat & M_FIFO_ERR )
         {
 		    Write( A_INC_RES_FIFO, M_RES_FIFO_ERR ); // Reset error
+            ++hc.rx_overrun;
 		    }
 
-        // HDLC rcnt
+        // Take all frames completed in the FIFO (up to 8), so that
+        // back-to-back frames do not wait for the next service.
         //
-        int f1 = Read( A_F1 );
-        int f2 = Read( A_F2 );
-        int z1 = Read( A_Z1 );
-        int z2 = Read( A_Z2 );
+        for ( int fcnt = 0; fcnt < 8; fcnt++ )
+        {
+            // HDLC rcnt
+            //
+            int f1 = Read( A_F1 );
+            int f2 = Read( A_F2 );
+            int z1 = Read( A_Z1 );
+            int z2 = Read( A_Z2 );
 
-        int rcnt = ( z1 - z2 ) & max_Z;
-        if ( f1 != f2 )
-            rcnt++; 
+            int rcnt = ( z1 - z2 ) & max_Z;
+            if ( f1 != f2 )
+                rcnt++; 
 
-        if ( rcnt <= 0 ) 
-            return;
+            if ( rcnt <= 0 ) 
+                return;
 
-        int& idx = drx_indx;
+            // Read data from FIFO into ring; octets that do not fit are
+            // discarded (dummy read) and the frame will be dropped.
+            //
+            while ( rcnt > 0 )
+            {
+                unsigned char* p;
+                int n = hc.rx_ring.GetPutChunk( p );
+                if ( n <= 0 )
+                {
+                    hc.rx_ring.SetOverflow ();
+                    ReadBurst( A_FIFO_DATA, 0, rcnt );
+                    break;
+                    }
 
-        // Read data from FIFO
-        //
-        for ( int i = 0; i < rcnt; i++ )
-        {
-            if (  idx < MAX_DFRAME_LEN_L1 )
-                drx_buf[ idx++ ] = Read( A_FIFO_DATA );
-            else
-                Read( A_FIFO_DATA ); // Dummy read
-            }
+                if ( n > rcnt )
+                    n = rcnt;
 
-        if ( f1 == f2 ) 
-            return;
+                ReadBurst( A_FIFO_DATA, p, n );
+                hc.rx_ring.Advance( n );
+                rcnt -= n;
+                }
 
-        // HDLC frame termination
-        //
-        IncF ();
+            if ( f1 == f2 ) 
+                return;
+
+            // HDLC frame termination
+            //
+            IncF ();
+
+            EH_FrameReceived( hc );
+            }
+        }
 
-        // Check minimum frame size
+    void EH_FrameReceived( HDLC_Channel& hc )
+    {
+        int len = hc.rx_ring.GetPendingLen ();
+
+        // Check minimum frame size (one octet, FCS and STAT)
         //
-        if ( idx < 4 ) 
+        if ( len < 4 ) 
         {
             // tracef( "Error: Frame < minimum size" );
-            idx = 0;
+            ++hc.rx_invalid;
+            hc.rx_ring.Discard ();
             return;
             }
 
         // Last octet is STAT, which is 0x00 if CRC is OK.
         //
-        if ( drx_buf[ idx - 1 ] == 0xFF )
+        const unsigned char* stat;
+        hc.rx_ring.GetPendingChunk( len - 1, stat );
+
+        if ( *stat == 0xFF )
         {
             // tracef( "Error: Frame abort received" );
-            idx = 0;
+            ++hc.rx_invalid;
+            hc.rx_ring.Discard ();
             return;
             }
-        else if ( drx_buf[ idx - 1 ] != 0x00 )
+        else if ( *stat != 0x00 )
         {
-            // tracef( "Error: CRC error" );
-            idx = 0;
-            return;
+            // Frames with CRC error are delivered too, marked by STAT
+            //
+            ++hc.rx_crc_error;
             }
 
-        bytes2receive = idx - 3;
-        idx = 0;
-
-        tracef( "%c D-RX %s %a",
-            ID, bytes2receive, drx_buf, bytes2receive );
-
-        bytes2receive = 0; // FIXME: remove this in actual handler
+        // Queue frame for delivery to host (out of the bottom half)
+        //
+        if ( hc.rx_ring.Commit () )
+            ++hc.rx_frames;
         }
 
-    void EH_WriteFIFO_D_Channel( void )
+    // Writes queued HDLC frames to TX FIFO (relative to port)
+    //
+    void EH_WriteFIFO_HDLC( int fifo, HDLC_Channel& hc )
     {
-        if ( ! bytes2transmit || ! mode.IsActivated )
+        if ( hc.tx_ring.IsEmpty () || ! mode.IsActivated )
             return;
 
-        int& len = bytes2transmit;    // HDLC package len
-        int& idx = dtx_indx;          // Already transmitted
+        int& idx = hc.tx_indx;        // Already transmitted of oldest frame
 
-        SelectFIFO( ID * 8 + 4 );
+        SelectFIFO( ID * 8 + fifo );
 
         Read( A_FIFO_STA );
         int free = max_Z - Read( A_USAGE );
-        int tcnt = free >= len - idx ? len - idx : free;
 
         int f1 = Read( A_F1 );
         int f2 = Read( A_F2 );
@@ -564,39 +1457,57 @@ private:
 	    if ( fstat & M_FIFO_ERR )
         {
 		    Write( A_INC_RES_FIFO, M_RES_FIFO_ERR ); // Reset error
+            ++hc.tx_underrun;
             idx = 0; // Restart frame transmission
             return;
 		    }
 
-        if ( ! free || ! fcnt || ! tcnt ) 
-            return;
-
-        // Write data to FIFO
+        // Queue as many frames as the FIFO takes, so that they are sent
+        // back to back and not one per service.
         //
-        for ( int i = 0; i < tcnt; i++ )
-            Write( A_FIFO_DATA, dtx_buf[ idx++ ] );
-        
-        if ( idx != len) 
-            return;
+        while ( free > 0 && fcnt > 0 && ! hc.tx_ring.IsEmpty () )
+        {
+            int len = hc.tx_ring.GetLen ();
 
-        // Terminate frame
-        //
-        IncF ();
+            // Write data to FIFO (in two parts if frame wraps in ring)
+            //
+            while ( free > 0 && idx < len )
+            {
+                const unsigned char* p;
+                int tcnt = hc.tx_ring.GetChunk( idx, p );
+                if ( tcnt > free )
+                    tcnt = free;
+
+                WriteBurst( A_FIFO_DATA, p, tcnt );
+                idx += tcnt;
+                free -= tcnt;
+                }
 
-	    // Check for TX FIFO underrun during frame transmission
-        //
-	    fstat = Read( A_FIFO_STA );
-	    if ( fstat & M_FIFO_ERR )
-        {
-		    Write( A_INC_RES_FIFO, M_RES_FIFO_ERR ); // Reset error
-            idx = 0; // Restart frame transmission
-            return;
-		    }
+            if ( idx != len ) 
+                return;
+
+            // Terminate frame
+            //
+            IncF ();
+            --fcnt;
 
-        len = 0;
-        idx = 0;
+	        // Check for TX FIFO underrun during frame transmission
+            //
+	        fstat = Read( A_FIFO_STA );
+	        if ( fstat & M_FIFO_ERR )
+            {
+		        Write( A_INC_RES_FIFO, M_RES_FIFO_ERR ); // Reset error
+                ++hc.tx_underrun;
+                idx = 0; // Restart frame transmission
+                return;
+		        }
 
-        // TX completed. Get next frame to transmit if any?
+            // TX completed. Get next frame to transmit if any.
+            //
+            hc.tx_ring.Pop ();
+            idx = 0;
+            ++hc.tx_sent;
+            }
         }
 
     //////////////////////////////////////////////////////////////////////////////////
@@ -608,16 +1519,101 @@ public:
         return mode.IsActivated;
         }
 
+    bool IsNT( void ) const
+    {
+        return mode.NT;
+        }
+
+    int GetL1State( void ) const
+    {
+        return L1_state;
+        }
+
+    int GetChip( void ) const
+    {
+        return chip;
+        }
+
+    // True if B-Channel FIFOs are in HDLC mode
+    //
+    bool Is_B_HDLC( int bc ) const
+    {
+#ifdef XHFC_B_HDLC
+        return b_hdlc & ( 1 << bc );
+#else
+        return bc < 0; // Never
+#endif
+        }
+
+    // True if a B-Channel is enabled on its transparent FIFOs, which are
+    // serviced with B_CH_BUFSIZE octets every 1ms tick
+    //
+    bool Uses_B_FIFOs( void ) const
+    {
+        return ( ( fifo_irqmsk & ( 1 << 0 ) ) && ( su_ctrl0 & M_B1_TX_EN ) && ! Is_B_HDLC( 0 ) )
+            || ( ( fifo_irqmsk & ( 1 << 2 ) ) && ( su_ctrl0 & M_B2_TX_EN ) && ! Is_B_HDLC( 1 ) );
+        }
+
+    // D-Channel frame rings and statistics
+    //
+    const HDLC_Channel& Get_D_Channel( void ) const
+    {
+        return dch;
+        }
+
+    const FrameRing& Get_D_TX_Ring( void ) const
+    {
+        return dch.tx_ring;
+        }
+
+    FrameRing& Get_D_TX_Ring( void )
+    {
+        return dch.tx_ring;
+        }
+
+    FrameRing& Get_D_RX_Ring( void )
+    {
+        return dch.rx_ring;
+        }
+
+#ifdef XHFC_B_HDLC
+    // B-Channel frame rings and statistics; valid in HDLC mode only
+    //
+    HDLC_Channel& Get_B_HDLC( int bc )
+    {
+        return bch[ bc ];
+        }
+#endif
+
+#ifdef XHFC_L1_LOG
+    L1_Log& Get_L1_Log( void )
+    {
+        return l1_log;
+        }
+#endif
+
+    const JitterBuffer& Get_B_RX_Jitter( int bc ) const
+    {
+        return brx_jb[ bc ];
+        }
+
+    const JitterBuffer& Get_B_TX_Jitter( int bc ) const
+    {
+        return btx_jb[ bc ];
+        }
+
     XHFC_Port( void )
     {
         // All init is done in Initialize()
         }
 
-    // Init line interface and port ID
+    // Init line interface, chip, port ID and port number
     //
-    void Initialize( int pt, int fifo_depth, int NT_mode, int Up_mode )
+    void Initialize( int c, int pt, int pn, int fifo_depth, int NT_mode, int Up_mode )
     {
+        SetChip( c );
         ID                  = pt;
+        PN                  = pn;
 
         mode.NT             = NT_mode;
         mode.Up             = Up_mode;
@@ -635,15 +1631,22 @@ public:
         fifo_irq            = 0;
         fifo_irqmsk         = 0;
 
-        drx_indx            = 0;
-        bytes2receive       = 0;
+        dch.Reset ();
 
-        dtx_indx = 0;
-        dtx_append_indx     = 0;
-        bytes2transmit      = 0;
+#ifdef XHFC_B_HDLC
+        bch[ 0 ].Reset ();
+        bch[ 1 ].Reset ();
+        b_hdlc              = 0;
+#endif
 
         L1_state            = 0;
 
+#ifdef XHFC_L1_LOG
+        l1_log.Reset ();
+#endif
+
+        f0_now              = 0;
+
         // Initialize S/U registers
         //
         Write( R_SU_SEL, ID );
@@ -697,11 +1700,7 @@ public:
 
         // Setup D-Channel buffers
         //
-        dtx_indx = 0;
-        dtx_append_indx = 0;
-        bytes2transmit = 0;
-        drx_indx = 0;
-        bytes2receive = 0;
+        dch.Reset ();
 
         SetupFIFO( 4, 5, 2, M_FR_ABO ); // Enable D-Channel TX FIFO
         SetupFIFO( 5, 5, 2, M_FR_ABO | M_FIFO_IRQMSK ); // Enable D-Channel RX FIFO
@@ -753,28 +1752,78 @@ public:
         Write( A_SU_CTRL2, su_ctrl2 );
         }
 
-    void Loop_B_Channel( int bc )
+    // Connects B-Channel to its FIFOs (e.g. after loop), transparent or,
+    // in XHFC_B_HDLC builds, in HDLC mode with flags as interframe fill
+    //
+    void Connect_B_Channel( int bc, bool hdlc = false )
     {
-        SetupFIFO( bc * 2,     0xC6, 0, 0, false );  // Connect B-Ch S/U RX with PCM TX, no irqs
-        SetupFIFO( bc * 2 + 1, 0xC6, 0, 0, false );  // Connect B-Ch S/U TX with PCM RX, no irqs
+#ifdef XHFC_B_HDLC
+        bch[ bc ].Reset ();
 
-        Write( R_SLOT,   ID * 8 + bc * 2 );            // PCM timeslot B-Ch TX
-        Write( A_SL_CFG, ID * 8 + bc * 2 + 0x80 );     // Enable B-Ch TX timeslot on STIO1
+        if ( hdlc )
+            b_hdlc |= 1 << bc;
+        else
+            b_hdlc &= ~( 1 << bc );
+#else
+        hdlc = false; // Transparent only
+#endif
+
+        if ( hdlc )
+        {
+            SetupFIFO( bc * 2,     4, 0, M_FR_ABO ); // Enable B-Channel HDLC TX FIFO
+            SetupFIFO( bc * 2 + 1, 4, 0, M_FR_ABO | M_FIFO_IRQMSK ); // Enable B-Channel HDLC RX FIFO
+            }
+        else
+        {
+            SetupFIFO( bc * 2,     6, 0, 0 ); // Enable B-Channel TX FIFO
+            SetupFIFO( bc * 2 + 1, 6, 0, 0 ); // Enable B-Channel RX FIFO
+            }
 
+        Write( R_SLOT,   ID * 8 + bc * 2 );            // PCM timeslot B-Ch TX
+        Write( A_SL_CFG, 0 );                          // Disconnect timeslot
+        
         Write( R_SLOT,   ID * 8 + bc * 2 + 1 );        // PCM timeslot B-Ch RX
-        Write( A_SL_CFG, ID * 8 + bc * 2 + 1 + 0xC0 ); // Enable B-Ch RX timeslot on STIO1
+        Write( A_SL_CFG, 0 );                          // Disconnect timeslot
+
+        brx_jb[ bc ].Reset( B_RX_TARGET, f0_now );
+        btx_jb[ bc ].Reset( B_TX_TARGET, f0_now );
+
+        Enable_B_Channel( bc );
+        }
+
+    // Connects B-Channel to PCM instead of its FIFOs. PCM timeslots are
+    // assigned by XHFC::XC_Connect() and XHFC::XC_ConnectPCM().
+    //
+    void Route_B_Channel( int bc )
+    {
+#ifdef XHFC_B_HDLC
+        b_hdlc &= ~( 1 << bc );
+#endif
+        SetupFIFO( bc * 2,     0xC6, 0, 0, false );  // Connect B-Ch S/U RX with PCM TX, no irqs
+        SetupFIFO( bc * 2 + 1, 0xC6, 0, 0, false );  // Connect B-Ch S/U TX with PCM RX, no irqs
 
         Enable_B_Channel( bc );
         }
 
+    // HFC-channel number of the B-Channel within the chip
+    //
+    int Get_B_ChannelNum( int bc ) const
+    {
+        return ID * 4 + bc;
+        }
+
     // L2->L1 D-Channel hardware access:
     //
     void PH_ActivateRequest( void )
     {
-        tracef( "%c L2->L1: A|R", ID );
+        tracef( "%c L2->L1: A|R", PN );
+        XHFC_L1_EVENT( Log( L1_Log::EV_ACTIVATE_REQ ) );
 
         if ( mode.NT )
         {
+            if ( ! mode.IsActivated )
+                XHFC_L1_EVENT( ActivationStart () );
+
             Write( R_SU_SEL, ID );
             Write( A_SU_WR_STA, STA_ACTIVATE | M_SU_SET_G2_G3 );
             }
@@ -784,20 +1833,22 @@ public:
             {
                 T3.Start( TIMER_T3 );
                 mode.IsActivating = true;
+                XHFC_L1_EVENT( ActivationStart () );
                 Write( R_SU_SEL, ID );
                 Write( A_SU_WR_STA, STA_ACTIVATE );
                 }
             else
             {
                 // L1->L2: PH_ACTIVATE | CONFIRM
-                tracef( "%c L1->L2: A|C", ID );
+                tracef( "%c L1->L2: A|C", PN );
                 } 
             }
         }
 
     void PH_DeactivateRequest( void )
     {
-        tracef( "%c L2->L1: D|R", ID );
+        tracef( "%c L2->L1: D|R", PN );
+        XHFC_L1_EVENT( Log( L1_Log::EV_DEACTIVATE_REQ ) );
 
         if ( mode.NT )
         {
@@ -810,58 +1861,17 @@ public:
             } 
         }
 
-    void D_TX_Append( char* data, int len )
-    {
-        if ( bytes2transmit > 0 )
-            return;
-    
-        for ( int& i = dtx_append_indx; len > 0 && i < MAX_DFRAME_LEN_L1; i++, len-- )
-            dtx_buf[ i ] = *data++;
-        }
-
-    void D_TX_Append( int octet )
-    {
-        if ( bytes2transmit > 0 )
-            return;
-    
-        if ( dtx_append_indx < MAX_DFRAME_LEN_L1 )
-            dtx_buf[ dtx_append_indx++ ] = octet;
-        }
-
-    void D_TX_Query( void )
-    {
-        if ( bytes2transmit > 0 )
-            return;
-
-        tracef( "%c D-TX %s %a", ID, dtx_append_indx, dtx_buf, dtx_append_indx );
-        }
-
-    void D_TX_Abort( void )
-    {
-        if ( bytes2transmit > 0 )
-            return;
-
-        dtx_append_indx = 0;
-        }
-
-    void D_TX_Send( void )
-    {
-        if ( bytes2transmit > 0 )
-            return;
-
-        bytes2transmit = dtx_append_indx;
-        dtx_append_indx = 0;
-        }
-
     void UpdateState( int new_state )
     {
         if ( new_state == L1_state ) 
             return;
         
-        tracef( "%c STAT %c -> %c", ID, L1_state, new_state );
+        tracef( "%c STAT %c -> %c", PN, L1_state, new_state );
 
         L1_state = new_state;
 
+        XHFC_L1_EVENT( StateChanged( new_state ) );
+
         EH_StateChanged ();
         }
 
@@ -874,13 +1884,20 @@ public:
     //////////////////////////////////////////////////////////////////////////////////
     // Event Handlers
 
-    void EH_TX_FIFOs( void )
+    void EH_TX_FIFOs( unsigned short f0 )
     {
+        f0_now = f0;
+
 		// Handle B1 TX FIFO
         //
         if ( M_FIFO0_TX_IRQ & fifo_irqmsk )
         {
             fifo_irq &= ~M_FIFO0_TX_IRQ;
+#ifdef XHFC_B_HDLC
+            if ( Is_B_HDLC( 0 ) )
+                EH_WriteFIFO_HDLC( 0, bch[ 0 ] );
+            else
+#endif
             EH_WriteFIFO_B_Channel( 0 );
             }
 
@@ -889,6 +1906,11 @@ public:
         if ( M_FIFO1_TX_IRQ & fifo_irqmsk )
         {
             fifo_irq &= ~M_FIFO1_TX_IRQ;
+#ifdef XHFC_B_HDLC
+            if ( Is_B_HDLC( 1 ) )
+                EH_WriteFIFO_HDLC( 2, bch[ 1 ] );
+            else
+#endif
             EH_WriteFIFO_B_Channel( 1 );
             }
 
@@ -897,12 +1919,14 @@ public:
         if ( M_FIFO2_TX_IRQ & fifo_irqmsk )
         {
             fifo_irq &= ~M_FIFO2_TX_IRQ;
-            EH_WriteFIFO_D_Channel ();
+            EH_WriteFIFO_HDLC( 4, dch );
             }
         }
 
-    void EH_RX_FIFOs( void )
+    void EH_RX_FIFOs( unsigned short f0 )
     {
+        f0_now = f0;
+
 	    // Set fifo_irq when RX data is over treshold
         //
 		fifo_irq |= Read( R_FILL_BL0 + ID );
@@ -911,7 +1935,12 @@ public:
         //
         if ( M_FIFO0_RX_IRQ & fifo_irq & fifo_irqmsk )
         {
-            fifo_irq &= ~M_FIFO0_TX_IRQ;
+            fifo_irq &= ~M_FIFO0_RX_IRQ;
+#ifdef XHFC_B_HDLC
+            if ( Is_B_HDLC( 0 ) )
+                EH_ReadFIFO_HDLC( 1, bch[ 0 ] );
+            else
+#endif
             EH_ReadFIFO_B_Channel( 0 );
             }
 
@@ -920,6 +1949,11 @@ public:
         if ( M_FIFO1_RX_IRQ & fifo_irq & fifo_irqmsk )
         {
             fifo_irq &= ~M_FIFO1_RX_IRQ;
+#ifdef XHFC_B_HDLC
+            if ( Is_B_HDLC( 1 ) )
+                EH_ReadFIFO_HDLC( 3, bch[ 1 ] );
+            else
+#endif
             EH_ReadFIFO_B_Channel( 1 );
             }
 
@@ -928,21 +1962,26 @@ public:
         if ( M_FIFO2_RX_IRQ & fifo_irq & fifo_irqmsk )
         {
             fifo_irq &= ~M_FIFO2_RX_IRQ;
-            EH_ReadFIFO_D_Channel ();
+            EH_ReadFIFO_HDLC( 5, dch );
             }
         }
 
-    void EH_TimerTicks( void )
+    void EH_TimerTicks( int ms )
     {
-        if ( mode.NT && T1.DecAndTestExpired () )
+        XHFC_L1_EVENT( Tick( ms ) );
+
+        if ( mode.NT && T1.DecAndTestExpired( ms ) )
         {
-            tracef( "%c T1 expired %c", ID, L1_state );
+            tracef( "%c T1 expired %c", PN, L1_state );
+            XHFC_L1_EVENT( TimerExpired( L1_Log::EV_T1 ) );
+
             switch ( L1_state ) 
             {
                 case NT_STA_DEACTIVATED: // G1
                     mode.IsActivated = false;
                     // L1->L2: PH_DEACTIVATE | INDICATION
-                    tracef( "%c L1->L2: D|I", ID );
+                    tracef( "%c L1->L2: D|I", PN );
+                    XHFC_L1_EVENT( Deactivated () );
                     break;
 
                 case NT_STA_PENDING_ACTIVATION: // G2
@@ -953,7 +1992,8 @@ public:
                 case NT_STA_ACTIVATED: // G3
                     mode.IsActivated = true;
                     // L1->L2: PH_ACTIVATE | INDICATION
-                    tracef( "%c L1->L2: A|I", ID );
+                    tracef( "%c L1->L2: A|I", PN );
+                    XHFC_L1_EVENT( Activated () );
                     break;
 
                 case NT_STA_PENDING_DEACTIVATION: // G4
@@ -961,62 +2001,130 @@ public:
                 }
             }
 
-        if ( T3.DecAndTestExpired () )
+        if ( T3.DecAndTestExpired( ms ) )
         {
-            tracef( "%c T3 expired", ID );
+            tracef( "%c T3 expired", PN );
+            XHFC_L1_EVENT( TimerExpired( L1_Log::EV_T3 ) );
 
             mode.IsActivating = false;
             Write( R_SU_SEL, ID );
             Write( A_SU_WR_STA, STA_DEACTIVATE );
 
             // L1->L2: PH_DEACTIVATE | INDICATION
-            tracef( "%c L1->L2: D|I", ID );
+            tracef( "%c L1->L2: D|I", PN );
+            XHFC_L1_EVENT( Deactivated () );
             }
 
-        if ( T4.DecAndTestExpired () )
+        if ( T4.DecAndTestExpired( ms ) )
         {
-            tracef( "%c T4 expired", ID );
+            tracef( "%c T4 expired", PN );
+            XHFC_L1_EVENT( TimerExpired( L1_Log::EV_T4 ) );
 
             // L1->L2: PH_DEACTIVATE | INDICATION
-            tracef( "%c L1->L2: D|I", ID );
+            tracef( "%c L1->L2: D|I", PN );
+            XHFC_L1_EVENT( Deactivated () );
             }
+
+#ifdef XHFC_LAPD
+        D_TimerTick( PN, ms );
+#endif
         }
 
-    };
+    };
+
+//////////////////////////////////////////////////////////////////////////////////////
+// XHFC Controller
+//
+// Handles all XHFC chips on the board. Ports are numbered over all chips
+// in chip order; chip[] maps every chip to its ports, so that interrupt
+// status bits are dispatched to port[ first_port + S/U interface ].
+// The 1ms timer interrupt is taken from chip 0 only and ticks all ports.
+//
+// B-Channels may be cross-connected over the chip's PCM timeslots, so the
+// XHFC switches them without MCU copies. Every B-Channel routed to PCM
+// sends on the STIO1 timeslot of its own HFC-channel number (0..15) and
+// receives the timeslot of its partner; a B-Channel connected with itself
+// is looped back. External PCM timeslots XC_FIRST_PCM_SLOT and up are sent
+// on STIO1 and received from STIO2. PCM buses of different chips are not
+// connected, so both ends must be on the same chip.
+//
+class XHFC : public XHFC_HW
+{
+public:
+
+    enum // B-Channel cross-connect table entries
+    {
+        XC_NONE           = 0xFF, // Connected to FIFOs
+        XC_PCM            = 0x80, // ORed with external PCM timeslot
+        XC_FIRST_PCM_SLOT = 16,   // Internal connections use 0..15
+        XC_MAX_PCM_SLOT   = 31    // 2 MBit/s PCM
+        };
+
+    enum // Interrupt moderation, see SetModeration()
+    {
+        THRES_DEFAULT     = 1,    // 16 octets FIFO threshold
+        TI_DEFAULT        = 2,    // R_TI_WD: 1 ms timer
+        TI_MAX            = 6     // R_TI_WD: 16 ms timer
+        };
+
+private:
+
+    enum // A_SL_CFG: B-Channel (bit 0 = direction, 1..4 = HFC-channel) and routing
+    {
+        SL_CH_TX          = 0x00, // HFC-channel S/U RX data to PCM
+        SL_CH_RX          = 0x01, // HFC-channel S/U TX data from PCM
+        SL_TX_STIO1       = 0x80, // TX slot: send on STIO1
+        SL_RX_STIO2       = 0x80, // RX slot: receive from STIO2
+        SL_RX_STIO1       = 0xC0  // RX slot: receive from STIO1
+        };
 
-//////////////////////////////////////////////////////////////////////////////////////
-// XHFC Controller
-//
-class XHFC : public XHFC_HW
-{
-    enum // instead of #defines
+    struct Chip
     {
-        MAX_XHFC_SU_PORTS = 2,  // Max number of S0/Up ports per XHFC IC
+        int chip_id;            // CHIP identifier
+        int fifo_depth;         // Octets per FIFO
+        int first_port;         // Port number of S/U interface 0
+        int num_ports;          // Number of S and U interfaces in use
+
+        unsigned long f0_accu;  // Accumulated F0IO (every 125us) pulse counter
+        unsigned short f0_cnt;  // Last F0IO pulse counter value
+
+        // Cached chip registers
+        //
+        int irq_ctrl;           // Interrupt control register
+        int misc_irq;           // Miscellaneous interrupt status bits
+        int misc_irqmsk;        // Mask of enabled misc interrupts
+        int su_irq;             // State change interrupt status bits
+        int su_irqmsk;          // Mask of enables state change interrupts
         };
 
     //////////////////////////////////////////////////////////////////////////////////
 
-    int chip_id;                // CHIP identifier
-    int num_ports;              // Number of S and U interfaces
+    Chip chips[ XHFC_MAX_CHIPS ];
+    int num_chips;              // Number of detected chips
+    int num_ports;              // Number of S and U interfaces over all chips
+
+    // Interrupt moderation, see SetModeration()
+    //
+    int thres_tx;               // TX FIFO threshold, units of 16 octets
+    int thres_rx;               // RX FIFO threshold, units of 16 octets
+    int timer_ti;               // R_TI_WD timer value, tick = 2^(ti-2) ms
 
     // Statistics
     //
     unsigned long irq_cnt;      // Count interrupts
+    unsigned long irq_last;     // irq_cnt at last UpdateRates()
+    unsigned long irq_rate;     // Interrupts per second
+    unsigned long bus_last;     // Bus cycles at last UpdateRates()
+    unsigned long bus_rate;     // Bus cycles per second (XHFC_BENCHMARK only)
 
-    unsigned long f0_accu;      // Accumulated F0IO (every 125us) pulse counter
-    unsigned short f0_cnt;      // Last F0IO pulse counter value
-
-    // Cached chip registers
+    // Cross-connect table, indexed by B-Channel (port * 2 + bc): partner
+    // B-Channel, XC_PCM + timeslot or XC_NONE
     //
-    int irq_ctrl;               // Interrupt control register
-    int misc_irq;               // Miscellaneous interrupt status bits
-    int misc_irqmsk;            // Mask of enabled misc interrupts
-    int su_irq;                 // State change interrupt status bits
-    int su_irqmsk;              // Mask of enables state change interrupts
+    unsigned char xconn[ 2 * XHFC_MAX_PORTS ];
 
 public:
 
-    XHFC_Port port[ MAX_XHFC_SU_PORTS ];
+    XHFC_Port port[ XHFC_MAX_PORTS ];
 
 public:
 
@@ -1027,7 +2135,72 @@ public:
 
     unsigned long GetF0Count( void ) const
     {
-        return f0_accu;
+        return chips[ 0 ].f0_accu;
+        }
+
+    // False after the top half has found the F0 counter of a chip stopped
+    // and disabled its interrupts (see UpdateF0Count)
+    //
+    bool IsIrqEnabled( void ) const
+    {
+        for ( int c = 0; c < num_chips; c++ )
+        {
+            if ( ! ( chips[ c ].irq_ctrl & M_GLOB_IRQ_EN ) )
+                return false;
+            }
+
+        return true;
+        }
+
+    unsigned long GetIrqRate( void ) const
+    {
+        return irq_rate;
+        }
+
+    unsigned long GetBusRate( void ) const
+    {
+        return bus_rate;
+        }
+
+    int GetThresholdTX( void ) const
+    {
+        return thres_tx;
+        }
+
+    int GetThresholdRX( void ) const
+    {
+        return thres_rx;
+        }
+
+    int GetTimerValue( void ) const
+    {
+        return timer_ti;
+        }
+
+    // Timer tick interval in ms
+    //
+    int GetTickMs( void ) const
+    {
+        return 1 << ( timer_ti - 2 );
+        }
+
+    int GetPortCount( void ) const
+    {
+        return num_ports;
+        }
+
+    // Register access on the chip of port pt
+    //
+    int ReadPortReg( int pt, int addr )
+    {
+        SetChip( port[ pt ].GetChip () );
+        return Read( addr );
+        }
+
+    void WritePortReg( int pt, int addr, int value )
+    {
+        SetChip( port[ pt ].GetChip () );
+        Write( addr, value );
         }
 
     XHFC( void )
@@ -1035,67 +2208,170 @@ public:
         // Initialize performs initialization
         }
 
-    // Initialize the XHFC ISDN Chip
+    // Initialize all XHFC ISDN Chips. NT_modes and Up_modes are bit masks
+    // indexed by port number. Detection stops at first missing chip.
     //
     bool Initialize( int NT_modes = 0, int Up_modes = 0 )
     {
+        num_chips   = 0;
         num_ports   = 0;
-
         irq_cnt     = 0;
-        f0_accu     = 0;
-        f0_cnt      = 0;
+        irq_last    = 0;
+        irq_rate    = 0;
+        bus_last    = 0;
+        bus_rate    = 0;
+
+        thres_tx    = THRES_DEFAULT;
+        thres_rx    = THRES_DEFAULT;
+        timer_ti    = TI_DEFAULT;
+
+        memset( xconn, XC_NONE, sizeof( xconn ) );
+
+        for ( int c = 0; c < XHFC_MAX_CHIPS && num_ports < XHFC_MAX_PORTS; c++ )
+        {
+            SetChip( c );
+            InvalidateAddrReg ();
+
+            if ( ! InitializeChip( chips[ c ], NT_modes, Up_modes ) )
+                break;
+
+            ++num_chips;
+            }
 
-        irq_ctrl    = 0;
-        misc_irqmsk = 0;
-        misc_irq    = 0;
-        su_irq      = 0;
-        su_irqmsk   = 0;
+        return num_chips > 0;
+        }
+
+    // Sets FIFO thresholds (in units of 16 octets) and timer interval
+    // (R_TI_WD value 2 .. 6 for 1 .. 16 ms) on all chips.
+    //
+    // Higher thresholds mean fewer FIFO interrupts per HDLC frame, longer
+    // timer interval fewer timer interrupts when idle. Transparent
+    // B-Channels are serviced with a fixed chunk every tick, so only the
+    // defaults are accepted while one of them is enabled, and connecting
+    // one restores the defaults (see Connect_B_Channel).
+    //
+    bool SetModeration( int tx, int rx, int ti )
+    {
+        if ( ti < TI_DEFAULT || ti > TI_MAX || tx < 0 || rx < 0 )
+            return false;
+
+        for ( int c = 0; c < num_chips; c++ )
+        {
+            if ( tx * 16 >= chips[ c ].fifo_depth || rx * 16 >= chips[ c ].fifo_depth )
+                return false;
+            }
+
+        if ( tx != THRES_DEFAULT || rx != THRES_DEFAULT || ti != TI_DEFAULT )
+        {
+            for ( int pt = 0; pt < num_ports; pt++ )
+            {
+                if ( port[ pt ].Uses_B_FIFOs () )
+                    return false;
+                }
+            }
+
+        thres_tx = tx;
+        thres_rx = rx;
+        timer_ti = ti;
+
+        for ( int c = 0; c < num_chips; c++ )
+        {
+            SetChip( c );
+            Write( R_FIFO_THRES, thres_tx * M1_THRES_TX + thres_rx * M1_THRES_RX );
+            if ( c == 0 )
+                Write( R_TI_WD, timer_ti );
+            }
+
+        return true;
+        }
+
+    // Updates interrupt and bus cycle rates. Called every second.
+    //
+    void UpdateRates( void )
+    {
+        irq_rate = irq_cnt - irq_last;
+        irq_last = irq_cnt;
+
+#ifdef XHFC_BENCHMARK
+        unsigned long bus = addr_cycles + data_cycles;
+        bus_rate = bus - bus_last;
+        bus_last = bus;
+#endif
+        }
+
+private:
+
+    // Initialize the selected XHFC ISDN Chip
+    //
+    bool InitializeChip( Chip& ch, int NT_modes, int Up_modes )
+    {
+        ch.first_port  = num_ports;
+        ch.num_ports   = 0;
+        ch.fifo_depth  = 0;
+
+        ch.f0_accu     = 0;
+        ch.f0_cnt      = 0;
+
+        ch.irq_ctrl    = 0;
+        ch.misc_irqmsk = 0;
+        ch.misc_irq    = 0;
+        ch.su_irq      = 0;
+        ch.su_irqmsk   = 0;
 
         // Detect XHFC controller
         //
-        chip_id = Read( R_CHIP_ID );
+        ch.chip_id = Read( R_CHIP_ID );
 
         // Configure FIFO depth
         //
-        int fifo_depth = 0;
-        switch ( chip_id ) 
+        int& fifo_depth = ch.fifo_depth;
+        switch ( ch.chip_id ) 
         {
             case CHIP_ID_1SU: // Set 4 FIFOs with 256 bytes depth for TX and RX each
-                num_ports = 1;
+                ch.num_ports = 1;
                 fifo_depth = 256;
-                su_irqmsk = M_SU0_IRQMSK;
+                ch.su_irqmsk = M_SU0_IRQMSK;
                 Write( R_FIFO_MD, M1_FIFO_MD * 2 );
                 break;
 
             case CHIP_ID_2SU: // Set 8 FIFOs with 128 bytes depth for TX and RX each
-                num_ports = 2;
+                ch.num_ports = 2;
                 fifo_depth = 128;
-                su_irqmsk = M_SU0_IRQMSK | M_SU1_IRQMSK;
+                ch.su_irqmsk = M_SU0_IRQMSK | M_SU1_IRQMSK;
                 Write( R_FIFO_MD, M1_FIFO_MD * 1 );
                 break;
 
             case CHIP_ID_2S4U:
             case CHIP_ID_4SU: // Set 16 FIFOs with 64 bytes depth for TX and RX each
-                num_ports = 4;
+                ch.num_ports = 4;
                 fifo_depth = 64;
-                su_irqmsk = M_SU0_IRQMSK | M_SU1_IRQMSK | M_SU2_IRQMSK | M_SU3_IRQMSK;
+                ch.su_irqmsk = M_SU0_IRQMSK | M_SU1_IRQMSK | M_SU2_IRQMSK | M_SU3_IRQMSK;
                 Write( R_FIFO_MD, M1_FIFO_MD * 0 );
                 break;
 
             default:
-                tracef( "ERROR: Initialize(): Unknown Chip ID 0x%c", chip_id );
+                tracef( "ERROR: Initialize(): Unknown Chip ID 0x%c", ch.chip_id );
                 return false;
             }
 
+        // Use only as many S/U interfaces as there are ports left
+        //
+        if ( ch.num_ports > XHFC_MAX_PORTS - num_ports )
+        {
+            ch.num_ports = XHFC_MAX_PORTS - num_ports;
+            ch.su_irqmsk &= ( 1 << ch.num_ports ) - 1;
+            }
+
         // Software reset to enable R_FIFO_MD setting
         //
         Write( R_CIRM, M_SRES );  // Soft reset (reset group 0)
         _delay_us( 5 );           // Wait 5 us
         Write( R_CIRM, 0 );       // Deactivate reset
+        InvalidateAddrReg ();     // Do not trust latched address after reset
 
         // Set FIFO threshold
         //
-        Write( R_FIFO_THRES, M1_THRES_TX | M1_THRES_RX ); // 16 bytes both TX & RX
+        Write( R_FIFO_THRES, thres_tx * M1_THRES_TX + thres_rx * M1_THRES_RX );
 
         // Wait initialization sequence to complete
         //
@@ -1119,20 +2395,24 @@ public:
 
         // Init line interfaces
         //
-        for ( int pt = 0; pt < num_ports; pt++) 
+        for ( int pt = 0; pt < ch.num_ports; pt++) 
         {
-            port[ pt ].Initialize( 
-                pt, fifo_depth,
-                NT_modes & ( 1 << pt ), 
-                Up_modes & ( 1 << pt ) 
+            int pn = ch.first_port + pt;
+
+            port[ pn ].Initialize( 
+                chip, pt, pn, fifo_depth,
+                NT_modes & ( 1 << pn ), 
+                Up_modes & ( 1 << pn ) 
                 );
             }
 
-        EnableInterrupts ();
+        num_ports += ch.num_ports;
+
+        EnableInterrupts( ch );
 
         // Force initial L1 state changes
         //
-        su_irq |= su_irqmsk;
+        ch.su_irq |= ch.su_irqmsk;
 
         // Configure PWM0 & PWM1
         //
@@ -1148,25 +2428,20 @@ public:
         return true;
         }
 
-    // Disable all interrupts by disabling M_GLOB_IRQ_EN
-    //
-    void DisableInterrupts( void )
-    {
-        irq_ctrl &= ~M_GLOB_IRQ_EN;
-        Write( R_IRQ_CTRL, irq_ctrl );
-        }
-
-    // Start interrupt and set interrupt mask
+    // Start interrupt and set interrupt mask of the selected chip
     //
-    void EnableInterrupts( void )
+    void EnableInterrupts( Chip& ch )
     {
-        Write( R_SU_IRQMSK, su_irqmsk );
+        Write( R_SU_IRQMSK, ch.su_irqmsk );
 
-        // Set timer interrupt
+        // Set timer interrupt; one chip is enough to tick all ports
         //
-        Write( R_TI_WD, 0x02 ); // 1 ms interval
-        misc_irqmsk |= M_TI_IRQMSK;
-        Write( R_MISC_IRQMSK, misc_irqmsk );
+        if ( chip == 0 )
+        {
+            Write( R_TI_WD, timer_ti ); // 1 ms interval by default
+            ch.misc_irqmsk |= M_TI_IRQMSK;
+            }
+        Write( R_MISC_IRQMSK, ch.misc_irqmsk );
 
         // Clear all pending interrupts bits
         //
@@ -1179,76 +2454,118 @@ public:
 
         // Enable global interrupts
         //
-        irq_ctrl |= M_GLOB_IRQ_EN | M_FIFO_IRQ_EN;
-        Write( R_IRQ_CTRL, irq_ctrl );
+        ch.irq_ctrl |= M_GLOB_IRQ_EN | M_FIFO_IRQ_EN;
+        Write( R_IRQ_CTRL, ch.irq_ctrl );
         }
 
-    // Interrupt Handler (interrupt context).
-    // RC false means "not handled / no interrupt to handle".
+    // Collect interrupt status of the selected chip (interrupt context).
+    // RC true means "schedule bottom half".
     //
-    bool InterruptHandler( void )
+    bool UpdateIrqStatus( Chip& ch )
     {
-        if ( ! ( irq_ctrl & M_GLOB_IRQ_EN ) ) // IRQs are not enabled at all
+        if ( ! ( ch.irq_ctrl & M_GLOB_IRQ_EN ) ) // IRQs are not enabled at all
             return false;
 
-        // Remember address register
-        //
-        int saved_reg_addr = ReadAddrReg ();
-
         if ( ! Read( R_IRQ_OVIEW ) ) // If not indicated any interrupt
-        {
-            WriteAddrReg( saved_reg_addr );
             return false;
-            }
-        
-        // Update IRQ state bits
-        //
+
         bool schedule_BH = false;
 
-        if ( misc_irq |= Read( R_MISC_IRQ ) )
+        if ( ch.misc_irq |= Read( R_MISC_IRQ ) )
             schedule_BH = true;
 
-        if ( su_irq |= Read( R_SU_IRQ ) )
+        if ( ch.su_irq |= Read( R_SU_IRQ ) )
             schedule_BH = true;
 
-        for ( int pt = 0; pt < num_ports; pt++ ) 
+        for ( int pt = ch.first_port; pt < ch.first_port + ch.num_ports; pt++ ) 
         {
             if ( port[ pt ].UpdateFifoIrq () )
                 schedule_BH = true;
             }
 
-		if ( ! schedule_BH ) // No need to schedule bottom half irq handler
-            return false;
-
-        // Yes, we have! Count interrupts.
-        //
-        ++irq_cnt;
+        return schedule_BH;
+        }
 
-        // Accumulate F0 counter
-        //
+    // Accumulate F0 counter of the selected chip (interrupt context)
+    //
+    void UpdateF0Count( Chip& ch )
+    {
         unsigned short cnt = Read( R_F0_CNTL );
         cnt += ( Read( R_F0_CNTH ) << 8 );
 
-        int f0_delta = int( cnt - f0_cnt );
+        int f0_delta = int( cnt - ch.f0_cnt );
         if ( f0_delta > 0 )
         {
-            f0_accu += f0_delta;
+            ch.f0_accu += f0_delta;
             }
         else if ( f0_delta < 0 )
         {
-            f0_accu += f0_delta + 0xFFFF;
+            ch.f0_accu += f0_delta + 0xFFFF;
             }
         else // f0_delta == 0
         {
-            irq_ctrl &= ~M_GLOB_IRQ_EN;
-            Write( R_IRQ_CTRL, irq_ctrl );
+            ch.irq_ctrl &= ~M_GLOB_IRQ_EN;
+            Write( R_IRQ_CTRL, ch.irq_ctrl );
             }
             
-        f0_cnt = cnt;
+        ch.f0_cnt = cnt;
+        }
+
+public:
+
+    // Disable all interrupts by disabling M_GLOB_IRQ_EN
+    //
+    void DisableInterrupts( void )
+    {
+        for ( int c = 0; c < num_chips; c++ )
+        {
+            SetChip( c );
+            chips[ c ].irq_ctrl &= ~M_GLOB_IRQ_EN;
+            Write( R_IRQ_CTRL, chips[ c ].irq_ctrl );
+            }
+        }
+
+    // Interrupt Handler (interrupt context).
+    // RC false means "not handled / no interrupt to handle".
+    //
+    bool InterruptHandler( void )
+    {
+        // The address register is not written back: the main loop accesses
+        // the XHFC only with INT2 masked (or calls the handler itself when
+        // polling), so the handler never runs between address and data
+        // cycle, and addr_latch follows every address written here.
+        //
+        int saved_chip = chip;
+
+        bool schedule_BH = false;
+
+        for ( int c = 0; c < num_chips; c++ )
+        {
+            SetChip( c );
+
+            if ( UpdateIrqStatus( chips[ c ] ) )
+                schedule_BH = true;
+            }
+
+		if ( ! schedule_BH ) // No need to schedule bottom half irq handler
+        {
+            SetChip( saved_chip );
+            return false;
+            }
+
+        // Yes, we have! Count interrupts.
+        //
+        ++irq_cnt;
 
-        // Write back saved address register
+        // Accumulate F0 counters; FIFO service of every port uses its chip's
         //
-        WriteAddrReg( saved_reg_addr );
+        for ( int c = 0; c < num_chips; c++ )
+        {
+            SetChip( c );
+            UpdateF0Count( chips[ c ] );
+            }
+
+        SetChip( saved_chip );
 
         return true;
         }
@@ -1262,16 +2579,16 @@ public:
         //
         bool was_TimerIrq = false;
 
-        if ( misc_irq & M_TI_IRQ )
+        if ( chips[ 0 ].misc_irq & M_TI_IRQ )
         {
-            misc_irq &= ~M_TI_IRQ;
+            chips[ 0 ].misc_irq &= ~M_TI_IRQ;
             was_TimerIrq = true;
 
             // Handle TX FIFO events
             //
 	        for ( int pt = 0; pt < num_ports; pt++ )
             {
-                port[ pt ].EH_TX_FIFOs ();
+                port[ pt ].EH_TX_FIFOs( chips[ port[ pt ].GetChip () ].f0_accu );
                 }
             }
 
@@ -1279,29 +2596,39 @@ public:
         //
 	    for ( int pt = 0; pt < num_ports; pt++ )
         {
-            port[ pt ].EH_RX_FIFOs ();
+            port[ pt ].EH_RX_FIFOs( chips[ port[ pt ].GetChip () ].f0_accu );
             }
 
         // Handle S/U state change events
         //
-	    for ( int pt = 0; pt < num_ports; pt++ )
+        for ( int c = 0; c < num_chips; c++ )
         {
-            // Handle S/U state change interrupts
-            //
-            if ( su_irq & ( 1 << pt ) ) 
-            {
-                su_irq &= ~( 1 << pt );
+            Chip& ch = chips[ c ];
+
+            if ( ! ch.su_irq )
+                continue;
 
-                Write( R_SU_SEL, pt );
-                port[ pt ].UpdateState( Read( A_SU_RD_STA ) & M_SU_STA );
+            SetChip( c );
 
-                // Update LEDs
+	        for ( int pt = 0; pt < ch.num_ports; pt++ )
+            {
+                // Handle S/U state change interrupts
                 //
-                Write( R_GPIO_OUT0, 
-                      ( port[ 0 ].IsActivated () ? M_GPIO_OUT2 : 0 )
-                    | ( port[ 1 ].IsActivated () ? M_GPIO_OUT3 : 0 )
-                    );
+                if ( ch.su_irq & ( 1 << pt ) ) 
+                {
+                    ch.su_irq &= ~( 1 << pt );
+
+                    Write( R_SU_SEL, pt );
+                    port[ ch.first_port + pt ].UpdateState( Read( A_SU_RD_STA ) & M_SU_STA );
+                    }
                 }
+
+            // Update LEDs of first two S/U interfaces
+            //
+            Write( R_GPIO_OUT0, 
+                  ( ch.num_ports > 0 && port[ ch.first_port ].IsActivated () ? M_GPIO_OUT2 : 0 )
+                | ( ch.num_ports > 1 && port[ ch.first_port + 1 ].IsActivated () ? M_GPIO_OUT3 : 0 )
+                );
             }
 
         // Handle timer ticks events
@@ -1310,12 +2637,156 @@ public:
         {
 	        for ( int pt = 0; pt < num_ports; pt++ )
             {
-                port[ pt ].EH_TimerTicks ();
+                port[ pt ].EH_TimerTicks( GetTickMs () );
                 }
             }
 
         return was_TimerIrq;
         }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // B-Channel cross-connect. Channels are numbered port * 2 + bc.
+
+private:
+
+    // Configures timeslot of the selected chip; cfg = 0 disconnects it
+    //
+    void SetSlot( int slot, int dir, int cfg )
+    {
+        Write( R_SLOT, slot * 2 + dir );
+        Write( A_SL_CFG, cfg );
+        }
+
+    int ChannelNum( int ch ) const
+    {
+        return port[ ch >> 1 ].Get_B_ChannelNum( ch & 1 );
+        }
+
+public:
+
+    int GetChannelCount( void ) const
+    {
+        return 2 * num_ports;
+        }
+
+    int GetCrossConnect( int ch ) const
+    {
+        return xconn[ ch ];
+        }
+
+    // Connects B-Channels a and b (both directions); a == b loops back.
+    // Previous connections of both are released.
+    //
+    bool XC_Connect( int a, int b )
+    {
+        if ( a >= GetChannelCount () || b >= GetChannelCount () 
+            || port[ a >> 1 ].GetChip () != port[ b >> 1 ].GetChip () )
+        {
+            return false;
+            }
+
+        XC_Disconnect( a );
+        XC_Disconnect( b );
+
+        SetChip( port[ a >> 1 ].GetChip () );
+
+        int ca = ChannelNum( a );
+        int cb = ChannelNum( b );
+
+        SetSlot( ca, 0, ca * 2 + SL_CH_TX + SL_TX_STIO1 ); // a sends on its slot
+        SetSlot( cb, 0, cb * 2 + SL_CH_TX + SL_TX_STIO1 ); // b sends on its slot
+        SetSlot( ca, 1, cb * 2 + SL_CH_RX + SL_RX_STIO1 ); // b receives slot of a
+        SetSlot( cb, 1, ca * 2 + SL_CH_RX + SL_RX_STIO1 ); // a receives slot of b
+
+        port[ a >> 1 ].Route_B_Channel( a & 1 );
+        port[ b >> 1 ].Route_B_Channel( b & 1 );
+
+        xconn[ a ] = b;
+        xconn[ b ] = a;
+
+        return true;
+        }
+
+    // Connects B-Channel to external PCM timeslot (both directions)
+    //
+    bool XC_ConnectPCM( int a, int slot )
+    {
+        if ( a >= GetChannelCount () 
+            || slot < XC_FIRST_PCM_SLOT || slot > XC_MAX_PCM_SLOT )
+        {
+            return false;
+            }
+
+        // Timeslot may be used only once per chip
+        //
+        for ( int ch = 0; ch < GetChannelCount (); ch++ )
+        {
+            if ( ch != a && xconn[ ch ] == XC_PCM + slot 
+                && port[ ch >> 1 ].GetChip () == port[ a >> 1 ].GetChip () )
+            {
+                return false;
+                }
+            }
+
+        XC_Disconnect( a );
+
+        SetChip( port[ a >> 1 ].GetChip () );
+
+        int ca = ChannelNum( a );
+
+        SetSlot( slot, 0, ca * 2 + SL_CH_TX + SL_TX_STIO1 );
+        SetSlot( slot, 1, ca * 2 + SL_CH_RX + SL_RX_STIO2 );
+
+        port[ a >> 1 ].Route_B_Channel( a & 1 );
+
+        xconn[ a ] = XC_PCM + slot;
+
+        return true;
+        }
+
+    // Releases connection of B-Channel a; both ends are connected back to
+    // their FIFOs.
+    //
+    void XC_Disconnect( int a )
+    {
+        if ( a >= GetChannelCount () || xconn[ a ] == XC_NONE )
+            return;
+
+        int b = xconn[ a ];
+
+        SetChip( port[ a >> 1 ].GetChip () );
+
+        if ( b & XC_PCM )
+        {
+            SetSlot( b & ~XC_PCM, 0, 0 );
+            SetSlot( b & ~XC_PCM, 1, 0 );
+            }
+        else if ( b != a )
+        {
+            // Connect_B_Channel() releases timeslots of the B-Channel
+            //
+            xconn[ b ] = XC_NONE;
+            Connect_B_Channel( b );
+            }
+
+        xconn[ a ] = XC_NONE;
+        Connect_B_Channel( a );
+        }
+
+    // Connects B-Channel a to its FIFOs, see XHFC_Port::Connect_B_Channel().
+    // Transparent FIFOs need the default moderation, which is restored
+    // first if needed (see SetModeration).
+    //
+    void Connect_B_Channel( int a, bool hdlc = false )
+    {
+        if ( ! hdlc
+            && ( thres_tx != THRES_DEFAULT || thres_rx != THRES_DEFAULT || timer_ti != TI_DEFAULT ) )
+        {
+            SetModeration( THRES_DEFAULT, THRES_DEFAULT, TI_DEFAULT );
+            }
+
+        port[ a >> 1 ].Connect_B_Channel( a & 1, hdlc );
+        }
     };
 
 #endif // _XHFC_H_INCLUDED
@@ -0,0 +1,265 @@
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+#include "ELU28.h"
+#include "Config.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+TAU_Config::Record TAU_Config::ee_slot[ 2 ] EEMEM;
+
+TAU_Config::TAU_Config( void )
+{
+    SetDefaults ();
+    slot = -1;
+    write_slot = -1;
+    write_pos = 0;
+    }
+
+void TAU_Config::SetDefaults( void )
+{
+    memset( &rec, 0, sizeof( rec ) );
+
+    rec.version       = VERSION;
+    rec.mode          = TAU_D::MODE_TRANSPARENT;
+    rec.flags         = FLAG_TRACE;
+    rec.poll          = ELU28_D_Channel::DEFAULT_POLL_TIMEOUT;
+    rec.poll_enhanced = ELU28_D_Channel::DEFAULT_POLL_TIMEOUT_ENHANCED;
+    rec.retry_limit   = D_TransmitQueue::DEFAULT_RETRY_LIMIT;
+    rec.backoff       = ELU28_D_Channel::BACKOFF_NONE;
+    rec.backoff_base  = ELU28_D_Channel::DEFAULT_BACKOFF_BASE;
+    }
+
+void TAU_Config::Validate( void )
+{
+    if ( rec.poll < POLL_MIN || rec.poll > POLL_MAX )
+        rec.poll = ELU28_D_Channel::DEFAULT_POLL_TIMEOUT;
+
+    if ( rec.poll_enhanced < POLL_MIN || rec.poll_enhanced > POLL_MAX )
+        rec.poll_enhanced = ELU28_D_Channel::DEFAULT_POLL_TIMEOUT_ENHANCED;
+
+    if ( rec.retry_limit > ELU28_D_Channel::RETRY_LIMIT_MAX )
+        rec.retry_limit = ELU28_D_Channel::RETRY_LIMIT_MAX;
+
+    if ( rec.backoff > ELU28_D_Channel::BACKOFF_EXPONENTIAL )
+        rec.backoff = ELU28_D_Channel::BACKOFF_NONE;
+
+    if ( rec.backoff_base == 0 )
+        rec.backoff_base = ELU28_D_Channel::DEFAULT_BACKOFF_BASE;
+    }
+
+uint16_t TAU_Config::CRC( const Record& r )
+{
+    // CRC-CCITT (polynomial 0x1021, initial value 0xFFFF)
+    //
+    const uint8_t* p = (const uint8_t*)&r;
+    uint16_t crc = 0xFFFF;
+
+    for ( unsigned i = 0; i < sizeof( r ) - sizeof( r.crc ); i++ )
+    {
+        crc ^= uint16_t( p[ i ] ) << 8;
+
+        for ( int bit = 0; bit < 8; bit++ )
+            crc = ( crc & 0x8000 ) ? ( crc << 1 ) ^ 0x1021 : ( crc << 1 );
+        }
+
+    return crc;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void TAU_Config::Load( void )
+{
+    slot = -1;
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        Record r;
+        eeprom_read_block( &r, &ee_slot[ i ], sizeof( r ) );
+
+        if ( r.version != VERSION || r.crc != CRC( r ) )
+            continue;
+
+        // Sequence numbers are compared mod 256
+        //
+        if ( slot >= 0 && int8_t( r.seq_no - rec.seq_no ) <= 0 )
+            continue;
+
+        rec = r;
+        slot = i;
+        }
+
+    if ( slot < 0 )
+        SetDefaults ();
+
+    Validate ();
+
+    // Trace mode is applied only at boot; any frame from DTE turns it off.
+    //
+    trace = ( rec.flags & FLAG_TRACE ) != 0;
+    }
+
+void TAU_Config::Apply( void )
+{
+    tau.SetMode( rec.mode );
+
+    PBX.SetPollTimeout( rec.poll, rec.poll_enhanced );
+    DTS.SetPollTimeout( rec.poll, rec.poll_enhanced );
+
+    PBX.SetRetryPolicy( rec.retry_limit, rec.backoff, rec.backoff_base );
+    DTS.SetRetryPolicy( rec.retry_limit, rec.backoff, rec.backoff_base );
+    }
+
+void TAU_Config::Save( void )
+{
+    // Capture run-time mode changes done by COMMAND frames
+    //
+    rec.mode = tau.getModeBits ();
+
+    ++rec.seq_no;
+    rec.crc = CRC( rec );
+
+    // Write slot not holding current record (restart, if already writing)
+    //
+    wrec = rec;
+    write_slot = slot == 0 ? 1 : 0;
+    write_pos = 0;
+    }
+
+void TAU_Config::Timed_EH( void )
+{
+    if ( write_slot < 0 || ! eeprom_is_ready () )
+        return;
+
+    const uint8_t* src = (const uint8_t*)&wrec;
+    uint8_t* dst = (uint8_t*)&ee_slot[ write_slot ];
+
+    // Skip octets that are already there; saves time and EEPROM wear
+    //
+    while ( write_pos < sizeof( wrec )
+        && eeprom_read_byte( dst + write_pos ) == src[ write_pos ] )
+    {
+        ++write_pos;
+        }
+
+    if ( write_pos < sizeof( wrec ) )
+    {
+        eeprom_write_byte( dst + write_pos, src[ write_pos ] );
+        ++write_pos;
+        return;
+        }
+
+    // Verify slot before it replaces the previous one; write it again if
+    // the readback fails
+    //
+    Record r;
+    eeprom_read_block( &r, dst, sizeof( r ) );
+
+    if ( r.version != VERSION || r.crc != CRC( r ) || r.seq_no != wrec.seq_no )
+    {
+        write_pos = 0;
+        return;
+        }
+
+    slot = write_slot;
+    write_slot = -1;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void TAU_Config::SendResponse( int op )
+{
+    unsigned char data[ 11 ];
+    int len = 0;
+
+    data[ len++ ] = op;
+    data[ len++ ] = rec.version;
+    data[ len++ ] = rec.seq_no;
+    data[ len++ ] = tau.getModeBits ();
+    data[ len++ ] = rec.flags;
+    data[ len++ ] = rec.poll;
+    data[ len++ ] = rec.poll_enhanced;
+    data[ len++ ] = write_slot >= 0 ? 2 : slot >= 0 ? 1 : 0;
+    data[ len++ ] = rec.retry_limit;
+    data[ len++ ] = rec.backoff;
+    data[ len++ ] = rec.backoff_base;
+
+    tau.SendConfigResponse( data, len );
+    }
+
+void TAU_Config::OnConfigRequest( const unsigned char* data, int len )
+{
+    if ( len < 1 )
+        return;
+
+    int op = data[ 0 ];
+
+    switch( op )
+    {
+        case OP_GET:
+            break;
+
+        case OP_SET:
+            if ( len < 5 )
+                return;
+
+            rec.mode = data[ 1 ];
+            rec.flags = data[ 2 ];
+
+            rec.poll = data[ 3 ];
+            rec.poll_enhanced = data[ 4 ];
+
+            if ( len >= 8 )
+            {
+                rec.retry_limit = data[ 5 ];
+                rec.backoff = data[ 6 ];
+                rec.backoff_base = data[ 7 ];
+                }
+
+            Validate ();
+            Apply ();
+            break;
+
+        case OP_SET_FILTER:
+        case OP_GET_FILTER:
+        {
+            if ( len < 2 || data[ 1 ] > FILTER_TO_PBX )
+                return;
+
+            int table = data[ 1 ];
+
+            if ( op == OP_SET_FILTER && len >= 3 )
+            {
+                for ( int i = 3, pos = data[ 2 ]; i < len && pos < FILTER_SIZE; i++, pos++ )
+                    rec.filter[ table ][ pos ] = data[ i ];
+                }
+
+            unsigned char resp[ 2 + FILTER_SIZE ];
+            resp[ 0 ] = op;
+            resp[ 1 ] = table;
+            memcpy( resp + 2, rec.filter[ table ], FILTER_SIZE );
+
+            tau.SendConfigResponse( resp, sizeof( resp ) );
+            return;
+            }
+
+        case OP_SAVE:
+            Save ();
+            break;
+
+        case OP_DEFAULTS:
+        {
+            uint8_t seq_no = rec.seq_no;
+            SetDefaults ();
+            rec.seq_no = seq_no;
+            Apply ();
+            Save ();
+            }
+            break;
+
+        default:
+            return;
+        }
+
+    SendResponse( op );
+    }
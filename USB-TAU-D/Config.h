@@ -0,0 +1,134 @@
+#ifndef _CONFIG_H_INCLUDED
+#define _CONFIG_H_INCLUDED
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// TAU_Config Class: Persistent TAU-D configuration
+//
+// Configuration is kept in EEPROM as two versioned, CRC protected record
+// slots. Save() writes the slot not holding the newest record, so a power
+// loss during write leaves the previous configuration intact. Writing is
+// done one octet per 1ms tick, since EEPROM write (8.5ms per octet) would
+// otherwise starve the D channels and trigger the watchdog. A snapshot of
+// the record is written, so changes meanwhile cannot mix into the slot, and
+// the slot becomes current only after it is read back with valid CRC.
+//
+class TAU_Config
+{
+public:
+
+    enum // Flags
+    {
+        FLAG_TRACE          = 0x01  // Boot in trace (ASCII) mode
+        };
+
+    enum // Filter tables
+    {
+        FILTER_TO_DTS       = 0,    // Signals from PBX not forwarded to DTS
+        FILTER_TO_PBX       = 1     // Signals from DTS not forwarded to PBX
+        };
+
+/*
+    CONFIG frame data (DTE -> TAU):
+
+    +---+---+---+---+---+---+---+---+
+    |              OP               |
+    +---+---+---+---+---+---+---+---+
+    |            PARAMS             |  (optional)
+    +---+---+---+---+---+---+---+---+
+
+    OP:
+        GET         0x00    -
+        SET         0x01    MODE, FLAGS, POLL, POLL ENHANCED
+                            [, RETRY LIMIT, BACKOFF MODE, BACKOFF BASE]
+        SET_FILTER  0x02    TABLE, OFFSET, BITMAP OCTETS (up to 32)
+        SAVE        0x03    -
+        DEFAULTS    0x04    - (restores defaults and saves them)
+        GET_FILTER  0x05    TABLE
+
+    Filter bitmap bit ( FNC & 7 ) of octet ( FNC >> 3 ) set means that
+    signals with the FNC are not forwarded.
+
+    CONFIG_RESP frame data (TAU -> DTE):
+
+        GET, SET, SAVE, DEFAULTS:
+            OP, VERSION, SEQ NO, MODE, FLAGS, POLL, POLL ENHANCED, STORED,
+            RETRY LIMIT, BACKOFF MODE, BACKOFF BASE
+            where STORED is 0 = defaults, 1 = loaded or saved, 2 = saving
+
+        SET_FILTER, GET_FILTER:
+            OP, TABLE, BITMAP (32 octets)
+*/
+
+    enum // CONFIG ops
+    {
+        OP_GET              = 0x00,
+        OP_SET              = 0x01,
+        OP_SET_FILTER       = 0x02,
+        OP_SAVE             = 0x03,
+        OP_DEFAULTS         = 0x04,
+        OP_GET_FILTER       = 0x05
+        };
+
+private:
+
+    enum
+    {
+        VERSION             = 2,
+        FILTER_SIZE         = 32,   // 256 FNC bits
+        POLL_MIN            = 2,
+        POLL_MAX            = 100
+        };
+
+    struct Record
+    {
+        uint8_t  version;
+        uint8_t  seq_no;            // Newer of two valid slots wins
+        uint8_t  mode;              // TAU D mode & ack policy bits
+        uint8_t  flags;
+        uint8_t  poll;              // Poll interval (in ms)
+        uint8_t  poll_enhanced;     // Poll interval after signal (in ms)
+        uint8_t  retry_limit;       // Retransmissions before PDU is given up
+        uint8_t  backoff;           // Retransmission delay policy
+        uint8_t  backoff_base;      // (in ms)
+        uint8_t  filter[ 2 ][ FILTER_SIZE ];
+        uint16_t crc;               // CRC-CCITT of all octets above
+        };
+
+    static Record ee_slot[ 2 ];     // Lives in EEPROM
+
+    Record rec;                     // Active configuration
+    int slot;                       // Slot holding rec, -1 if defaults
+
+    Record wrec;                    // Snapshot of rec being written
+    int write_slot;                 // Slot being written, -1 if idle
+    unsigned int write_pos;
+
+    static uint16_t CRC( const Record& r );
+    void SetDefaults( void );
+    void SendResponse( int op );
+    void Validate( void );
+
+public:
+
+    TAU_Config( void );
+
+    void Load( void );
+    void Apply( void );
+    void Save( void );
+
+    bool IsFiltered( int table, int fnc ) const
+    {
+        fnc &= 0xFF;
+        return ( rec.filter[ table ][ fnc >> 3 ] & ( 1 << ( fnc & 0x07 ) ) ) != 0;
+        }
+
+    void OnConfigRequest( const unsigned char* data, int len );
+
+    void Timed_EH( void ); // Called every 1ms
+    };
+
+extern TAU_Config config;
+
+#endif // _CONFIG_H_INCLUDED
@@ -0,0 +1,264 @@
+#include <avr/io.h>
+
+#include "ELU28.h"
+#include "CrashLog.h"
+
+extern volatile unsigned int SysTimer;
+
+///////////////////////////////////////////////////////////////////////////////
+
+CrashLog::Ring CrashLog::ring __attribute__ ((section (".noinit")));
+
+CrashLog::CrashLog( void )
+{
+    // Ring is not touched here; OnBoot() decides whether it is preserved.
+    //
+    armed = false;
+    auto_report = false;
+    report_index = -1;
+    }
+
+void CrashLog::Clear( void )
+{
+    memset( &ring, 0, sizeof( ring ) );
+    ring.magic = MAGIC;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CrashLog::OnBoot( int mcucsr )
+{
+    bool valid = ring.magic == MAGIC
+        && ring.head < RING_SIZE && ring.count <= RING_SIZE;
+
+    // SRAM contents are unreliable after power-on or brown-out reset.
+    //
+    if ( mcucsr & ( _BV(PORF) | _BV(BORF) ) )
+        valid = false;
+
+    if ( valid && ( ring.preserved || ( mcucsr & _BV(WDRF) ) ) )
+    {
+        if ( ! ring.preserved )
+        {
+            ring.preserved = true;
+            ring.reset_cause = mcucsr;
+            }
+
+        armed = false; // Keep crash as is
+        auto_report = true;
+        return;
+        }
+
+    Clear ();
+    ring.reset_cause = mcucsr;
+    armed = true;
+
+    Log( EV_BOOT, 0, mcucsr );
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CrashLog::Log( int event, int id, int arg0, int arg1, int arg2, int arg3 )
+{
+    if ( ! armed )
+        return;
+
+    Record& r = ring.record[ ring.head ];
+
+    r.time     = SysTimer;
+    r.event    = event;
+    r.id       = id;
+    r.arg[ 0 ] = arg0;
+    r.arg[ 1 ] = arg1;
+    r.arg[ 2 ] = arg2;
+    r.arg[ 3 ] = arg3;
+
+    if ( ++ring.head >= RING_SIZE )
+        ring.head = 0;
+
+    if ( ring.count < RING_SIZE )
+        ++ring.count;
+    }
+
+void CrashLog::LogPDU( int id, const unsigned char* pdu, int len )
+{
+    Log( EV_PDU, id, len > 0xFF ? 0xFF : len,
+        len > 0 ? pdu[ 0 ] : 0, // OPC
+        len > 1 ? pdu[ 1 ] : 0, // FNC
+        len > 2 ? pdu[ 2 ] : 0
+        );
+    }
+
+void CrashLog::SnapshotCounters( void )
+{
+    for ( int i = 0; i < 2; i++ )
+    {
+        ELU28_D_Channel& ch = i == 0 ? PBX : DTS;
+        Counters& c = ring.counters[ i ];
+
+        c.verb_state     = ch.GetVerbState ();
+        c.fault          = ch.GetFaultCounter ();
+        c.timeout        = ch.GetTimeoutCounter ();
+        c.timeout_nbytes = ch.timeout_counter_nbytes;
+        c.timeout_pdu    = ch.timeout_counter_pdu;
+        c.timeout_ack    = ch.timeout_counter_ack;
+        c.dropped        = ch.GetDroppedCounter ();
+        }
+    }
+
+void CrashLog::OnFreeze( int id, int state, int where )
+{
+    if ( ! armed )
+        return;
+
+    ring.frozen       = true;
+    ring.freeze_id    = id;
+    ring.freeze_state = state;
+    ring.freeze_where = where;
+
+    SnapshotCounters ();
+
+    Log( EV_FREEZE, id, state, where );
+    }
+
+void CrashLog::OnSecondElapsed( void )
+{
+    if ( ! armed )
+        return;
+
+    ++ring.uptime;
+
+    SnapshotCounters ();
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CrashLog::OnHostConnected( void )
+{
+    if ( ! auto_report )
+        return;
+
+    auto_report = false;
+    Report ();
+    }
+
+void CrashLog::OnCrashRequest( const unsigned char* data, int len )
+{
+    auto_report = false;
+
+    if ( len >= 1 && ( data[ 0 ] & 0x01 ) ) // Clear and re-arm
+    {
+        Clear ();
+        armed = true;
+
+        Log( EV_BOOT, 0, ring.reset_cause );
+        }
+
+    Report ();
+    }
+
+void CrashLog::PutWord( unsigned char*& p, uint16_t value )
+{
+    *p++ = value >> 8;
+    *p++ = value & 0xFF;
+    }
+
+void CrashLog::Report( void )
+{
+    int flags = ( ring.preserved ? FLAG_PRESERVED : 0 )
+              | ( ring.frozen ? FLAG_FROZEN : 0 );
+
+    int first = ( ring.head + RING_SIZE - ring.count ) % RING_SIZE;
+
+    if ( trace )
+    {
+        printf( "%06u CRASH: reset %02X flags %02X uptime %u freeze %u/%u/%u records %u\r\n",
+            SysTimer, ring.reset_cause, flags, ring.uptime,
+            ring.freeze_id, ring.freeze_state, ring.freeze_where, ring.count );
+
+        for ( int i = 0; i < 2; i++ )
+        {
+            const Counters& c = ring.counters[ i ];
+            printf( "%06u CRASH %s: verb %u fault %u tmo %u/%u/%u/%u drop %u\r\n",
+                SysTimer, i == 0 ? "PBX" : "DTS", c.verb_state, c.fault, c.timeout,
+                c.timeout_nbytes, c.timeout_pdu, c.timeout_ack, c.dropped );
+            }
+
+        for ( int i = 0; i < ring.count; i++ )
+        {
+            const Record& r = ring.record[ ( first + i ) % RING_SIZE ];
+            printf( "%06u CRASH %06u: %02X %u %02X %02X %02X %02X\r\n",
+                SysTimer, r.time, r.event, r.id,
+                r.arg[ 0 ], r.arg[ 1 ], r.arg[ 2 ], r.arg[ 3 ] );
+            }
+
+        return;
+        }
+
+    // Frames are sent by Poll(), one per main loop pass. Records logged
+    // meanwhile are not part of this report.
+    //
+    report_index = 0;
+    report_first = first;
+    report_count = ring.count;
+    }
+
+void CrashLog::Poll( void )
+{
+    if ( report_index < 0 )
+        return;
+
+    unsigned char data[ 1 + RECORDS_PER_FRAME * sizeof( Record ) ];
+    unsigned char* p = data;
+
+    *p++ = report_index; // INDEX
+
+    if ( report_index == 0 ) // Header frame
+    {
+        *p++ = ring.reset_cause;
+        *p++ = ( ring.preserved ? FLAG_PRESERVED : 0 )
+             | ( ring.frozen ? FLAG_FROZEN : 0 );
+        PutWord( p, ring.uptime );
+        *p++ = ring.freeze_id;
+        *p++ = ring.freeze_state;
+        *p++ = ring.freeze_where;
+        *p++ = report_count;
+
+        for ( int i = 0; i < 2; i++ )
+        {
+            const Counters& c = ring.counters[ i ];
+
+            *p++ = c.verb_state;
+            PutWord( p, c.fault );
+            PutWord( p, c.timeout );
+            PutWord( p, c.timeout_nbytes );
+            PutWord( p, c.timeout_pdu );
+            PutWord( p, c.timeout_ack );
+            PutWord( p, c.dropped );
+            }
+        }
+    else // Record frame, oldest record first
+    {
+        int i = ( report_index - 1 ) * RECORDS_PER_FRAME;
+
+        for ( int j = 0; j < RECORDS_PER_FRAME && i < report_count; j++, i++ )
+        {
+            const Record& r = ring.record[ ( report_first + i ) % RING_SIZE ];
+
+            PutWord( p, r.time );
+            *p++ = r.event;
+            *p++ = r.id;
+            *p++ = r.arg[ 0 ];
+            *p++ = r.arg[ 1 ];
+            *p++ = r.arg[ 2 ];
+            *p++ = r.arg[ 3 ];
+            }
+        }
+
+    tau.SendCrashReport( 0, data, p - data );
+
+    // Done when the records sent so far cover the report
+    //
+    if ( report_index++ * RECORDS_PER_FRAME >= report_count )
+        report_index = -1;
+    }
@@ -0,0 +1,151 @@
+#ifndef _CRASHLOG_H_INCLUDED
+#define _CRASHLOG_H_INCLUDED
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// CrashLog Class: Post-mortem flight recorder
+//
+// Keeps the last RING_SIZE events (D channel state transitions, received
+// PDUs, DASL status, verbose state changes) and periodic counter snapshots
+// in a .noinit RAM region, which is not cleared by the C startup code.
+// After a watchdog reset (e.g. Freeze_CPU()) the ring is found intact,
+// preserved (no new events are logged into it) and reported to the DTE
+// until the DTE clears it. Report() only starts a report; Poll() sends
+// its CRASH_REPORT frames one at a time from the main loop, so that the
+// FT245 transmit buffer (128 octets) is not overrun.
+//
+class CrashLog
+{
+public:
+
+    enum EVENT // Record types
+    {
+        EV_NONE             = 0x00,
+        EV_BOOT             = 0x01, // arg0 = MCUCSR
+        EV_STATE            = 0x02, // arg0 = old state, arg1 = new state
+        EV_VERB             = 0x03, // arg0 = verbose state
+        EV_PDU              = 0x04, // arg0 = length, arg1..3 = first octets
+        EV_DASL             = 0x05, // arg0 = status, arg1 = control
+        EV_FREEZE           = 0x06, // arg0 = state, arg1 = where
+        EV_PDU_FAIL         = 0x07  // arg0 = reason, arg1 = FNC, arg2 = attempts
+        };
+
+    enum FREEZE_WHERE
+    {
+        FREEZE_RCVBUF_EH    = 0x01, // Unexpected octet
+        FREEZE_TIMED_EH     = 0x02  // Unexpected timeout
+        };
+
+/*
+    CRASH_REQ frame data (DTE -> TAU):
+
+        +---+---+---+---+---+---+---+---+
+        | 0   0   0   0   0   0   0   C |  C = 1: clear and re-arm recorder
+        +---+---+---+---+---+---+---+---+
+
+    CRASH_REPORT frames (TAU -> DTE), ADDR = 0, data starting with
+    frame INDEX:
+
+        INDEX = 0: RESET CAUSE (MCUCSR), FLAGS, UPTIME (s, MSB first),
+                  FREEZE ID, FREEZE STATE, FREEZE WHERE, RECORD COUNT,
+                  followed for PBX and DTS by: VERB STATE, FAULT, TIMEOUT,
+                  TIMEOUT NBYTES, TIMEOUT PDU, TIMEOUT ACK, DROPPED
+                  (counters as 16-bit words, MSB first)
+
+        INDEX = 1..n: up to RECORDS_PER_FRAME records, oldest first:
+                  TIME (ms, MSB first), EVENT, ID, ARG0..3
+
+    FLAGS:
+        bit 0: report holds a preserved crash (watchdog reset detected)
+        bit 1: CPU was frozen deliberately by Freeze_CPU()
+*/
+
+    enum // Report flags
+    {
+        FLAG_PRESERVED      = 0x01,
+        FLAG_FROZEN         = 0x02
+        };
+
+private:
+
+    enum
+    {
+        RING_SIZE           = 32,
+        RECORDS_PER_FRAME   = 5,    // INDEX + 5 * 8 octets (BC <= 51)
+        MAGIC               = 0xC4A5
+        };
+
+    struct Record
+    {
+        uint16_t time;
+        uint8_t  event;
+        uint8_t  id;
+        uint8_t  arg[ 4 ];
+        };
+
+    struct Counters
+    {
+        uint8_t  verb_state;
+        uint16_t fault;
+        uint16_t timeout;
+        uint16_t timeout_nbytes;
+        uint16_t timeout_pdu;
+        uint16_t timeout_ack;
+        uint16_t dropped;
+        };
+
+    struct Ring // Lives in .noinit
+    {
+        uint16_t magic;
+        uint8_t  head;      // next record to write
+        uint8_t  count;     // valid records
+        uint8_t  preserved; // crash is kept until cleared by DTE
+        uint8_t  reset_cause;
+        uint8_t  frozen;
+        uint8_t  freeze_id;
+        uint8_t  freeze_state;
+        uint8_t  freeze_where;
+        uint16_t uptime;    // in seconds
+        Counters counters[ 2 ];
+        Record   record[ RING_SIZE ];
+        };
+
+    static Ring ring;
+
+    bool armed;             // false while crash is preserved
+    bool auto_report;       // send report when DTE shows up
+
+    int     report_index;   // next CRASH_REPORT frame, -1 if none pending
+    uint8_t report_first;   // oldest record of the pending report
+    uint8_t report_count;   // records in the pending report
+
+    void Clear( void );
+    void SnapshotCounters( void );
+    void PutWord( unsigned char*& p, uint16_t value );
+
+public:
+
+    CrashLog( void );
+
+    void OnBoot( int mcucsr );
+
+    bool IsCrashPreserved( void ) const
+    {
+        return ring.preserved;
+        }
+
+    void Log( int event, int id, int arg0 = 0, int arg1 = 0, int arg2 = 0, int arg3 = 0 );
+    void LogPDU( int id, const unsigned char* pdu, int len );
+    void OnFreeze( int id, int state, int where );
+    void OnSecondElapsed( void );
+
+    void OnHostConnected( void );
+    void OnCrashRequest( const unsigned char* data, int len );
+    void Report( void );
+    void Poll( void );
+    };
+
+extern CrashLog crash;
+
+#endif // _CRASHLOG_H_INCLUDED
@@ -99,6 +99,26 @@ bool D_TransmitQueue::PutPDU( unsigned char* data, int len )
     return true;
     }
 
+void D_TransmitQueue::GiveUpPDU( void )
+{
+    extern volatile unsigned int SysTimer;
+
+    FailureRecord& r = fail_log[ fail_log_head ];
+    if ( ++fail_log_head >= FAIL_LOG_SIZE )
+        fail_log_head = 0;
+
+    r.time     = SysTimer;
+    r.reason   = last_failure;
+    r.fnc      = PeekFNC ();
+    r.attempts = attempt_counter + 1;
+
+    ++given_up_counter;
+
+    crash.Log( CrashLog::EV_PDU_FAIL, id, r.reason, r.fnc, r.attempts );
+
+    ErasePDU ();
+    }
+
 ///////////////////////////////////////////////////////////////////////////////
 
 ELU28_D_Channel:: ELU28_D_Channel( int p_id )
@@ -109,11 +129,22 @@ ELU28_D_Channel:: ELU28_D_Channel( int p_id )
 {
     poll_counter = 0;
 
+    poll_timeout = DEFAULT_POLL_TIMEOUT;
+    poll_timeout_enhanced = DEFAULT_POLL_TIMEOUT_ENHANCED;
+
+    backoff_mode = BACKOFF_NONE;
+    backoff_base = DEFAULT_BACKOFF_BASE;
+
 	fault_counter = 0;
 	timeout_counter = 0;
 	timeout_counter_nbytes = 0;
 	timeout_counter_pdu = 0;
 	timeout_counter_ack = 0;
+	timeout_counter_xmit = 0;
+
+	ack_counter = 0;
+	nack_counter = 0;
+	ack_timeout_counter = 0;
 
     // packet_header[ 0 ] = id;
     packet_status = PACKET_EMPTY;
@@ -151,3 +182,149 @@ void ELU28_D_Channel::Initialize( void )
     }
 
 ///////////////////////////////////////////////////////////////////////////////
+// Returns delay (in ms) before the next transmission attempt of the PDU
+// at the head of the transmit queue.
+//
+int ELU28_D_Channel::RetryDelay( void ) const
+{
+	int attempt = xmt_que.GetAttemptCount ();
+
+	if ( attempt == 0 ) // PDU has been given up; continue polling
+		return poll_timeout;
+
+	long delay;
+
+	switch( backoff_mode )
+	{
+		case BACKOFF_LINEAR:
+			delay = long( backoff_base ) * attempt;
+			break;
+
+		case BACKOFF_EXPONENTIAL:
+			delay = long( backoff_base ) << ( attempt < 10 ? attempt - 1 : 10 );
+			break;
+
+		default:
+			return poll_timeout;
+		}
+
+	if ( delay < poll_timeout )
+		return poll_timeout;
+
+	return delay > BACKOFF_MAX ? BACKOFF_MAX : int( delay );
+	}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void PutWord( unsigned char*& p, unsigned int value )
+{
+	*p++ = ( value >> 8 ) & 0xFF;
+	*p++ = value & 0xFF;
+	}
+
+/*
+    STATS_RESP frame data (TAU -> DTE), ADDR = 0 for PBX, 1 for DTS:
+
+        VERB STATE, RETRY LIMIT, BACKOFF MODE, BACKOFF BASE,
+        ACK, NACK, ACK TIMEOUT, FAULT, TIMEOUT, TIMEOUT XMIT, DROPPED,
+        GIVEN UP, FAILED NACK, FAILED ACK TIMEOUT, FAILED XMIT TIMEOUT,
+        followed by FAIL_LOG_SIZE records of the last PDUs given up:
+        TIME (ms), REASON, FNC, ATTEMPTS (oldest first, all zeros if empty)
+
+    All counters are 16-bit words, MSB first.
+*/
+int ELU28_D_Channel::FormatStatistics( unsigned char* buf ) const
+{
+	unsigned char* p = buf;
+
+	*p++ = verb_state;
+	*p++ = xmt_que.GetRetryLimit ();
+	*p++ = backoff_mode;
+	*p++ = backoff_base;
+
+	PutWord( p, ack_counter );
+	PutWord( p, nack_counter );
+	PutWord( p, ack_timeout_counter );
+	PutWord( p, fault_counter );
+	PutWord( p, timeout_counter );
+	PutWord( p, timeout_counter_xmit );
+	PutWord( p, xmt_que.dropped_counter );
+	PutWord( p, xmt_que.given_up_counter );
+
+	for ( int i = 0; i < D_TransmitQueue::FAIL_COUNT; i++ )
+		PutWord( p, xmt_que.fail_counter[ i ] );
+
+	for ( int i = 0; i < D_TransmitQueue::FAIL_LOG_SIZE; i++ )
+	{
+		int pos = ( xmt_que.fail_log_head + i ) % D_TransmitQueue::FAIL_LOG_SIZE;
+		const D_TransmitQueue::FailureRecord& r = xmt_que.fail_log[ pos ];
+
+		PutWord( p, r.time );
+		*p++ = r.reason;
+		*p++ = r.fnc;
+		*p++ = r.attempts;
+		}
+
+	return p - buf;
+	}
+
+void ELU28_D_Channel::ReportStatistics( void ) const
+{
+	if ( trace )
+	{
+		extern volatile unsigned int SysTimer;
+
+		printf( "%06u %s: ack %u nack %u tmo %u xmit tmo %u given up %u"
+			" (nack %u, ack tmo %u, xmit tmo %u)\r\n",
+			SysTimer, id == 0 ? "PBX" : "DTS",
+			ack_counter, nack_counter, ack_timeout_counter, timeout_counter_xmit,
+			xmt_que.given_up_counter,
+			xmt_que.fail_counter[ D_TransmitQueue::FAIL_NACK ],
+			xmt_que.fail_counter[ D_TransmitQueue::FAIL_ACK_TIMEOUT ],
+			xmt_que.fail_counter[ D_TransmitQueue::FAIL_XMIT_TIMEOUT ] );
+		return;
+		}
+
+	unsigned char buf[ 56 ];
+	int len = FormatStatistics( buf );
+
+	tau.SendStatsResponse( id, buf, len );
+	}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sends unsolicited status event frame to the DTE
+//
+void ELU28_D_Channel::ReportEvent( int event, int arg ) const
+{
+	extern volatile unsigned int SysTimer;
+
+	unsigned int now = SysTimer;
+
+	if ( trace )
+	{
+		// Verbose state changes are traced by SetVerb_State()
+		//
+		if ( event == TAU_D::STATUS_EVENT_LOOP_SYNC )
+			printf( "%06u %s: Loop %s\r\n", now, id == 0 ? "PBX" : "DTS",
+				arg ? "in Sync" : "Out of Sync" );
+		return;
+		}
+
+	unsigned char buf[ 56 ];
+	unsigned char* p = buf;
+
+	*p++ = tau.getModeOctet ();
+	*p++ = event;
+	*p++ = arg;
+	PutWord( p, now );
+
+	tau.SendStatusEvent( id, buf, p - buf );
+
+	// Statistics do not fit into the same frame (BC <= 51)
+	//
+	int len = FormatStatistics( buf );
+
+	tau.SendStatsResponse( id, buf, len );
+	}
+
+///////////////////////////////////////////////////////////////////////////////
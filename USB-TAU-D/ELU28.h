@@ -3,9 +3,12 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
 #include "Cadence.h"
 #include "DASL.h"
 #include "ELUFNC.h"
+#include "CrashLog.h"
 
 #include <string.h>
 #include "TAU-D.h"
@@ -92,6 +95,8 @@ class D_TransmitQueue
     
     int curSeqNo;
     int attempt_counter;
+    int retry_limit;
+    int last_failure;
     bool enhanced_protocol;
 
     uint8_t* readp;
@@ -102,7 +107,34 @@ class D_TransmitQueue
 
 public:
 
+    enum FAILURE // Why transmission attempt failed
+    {
+        FAIL_NACK           = 0, // DTS/PBX answered with negative ack
+        FAIL_ACK_TIMEOUT    = 1, // No ack received
+        FAIL_XMIT_TIMEOUT   = 2, // Transmission did not complete in time
+        FAIL_COUNT          = 3
+        };
+
+    enum
+    {
+        DEFAULT_RETRY_LIMIT = 2, // Retransmissions before PDU is given up
+        FAIL_LOG_SIZE       = 4
+        };
+
+    struct FailureRecord // PDU given up
+    {
+        uint16_t time;
+        uint8_t  reason;   // of last failed attempt
+        uint8_t  fnc;
+        uint8_t  attempts;
+        };
+
     unsigned short dropped_counter;
+    unsigned short given_up_counter;
+    unsigned short fail_counter[ FAIL_COUNT ]; // Failed attempts per reason
+
+    FailureRecord fail_log[ FAIL_LOG_SIZE ]; // Last PDUs given up
+    int fail_log_head;
     
     D_TransmitQueue( int p_id )
     	: id( p_id )
@@ -113,11 +145,22 @@ public:
     	curSeqNo = 0;
     	outOfBandOctet = -1; // empty
     	attempt_counter = 0;
+    	retry_limit = DEFAULT_RETRY_LIMIT;
+    	last_failure = FAIL_NACK;
     	enhanced_protocol = false;
-    	dropped_counter = 0;
+    	ClearStatistics ();
         readp = writep = xmitp = bufp;
         maxp = bufp + sizeof( bufp ) - 1;
         }
+
+    void ClearStatistics( void )
+    {
+    	dropped_counter = 0;
+    	given_up_counter = 0;
+    	memset( fail_counter, 0, sizeof( fail_counter ) );
+    	memset( fail_log, 0, sizeof( fail_log ) );
+    	fail_log_head = 0;
+    	}
         
     void Disable( void )
     {
@@ -142,7 +185,7 @@ public:
     	outOfBandOctet = -1; // empty
     	attempt_counter = 0;
     	enhanced_protocol = false;
-    	dropped_counter = 0;
+    	ClearStatistics ();
         readp = writep = xmitp = bufp;
     	disabled = false;
     	flowXON = true;
@@ -169,6 +212,21 @@ public:
     {
         return ! disabled && octetCount == 0;
         }
+
+    void SetRetryLimit( int limit )
+    {
+        retry_limit = limit;
+        }
+
+    int GetRetryLimit( void ) const
+    {
+        return retry_limit;
+        }
+
+    int GetAttemptCount( void ) const
+    {
+        return attempt_counter;
+        }
         
     void SendSignalInquiry( void )
     {
@@ -203,24 +261,64 @@ public:
     	}
 
     bool PutPDU( unsigned char* data, int len );
+
+    // Returns octet at given offset from the head of the queue
+    //
+    int PeekOctet( int offset ) const
+    {
+    	uint8_t* p = readp + offset;
+    	if ( p > maxp )
+    		p -= sizeof( bufp );
+
+    	return *p;
+    	}
+
+    // Returns NBYTES i.e. total octet count of the PDU at the head of the queue
+    //
+    int PeekNBYTES( void ) const
+    {
+    	int NBYTES = PeekOctet( 0 );
+
+        if ( NBYTES & 0x80 )
+    	    NBYTES = ( ( NBYTES & ~0x80 ) << 8 ) | PeekOctet( 1 );
+
+    	return NBYTES;
+    	}
+
+    // Returns FNC of the PDU at the head of the queue
+    //
+    int PeekFNC( void ) const
+    {
+    	return PeekOctet( ( PeekOctet( 0 ) & 0x80 ) ? 3 : 2 );
+    	}
     
-    void StartTransmission( void )
+    // Returns number of octets to be transmitted, 0 if none
+    //
+    int StartTransmission( void )
     {   
     	if ( ! IsIdle () || IsQueueEmpty () )
-    		return;
+    		return 0;
     		
-    	xmitp = readp;
-    	
-    	int NBYTES = *xmitp++;
-    	if ( xmitp > maxp )
-    		xmitp = bufp;
-
-        if ( NBYTES & 0x80 )
-    	    NBYTES = ( ( NBYTES & ~0x80 ) << 8 ) | *xmitp;
+    	int NBYTES = PeekNBYTES ();
 
         xmitp = readp;
         outOfBandOctet = -1;
     	octetCount = NBYTES; // Start transmission
+
+    	return NBYTES;
+    	}
+
+    // Stops transmission in progress, e.g. when DASL clock has stalled
+    //
+    void AbortTransmission( void )
+    {
+    	uint8_t sreg = SREG;
+    	cli ();
+
+    	octetCount = 0;
+    	outOfBandOctet = -1;
+
+    	SREG = sreg;
     	}
 
     void ErasePDU( void )
@@ -230,7 +328,14 @@ public:
 
 		attempt_counter = 0;
 
-		readp = xmitp; // xmitp points to first word after transmit frame
+		// Skip PDU. Note that xmitp is not used, as transmission
+		// might have been aborted.
+		//
+		uint8_t* p = readp + PeekNBYTES ();
+		if ( p > maxp )
+			p -= sizeof( bufp );
+
+		readp = p;
 
 		if ( ! flowXON )
 		{		
@@ -250,16 +355,21 @@ public:
 	    	}
     	}
 
-    void RestartTransmission( void )
+    void RestartTransmission( int reason )
     {   
     	if ( ! IsIdle () || IsQueueEmpty () )
     		return;
+
+    	++fail_counter[ reason ];
+    	last_failure = reason;
     		
-    	if ( attempt_counter < 2 )
+    	if ( attempt_counter < retry_limit )
     		++attempt_counter;
 		else
-			ErasePDU ();
+			GiveUpPDU ();
     	}
+
+    void GiveUpPDU( void );
     
     inline int GetOctet( void )
     {
@@ -296,6 +406,27 @@ class ELU28_D_Channel
 {
 public:
 
+	enum // Poll policy defaults
+	{
+		DEFAULT_POLL_TIMEOUT			= 12, // > 10ms
+		DEFAULT_POLL_TIMEOUT_ENHANCED	= 2   // after signal in enhanced protocol
+		};
+
+	enum BACKOFF // Delay before retransmission (master only)
+	{
+		BACKOFF_NONE			= 0, // next poll interval
+		BACKOFF_LINEAR			= 1, // base * attempt
+		BACKOFF_EXPONENTIAL		= 2  // base * 2^(attempt-1)
+		};
+
+	enum // Retry policy defaults and limits
+	{
+		DEFAULT_BACKOFF_BASE	= 4,    // in ms
+		BACKOFF_MAX				= 1000, // in ms
+		RETRY_LIMIT_MAX			= 15,
+		XMIT_DEADLINE_MARGIN	= 5     // in ms
+		};
+
 	enum VERBOSE_STATE
 	{
 		VERBOSE_DOWN			= 0,
@@ -336,6 +467,12 @@ private:
 
     int poll_counter; // number of consecutive polls (00h's)
 
+    int poll_timeout; // master: signal inquiry interval
+    int poll_timeout_enhanced; // master: interval after signal, enhanced protocol
+
+    int backoff_mode; // master: retransmission delay policy
+    int backoff_base;
+
 	int timeout_counter;
 	int fault_counter;
 	
@@ -359,20 +496,72 @@ private: // Methods
 	//
 	void Go_State( STATE newState ) // without timeout
 	{
+		if ( newState != state )
+			crash.Log( CrashLog::EV_STATE, id, state, newState );
+
 		state = newState;
 		}
 
 	void Go_State( STATE newState, int timeout )
 	{
+		if ( newState != state )
+			crash.Log( CrashLog::EV_STATE, id, state, newState );
+
 		state = newState;
 		timer = timeout;
 		}
 
+	// Returns maximum time (in ms) the transmission of given number of
+	// octets may take. Transmission rate is ~1.6kBy/s i.e. 0.625ms per
+	// octet; allow 25% more (25/32 ms per octet) and a fixed margin.
+	//
+	static int TransmitDeadline( int octets )
+	{
+		return ( ( octets * 25 ) >> 5 ) + XMIT_DEADLINE_MARGIN;
+		}
+
+	// Starts transmission of the PDU at the head of the transmit queue.
+	//
+	void StartTransmission( void )
+	{
+		int octets = xmt_que.StartTransmission ();
+
+		Go_State( TRANSMITTING_PDU, TransmitDeadline( octets ) );
+		}
+
+	// Transmission did not complete in time, e.g. DASL clock stalled.
+	// Aborts it and counts the failed attempt.
+	//
+	void OnTransmitTimeout( void )
+	{
+		++timeout_counter;
+		++timeout_counter_xmit;
+
+		xmt_que.AbortTransmission ();
+		xmt_que.RestartTransmission( D_TransmitQueue::FAIL_XMIT_TIMEOUT );
+		}
+
+	int RetryDelay( void ) const;
+
+	void Freeze( int where )
+	{
+		crash.OnFreeze( id, state, where );
+
+		Freeze_CPU ();
+		}
+
 	///////////////////////////////////////////////////////////////////////////
 	//
 	void SetVerb_State( VERBOSE_STATE vs )
 	{
-		verb_state = vs;
+		if ( vs != verb_state )
+		{
+			crash.Log( CrashLog::EV_VERB, id, vs );
+
+			verb_state = vs;
+
+			ReportEvent( TAU_D::STATUS_EVENT_VERB_STATE, vs );
+			}
 
         if ( trace )
         {
@@ -397,6 +586,13 @@ public:
 	int timeout_counter_nbytes;
 	int timeout_counter_pdu;
 	int timeout_counter_ack;
+	int timeout_counter_xmit;
+
+	// Signal acknowledge counters; free running, never cleared
+	//
+	unsigned int ack_counter;
+	unsigned int nack_counter;
+	unsigned int ack_timeout_counter;
 	
     DASL dasl;
 
@@ -443,6 +639,23 @@ public:
 		return xmt_que.dropped_counter;
 		}
 
+	void SetPollTimeout( int normal, int enhanced )
+	{
+		poll_timeout = normal;
+		poll_timeout_enhanced = enhanced;
+		}
+
+	void SetRetryPolicy( int limit, int mode, int base )
+	{
+		xmt_que.SetRetryLimit( limit );
+		backoff_mode = mode;
+		backoff_base = base;
+		}
+
+	int FormatStatistics( unsigned char* buf ) const;
+	void ReportStatistics( void ) const;
+	void ReportEvent( int event, int arg ) const;
+
     void DecTimeoutTimer( void )
     {
     	if ( timer > 0 )
@@ -458,6 +671,10 @@ public:
 
         bool rc = packet_status == PACKET_COMPLETED;
         packet_status = PACKET_EMPTY;
+
+        if ( rc )
+            crash.LogPDU( id, packet, packet_len );
+
         return rc;
      	}
 
@@ -479,6 +696,10 @@ public:
 
     void OnLoopInSync( void )
     {
+		// Report SYNC OK to the host, with counters of previous sync period
+		//
+		ReportEvent( TAU_D::STATUS_EVENT_LOOP_SYNC, 1 );
+
 		// bChannel->StopTransmission ();
 		
 		rcv_buf.Initialize ();
@@ -499,11 +720,6 @@ public:
 		
 		poll_counter = 0;
 		transmission_order = 0;
-
-        // Now, report SYNC OK to the host
-        //        
-        if ( trace )
-            printf( "%s: Loop in Sync\r\n", id == 0 ? "PBX" : "DTS" );
 		}
 
     void OnLoopOutOfSync( void )
@@ -515,8 +731,7 @@ public:
 
 		// Now, report LOST SYNC to the host
 		//
-        if ( trace )
-            printf( "%s: Loop Out of Sync\r\n", id == 0 ? "PBX" : "DTS" );
+		ReportEvent( TAU_D::STATUS_EVENT_LOOP_SYNC, 0 );
         }
     };
 
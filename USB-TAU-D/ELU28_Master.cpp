@@ -1,7 +1,6 @@
 
 #include "ELU28.h"
 
-const int POLL_TIMEOUT = 12; // > 10ms
 const int TIMEOUT_6ms = 7; // receive ACK
 const int TIMEOUT_2ms = 3; // receive octet timeout
 
@@ -35,7 +34,7 @@ void ELU28_D_Channel::Master_RcvBuf_EH( void )
 
                 xmt_que.SetEnhancedProtocol( octet == 0x01 );
 
-        		Go_State( IDLE, POLL_TIMEOUT );
+        		Go_State( IDLE, poll_timeout );
                 }
             else if ( octet >= 4 && octet <= 127 )
             {
@@ -63,7 +62,7 @@ void ELU28_D_Channel::Master_RcvBuf_EH( void )
             	
                 // xmt_que.SendNegativeAck (); // MBK Patch
 
-                Go_State( IDLE, POLL_TIMEOUT );
+                Go_State( IDLE, poll_timeout );
             	}
             break;
 
@@ -83,7 +82,7 @@ void ELU28_D_Channel::Master_RcvBuf_EH( void )
             {
             	++fault_counter;
 
-                Go_State( IDLE, POLL_TIMEOUT );
+                Go_State( IDLE, poll_timeout );
                 }
             break;
 
@@ -111,7 +110,7 @@ void ELU28_D_Channel::Master_RcvBuf_EH( void )
 
                     xmt_que.SendNegativeAck ();
                     
-                	Go_State( IDLE, POLL_TIMEOUT );
+                	Go_State( IDLE, poll_timeout );
                     }
                 else
                 {                   
@@ -128,7 +127,7 @@ void ELU28_D_Channel::Master_RcvBuf_EH( void )
                     	++fault_counter;
 
                         // Ignore incoming signal
-                		Go_State( IDLE, POLL_TIMEOUT );
+                		Go_State( IDLE, poll_timeout );
                         }
                     else
                     {
@@ -140,7 +139,7 @@ void ELU28_D_Channel::Master_RcvBuf_EH( void )
                         else
                             packet_status = PACKET_EMPTY; // remove packet
 
-		            	Go_State( IDLE, xmt_que.IsEnhancedProtocol () ? 2 : POLL_TIMEOUT );
+		            	Go_State( IDLE, xmt_que.IsEnhancedProtocol () ? poll_timeout_enhanced : poll_timeout );
 
                         if ( packet_status == PACKET_COMPLETED )
                         {
@@ -178,17 +177,20 @@ void ELU28_D_Channel::Master_RcvBuf_EH( void )
             	if ( fault_counter > 0 )
             		--fault_counter;
 
+            	++ack_counter;
+
                 xmt_que.ErasePDU ();
 
-                Go_State( IDLE, xmt_que.IsEnhancedProtocol () ? 2 : POLL_TIMEOUT );
+                Go_State( IDLE, xmt_que.IsEnhancedProtocol () ? poll_timeout_enhanced : poll_timeout );
                 }
             else // octet == 0x75, or other
             {
             	++fault_counter;
+            	++nack_counter;
 
-            	xmt_que.RestartTransmission ();
+            	xmt_que.RestartTransmission( D_TransmitQueue::FAIL_NACK );
 
-                Go_State( IDLE, POLL_TIMEOUT );
+                Go_State( IDLE, RetryDelay () );
                 }
             break;
 
@@ -200,7 +202,7 @@ void ELU28_D_Channel::Master_RcvBuf_EH( void )
             break;
 
         case WAIT_SIGNAL_INQUIRY:
-            Freeze_CPU ();
+            Freeze( CrashLog::FREEZE_RCVBUF_EH );
             break;
         }
     }
@@ -243,9 +245,7 @@ void ELU28_D_Channel::Master_Timed_EH( void )
                 	}
                 else
                 {
-	                xmt_que.StartTransmission (); // Send Signal
-	                
-	                Go_State( TRANSMITTING_PDU, 1000 ); // Transmission rate is ~1.6kBy/s
+	                StartTransmission (); // Send Signal
                     }
                 break;
 
@@ -253,39 +253,42 @@ void ELU28_D_Channel::Master_Timed_EH( void )
             	++timeout_counter;
             	++timeout_counter_nbytes;
 
-            	Go_State( IDLE, POLL_TIMEOUT );
+            	Go_State( IDLE, poll_timeout );
             	break;
             	
             case WAIT_NBYTES_LOW:
             	++timeout_counter;
             	++timeout_counter_pdu;
 
-                Go_State( IDLE, POLL_TIMEOUT );
+                Go_State( IDLE, poll_timeout );
             	break;
 
             case RECEIVING_PDU:
             	++timeout_counter;
             	++timeout_counter_pdu;
             	
-                Go_State( IDLE, POLL_TIMEOUT );
+                Go_State( IDLE, poll_timeout );
                 break;
 
             case WAIT_FOR_ACK:
             	++timeout_counter;
             	++timeout_counter_ack;
+            	++ack_timeout_counter;
 
-            	xmt_que.RestartTransmission ();
+            	xmt_que.RestartTransmission( D_TransmitQueue::FAIL_ACK_TIMEOUT );
 
-                Go_State( IDLE, POLL_TIMEOUT );
+                Go_State( IDLE, RetryDelay () );
                 break;
                 
             case TRANSMITTING_PDU:
             	// Transmitter takes to long time to transmit signal
-            	Freeze_CPU (); // severe error
+            	OnTransmitTimeout ();
+
+                Go_State( IDLE, RetryDelay () );
             	break;
 
             case WAIT_SIGNAL_INQUIRY:
-                Freeze_CPU ();
+                Freeze( CrashLog::FREEZE_TIMED_EH );
                 break;
             };
         }
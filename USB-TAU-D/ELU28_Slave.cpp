@@ -42,9 +42,7 @@ void ELU28_D_Channel::Slave_RcvBuf_EH( void )
                 else
                 {
                     // Send Signal
-                    xmt_que.StartTransmission ();
-
-                	Go_State( TRANSMITTING_PDU, 1000 ); // Transmission rate is ~1.6kBy/s
+                    StartTransmission ();
                     }
                 }
             else if ( octet >= 4 && octet <= 127 )
@@ -144,13 +142,17 @@ void ELU28_D_Channel::Slave_RcvBuf_EH( void )
         case WAIT_FOR_ACK:
             if ( octet == 0xAA )
             {
+                ++ack_counter;
+
                 xmt_que.ErasePDU ();
                 
                 Go_State( IDLE, -1 );
                 }
             else // octet == 0x75, or other
             {
-            	xmt_que.RestartTransmission ();
+                ++nack_counter;
+
+            	xmt_que.RestartTransmission( D_TransmitQueue::FAIL_NACK );
 
                 Go_State( IDLE, -1 );
                 }
@@ -163,7 +165,7 @@ void ELU28_D_Channel::Slave_RcvBuf_EH( void )
          	break;
 
         case WAIT_NBYTES:
-            Freeze_CPU ();
+            Freeze( CrashLog::FREEZE_RCVBUF_EH );
             break;
         }
     }
@@ -210,18 +212,23 @@ void ELU28_D_Channel::Slave_Timed_EH( void )
                 break;
                 
             case WAIT_FOR_ACK:
-            	xmt_que.RestartTransmission ();
+                ++ack_timeout_counter;
+
+            	xmt_que.RestartTransmission( D_TransmitQueue::FAIL_ACK_TIMEOUT );
             	
                 Go_State( IDLE, -1 );
                 break;
 
             case TRANSMITTING_PDU:
-            	// Transmitter takes to long time to transmit signal
-            	Freeze_CPU (); // severe error
+            	// Transmitter takes to long time to transmit signal.
+            	// Retransmission is paced by the master's polls.
+            	OnTransmitTimeout ();
+
+                Go_State( IDLE, -1 );
             	break;
 
             case WAIT_NBYTES:
-                Freeze_CPU ();
+                Freeze( CrashLog::FREEZE_TIMED_EH );
                 break;
             }
         }
@@ -47,6 +47,12 @@ class TAU_D
         COMMAND_ACK   1 0 1 1    0x0B
         TEST_REQ      0 1 1 1    0x07
         TEST_REPORT   1 1 1 1    0x0F
+        CRASH_REQ     0 1 0 0    0x04
+        CRASH_REPORT  1 1 0 0    0x0C
+        CONFIG        0 1 0 1    0x05
+        CONFIG_RESP   1 1 0 1    0x0D
+        STATS_REQ     0 1 1 0    0x06
+        STATS_RESP    1 1 1 0    0x0E
 */
 
 public:
@@ -94,6 +100,31 @@ public:
         Signals from exchange are copied to DTE.
         Signals from DTS depend on DTS_TO_DTE_ENABLE bit.
 */
+/*
+    TAU D Status Events:
+    ===================
+
+    On link state changes, TAU D sends unsolicited STATUS_RESP frames
+    with ADDR = 0 for PBX, 1 for DTS, and data:
+
+        MODE, EVENT, ARG, TIME (ms, MSB first)
+
+    EVENT:
+        STATUS_EVENT_VERB_STATE:  ARG = new VERBOSE_* state
+        STATUS_EVENT_LOOP_SYNC:   ARG = 1 sync OK, 0 sync lost
+
+    Each event is followed by an unsolicited STATS_RESP frame with the
+    same ADDR, holding the D channel counters at the time of the change.
+
+    Solicited STATUS_RESP (answer to STATUS_REQ) holds only MODE; MODE is
+    the same octet in both.
+*/
+
+    enum // Status events
+    {
+        STATUS_EVENT_VERB_STATE = 0x00,
+        STATUS_EVENT_LOOP_SYNC  = 0x51  // = FNC_DASL_LOOP_SYNC
+        };
 
     enum // Address Field values
     {
@@ -129,6 +160,12 @@ private:
         FRM_CTL_COMMAND_ACK = 0x0B,
         FRM_CTL_TEST_REQ    = 0x07,
         FRM_CTL_TEST_REPORT = 0x0F,
+        FRM_CTL_CRASH_REQ   = 0x04,
+        FRM_CTL_CRASH_REPORT= 0x0C,
+        FRM_CTL_CONFIG      = 0x05,
+        FRM_CTL_CONFIG_RESP = 0x0D,
+        FRM_CTL_STATS_REQ   = 0x06,
+        FRM_CTL_STATS_RESP  = 0x0E,
         };
 
     // RECEIVER (to/from DTE) -------------------------------------------------
@@ -197,6 +234,18 @@ public:
         return ( mode & MODE_MASK ) >> 2;
         }
 
+    int getModeBits( void ) const
+    {
+        return mode & 0x3F;
+        }
+
+    // MODE octet of STATUS_RESP frames
+    //
+    int getModeOctet( void ) const
+    {
+        return mode & 0xFF;
+        }
+
     void SetMode( int new_mode )
     {
         mode &= ~0x3F;
@@ -236,6 +285,31 @@ public:
     void SendFrame( int ctl, int addr = 0, unsigned char* buf = NULL, int len = 0 );
     bool OnReceivedOctet( int octet ); // returns true when received valid data frame
 
+    void SendTestReport( int addr, unsigned char* buf, int len )
+    {
+        SendFrame( FRM_CTL_TEST_REPORT, addr, buf, len );
+        }
+
+    void SendCrashReport( int addr, unsigned char* buf, int len )
+    {
+        SendFrame( FRM_CTL_CRASH_REPORT, addr, buf, len );
+        }
+
+    void SendConfigResponse( unsigned char* buf, int len )
+    {
+        SendFrame( FRM_CTL_CONFIG_RESP, 0, buf, len );
+        }
+
+    void SendStatusEvent( int addr, unsigned char* buf, int len )
+    {
+        SendFrame( FRM_CTL_STATUS_RESP, addr, buf, len );
+        }
+
+    void SendStatsResponse( int addr, unsigned char* buf, int len )
+    {
+        SendFrame( FRM_CTL_STATS_RESP, addr, buf, len );
+        }
+
     void SendDataFrame( int addr, unsigned char* buf, int len )
     {
         // buf[] contains ELU 2B+D signal without NBYTES and CS
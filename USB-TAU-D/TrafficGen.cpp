@@ -0,0 +1,277 @@
+#include "ELU28.h"
+#include "TrafficGen.h"
+
+extern volatile unsigned int SysTimer;
+
+///////////////////////////////////////////////////////////////////////////////
+
+TrafficGen::TrafficGen( void )
+{
+    running = false;
+    remaining = 0;
+    endless = false;
+    cur_class = -1;
+    seq_no = 0;
+    report_timer = 0;
+
+    for ( int i = 0; i < CLASS_COUNT; i++ )
+    {
+        weight[ i ] = 1;
+        credit[ i ] = 0;
+        }
+
+    memset( stats, 0, sizeof( stats ) );
+    }
+
+void TrafficGen::Start( const unsigned char* mix, unsigned short count )
+{
+    int total = 0;
+
+    for ( int i = 0; i < CLASS_COUNT; i++ )
+    {
+        weight[ i ] = mix ? mix[ i ] : 1;
+        credit[ i ] = 0;
+        total += weight[ i ];
+        }
+
+    if ( total == 0 ) // Equal mix
+    {
+        for ( int i = 0; i < CLASS_COUNT; i++ )
+            weight[ i ] = 1;
+        }
+
+    memset( stats, 0, sizeof( stats ) );
+
+    for ( int i = 0; i < CLASS_COUNT; i++ )
+        stats[ i ].lat_min = 0xFFFF;
+
+    endless = count == 0;
+    remaining = count;
+    cur_class = -1;
+    seq_no = 0;
+    report_timer = REPORT_INTERVAL;
+    running = true;
+    }
+
+void TrafficGen::Stop( void )
+{
+    // Signal in flight, if any, is left to DTS transmit queue,
+    // but it is not accounted anymore.
+    //
+    running = false;
+    cur_class = -1;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+// Smooth weighted round-robin: deterministic, so that consecutive runs
+// against different DTS firmware builds see exactly the same signal sequence.
+//
+int TrafficGen::NextClass( void )
+{
+    int total = 0;
+    int best = -1;
+
+    for ( int i = 0; i < CLASS_COUNT; i++ )
+    {
+        if ( ! weight[ i ] )
+            continue;
+
+        credit[ i ] += weight[ i ];
+        total += weight[ i ];
+
+        if ( best < 0 || credit[ i ] > credit[ best ] )
+            best = i;
+        }
+
+    if ( best >= 0 )
+        credit[ best ] -= total;
+
+    return best;
+    }
+
+int TrafficGen::BuildSignal( int cls, unsigned char* pdu )
+{
+    int len = 0;
+
+    pdu[ len++ ] = SIGNAL_OPC;
+
+    switch( cls )
+    {
+        case CLASS_DISPLAY:
+            pdu[ len++ ] = FNC_WRITEDISPLAYFIELD;
+            pdu[ len++ ] = seq_no & 0x03; // Display field
+            for ( int i = 0; i < 10; i++ )
+                pdu[ len++ ] = 'A' + ( seq_no + i ) % 26;
+            break;
+
+        case CLASS_LED:
+            pdu[ len++ ] = ( seq_no & 0x01 ) ? FNC_CLEARLED : FNC_SETLED;
+            pdu[ len++ ] = ( seq_no >> 1 ) & 0x0F; // Indicator
+            break;
+
+        case CLASS_RINGING:
+            pdu[ len++ ] = ( seq_no & 0x01 ) ? FNC_STOPRINGING : FNC_INTERNRINGING;
+            break;
+
+        case CLASS_EQUSTAREQ:
+            pdu[ len++ ] = FNC_EQUSTAREQ;
+            break;
+        }
+
+    ++seq_no;
+
+    return len;
+    }
+
+void TrafficGen::OnSignalCompleted( void )
+{
+    Statistics& st = stats[ cur_class ];
+
+    st.nacks += DTS.nack_counter - nack_mark;
+    st.timeouts += DTS.ack_timeout_counter - timeout_mark;
+
+    if ( DTS.ack_counter != ack_mark )
+    {
+        unsigned short latency = SysTimer - sent_time;
+
+        ++st.acked;
+        st.lat_sum += latency;
+
+        if ( latency < st.lat_min )
+            st.lat_min = latency;
+        if ( latency > st.lat_max )
+            st.lat_max = latency;
+        }
+    else // Queue gave up retransmitting, or DTS loop went out of sync
+    {
+        ++st.dropped;
+        }
+
+    cur_class = -1;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void TrafficGen::Timed_EH( void )
+{
+    if ( ! running )
+        return;
+
+    // Counted on every tick, also while a signal is in flight
+    //
+    if ( --report_timer == 0 )
+    {
+        report_timer = REPORT_INTERVAL;
+        Report ();
+        }
+
+    if ( cur_class >= 0 )
+    {
+        if ( ! DTS.xmt_que.IsQueueEmpty () )
+            return; // Signal still in flight
+
+        OnSignalCompleted ();
+
+        if ( ! endless && remaining == 0 )
+        {
+            Stop ();
+            Report ();
+            return;
+            }
+        }
+
+    if ( DTS.GetVerbState () < ELU28_D_Channel::VERBOSE_HALFUP )
+        return; // Wait DTS loop in sync
+
+    int cls = NextClass ();
+    if ( cls < 0 )
+        return;
+
+    unsigned char pdu[ 16 ];
+    int len = BuildSignal( cls, pdu );
+
+    ack_mark = DTS.ack_counter;
+    nack_mark = DTS.nack_counter;
+    timeout_mark = DTS.ack_timeout_counter;
+    sent_time = SysTimer;
+
+    if ( ! DTS.xmt_que.PutPDU( pdu, len ) )
+        return;
+
+    cur_class = cls;
+    ++stats[ cls ].sent;
+
+    if ( ! endless )
+        --remaining;
+    }
+
+///////////////////////////////////////////////////////////////////////////////
+
+void TrafficGen::OnTestRequest( const unsigned char* data, int len )
+{
+    if ( len < 1 )
+        return;
+
+    switch( data[ 0 ] )
+    {
+        case CMD_STOP:
+            Stop ();
+            break;
+
+        case CMD_START:
+            if ( len >= 7 )
+                Start( data + 1, ( data[ 5 ] << 8 ) | data[ 6 ] );
+            else if ( len >= 5 )
+                Start( data + 1, 0 );
+            else
+                Start( NULL, 0 );
+            break;
+
+        case CMD_REPORT:
+            break;
+
+        default:
+            return;
+        }
+
+    Report ();
+    }
+
+void TrafficGen::Report( void )
+{
+    for ( int i = 0; i < CLASS_COUNT; i++ )
+    {
+        Statistics& st = stats[ i ];
+
+        unsigned short lat_min = st.acked ? st.lat_min : 0;
+        unsigned short lat_avg = st.acked ? st.lat_sum / st.acked : 0;
+
+        if ( trace )
+        {
+            printf( "%06u SOAK %d: sent %u ack %u nack %u tmo %u drop %u lat %u/%u/%u\r\n",
+                SysTimer, i, st.sent, st.acked, st.nacks, st.timeouts, st.dropped,
+                lat_min, lat_avg, st.lat_max );
+            continue;
+            }
+
+        unsigned short word[] =
+        {
+            remaining, st.sent, st.acked, st.nacks, st.timeouts, st.dropped,
+            lat_min, st.lat_max, lat_avg
+            };
+
+        unsigned char data[ 2 + 2 * sizeof( word ) / sizeof( word[ 0 ] ) ];
+        int len = 0;
+
+        data[ len++ ] = i; // CLASS
+        data[ len++ ] = running;
+
+        for ( unsigned j = 0; j < sizeof( word ) / sizeof( word[ 0 ] ); j++ )
+        {
+            data[ len++ ] = word[ j ] >> 8;
+            data[ len++ ] = word[ j ] & 0xFF;
+            }
+
+        tau.SendTestReport( 0, data, len );
+        }
+    }
@@ -0,0 +1,121 @@
+#ifndef _TRAFFICGEN_H_INCLUDED
+#define _TRAFFICGEN_H_INCLUDED
+
+///////////////////////////////////////////////////////////////////////////////
+// TrafficGen Class: Synthetic PBX signal load towards DTS (soak test)
+//
+// While running, signals between PBX, DTS and DTE are not relayed towards
+// DTS. Instead, the generator keeps exactly one generated signal in the DTS
+// transmit queue and injects the next one as soon as the previous one is
+// acknowledged or dropped, i.e. at the maximum rate the master poll loop
+// allows.
+//
+class TrafficGen
+{
+public:
+
+    enum SIGNAL_CLASS
+    {
+        CLASS_DISPLAY       = 0, // WRITEDISPLAYFIELD
+        CLASS_LED           = 1, // SETLED / CLEARLED
+        CLASS_RINGING       = 2, // INTERNRINGING / STOPRINGING
+        CLASS_EQUSTAREQ     = 3, // EQUSTAREQ
+        CLASS_COUNT         = 4
+        };
+
+/*
+    TEST_REQ frame data (DTE -> TAU):
+
+    +---+---+---+---+---+---+---+---+
+    |              CMD              |  0 = STOP, 1 = START, 2 = REPORT
+    +---+---+---+---+---+---+---+---+
+    |        WEIGHT DISPLAY         |  START only: relative signal mix
+    |        WEIGHT LED             |  (all zeros means equal mix)
+    |        WEIGHT RINGING         |
+    |        WEIGHT EQUSTAREQ       |
+    +---+---+---+---+---+---+---+---+
+    |        COUNT (MSB, LSB)       |  START only: signals to send, 0 = endless
+    +---+---+---+---+---+---+---+---+
+
+    Every TEST_REQ is answered with one TEST_REPORT frame per signal class.
+    Reports are also sent every second while running and once when the
+    test completes.
+
+    TEST_REPORT frame data (TAU -> DTE), ADDR = 0:
+
+        CLASS (1 octet), RUNNING (1 octet), REMAINING, SENT, ACKED, NACKS, TIMEOUTS,
+        DROPPED, LATENCY MIN, LATENCY MAX, LATENCY AVG
+
+    All words are 16-bit, MSB first. Latencies are in ms and measured from
+    the moment the signal is queued until DTS acknowledges it.
+*/
+
+    enum // TEST_REQ commands
+    {
+        CMD_STOP            = 0x00,
+        CMD_START           = 0x01,
+        CMD_REPORT          = 0x02
+        };
+
+private:
+
+    enum
+    {
+        SIGNAL_OPC          = 0x40, // OPC of generated signals
+        REPORT_INTERVAL     = 1000  // Periodic report while running (in ms)
+        };
+
+    struct Statistics
+    {
+        unsigned short sent;
+        unsigned short acked;
+        unsigned short nacks;
+        unsigned short timeouts;
+        unsigned short dropped;
+        unsigned short lat_min;
+        unsigned short lat_max;
+        unsigned long  lat_sum;
+        };
+
+    bool running;
+    unsigned short remaining; // signals left to generate; 0 when endless
+    bool endless;
+
+    unsigned char weight[ CLASS_COUNT ];
+    int credit[ CLASS_COUNT ];
+    Statistics stats[ CLASS_COUNT ];
+
+    // Signal in flight
+    //
+    int cur_class; // -1 if none
+    unsigned int sent_time;
+    unsigned int ack_mark;
+    unsigned int nack_mark;
+    unsigned int timeout_mark;
+
+    unsigned char seq_no; // varies contents of generated signals
+    unsigned int report_timer;
+
+    int NextClass( void );
+    int BuildSignal( int cls, unsigned char* pdu );
+    void OnSignalCompleted( void );
+
+public:
+
+    TrafficGen( void );
+
+    bool IsRunning( void ) const
+    {
+        return running;
+        }
+
+    void Start( const unsigned char* mix, unsigned short count );
+    void Stop( void );
+    void Report( void );
+
+    void OnTestRequest( const unsigned char* data, int len );
+
+    void Timed_EH( void ); // Called every 1ms
+    };
+
+#endif // _TRAFFICGEN_H_INCLUDED
@@ -17,6 +17,9 @@
 #include "DASL.h"
 #include "ELU28.h"
 #include "TAU-D.h"
+#include "TrafficGen.h"
+#include "CrashLog.h"
+#include "Config.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -25,11 +28,14 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 volatile unsigned int SysTimer = 0;
+CrashLog crash;
+TAU_Config config;
 Cadence  led;
 USB_FIFO usb;
 TAU_D tau;
 ELU28_D_Channel PBX( 0 );
 ELU28_D_Channel DTS( 1 );
+TrafficGen soak;
 bool trace = true;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -349,8 +355,12 @@ void DASL:: Update( void )
 	    PORTB |= _BV(PB7); // Set ~CCS1 = 1
         }
 
+    int old_status = status;
     status = SPDR;
 
+    if ( status != old_status )
+        crash.Log( CrashLog::EV_DASL, id, status, control );
+
     if ( trace )
         printf( "%06u %s: DASL %02X (%02X)\r\n", SysTimer, id == 0 ? "PBX" : "DTS",  status, control );
     }
@@ -422,11 +432,6 @@ void TAU_D::SendFrame( int ctl, int addr, unsigned char* buf, int len )
 
 bool TAU_D::OnReceivedOctet( int octet )
 {
-    // Ignore USB data if PBX link is down
-    //
-    if ( PBX.GetVerbState () < ELU28_D_Channel::VERBOSE_UP ) 
-        return false;
-
     bool has_data = false;
 
     switch( state )
@@ -503,16 +508,38 @@ bool TAU_D::OnReceivedOctet( int octet )
 
                 switch( CTL & FRM_CTL_MASK )
                 {
+                    case FRM_CTL_CRASH_REQ:
+                        crash.OnCrashRequest( data, data_len );
+                        break;
+
+                    case FRM_CTL_CONFIG:
+                        config.OnConfigRequest( data, data_len );
+                        break;
+
+                    case FRM_CTL_STATS_REQ:
+                    {
+                        // ADDR selects D channel; DATA bit 0 set clears
+                        // transmit failure statistics after report.
+                        //
+                        ELU28_D_Channel& ch = ADDR == ADDR_DTS ? DTS : PBX;
+                        ch.ReportStatistics ();
+                        if ( data_len >= 1 && ( data[ 0 ] & 0x01 ) )
+                            ch.xmt_que.ClearStatistics ();
+                        }
+                        break;
+
                     case FRM_CTL_DATA:
 
                         if ( mode & DATA_ACK_ENABLE ) // Opt. send ackonwledge
                             SendFrame( FRM_CTL_DATA_ACK );
 
                         // Forward data to DTS or to PBX, depending on ADDR,
-                        // but ignore duplicated frames.
+                        // but ignore duplicated frames, and ignore data
+                        // if PBX link is down.
                         //
                         has_data = ( sn != sn_from_DTE )
-                            && ( ADDR == ADDR_DTS || ADDR == ADDR_PBX );
+                            && ( ADDR == ADDR_DTS || ADDR == ADDR_PBX )
+                            && PBX.GetVerbState () >= ELU28_D_Channel::VERBOSE_UP;
 
                         break;
 
@@ -520,7 +547,7 @@ bool TAU_D::OnReceivedOctet( int octet )
                         break;
 
                     case FRM_CTL_STATUS_REQ:
-                        data[ 0 ] = mode;
+                        data[ 0 ] = getModeOctet ();
                         SendFrame( FRM_CTL_STATUS_RESP, 0, data, 1 );
                         break;
 
@@ -534,6 +561,7 @@ bool TAU_D::OnReceivedOctet( int octet )
                         break;
 
                     case FRM_CTL_TEST_REQ:
+                        soak.OnTestRequest( data, data_len );
                         break;
 
                     default:
@@ -542,6 +570,11 @@ bool TAU_D::OnReceivedOctet( int octet )
                     }
                 
                 sn_from_DTE = sn;
+
+                // Deliver preserved crash report, if any, as soon as
+                // the DTE talks to us.
+                //
+                crash.OnHostConnected ();
                 }
 
             state = WAIT_FLG1;
@@ -556,6 +589,20 @@ bool TAU_D::OnReceivedOctet( int octet )
 int
 main( void )
 {
+    // Capture reset cause before anything else; flight recorder
+    // decides whether the crash ring has to be preserved.
+    //
+    int reset_cause = MCUCSR;
+    MCUCSR = 0;
+
+    crash.OnBoot( reset_cause );
+
+    // Apply stored configuration before DASLs power up, so that unit
+    // comes back in full operating mode without DTE round trip.
+    //
+    config.Load ();
+    config.Apply ();
+
     Configure_Pins ();
     sei ();
 
@@ -584,6 +631,11 @@ main( void )
     if ( trace )
         printf( "Hello, world\r\n" );
 
+    if ( crash.IsCrashPreserved () )
+        crash.Report ();
+
+    int second_timer = 0;
+
     for ( ;; )
     {
         sleep_mode (); // Go CPU IDLE / Sleep
@@ -596,7 +648,9 @@ main( void )
         {
 	        // If repeater mode, forward signal to other channel
 	        //
-            if ( tau.getMode() != 1 ) // Do not copy PBX->DTS in PC Control mode
+            if ( tau.getMode() != 1 // Do not copy PBX->DTS in PC Control mode
+                && ! soak.IsRunning () // nor while generating traffic to DTS
+                && ! config.IsFiltered( TAU_Config::FILTER_TO_DTS, PBX.packet[ 1 ] ) )
             {
                 DTS.xmt_que.PutPDU( PBX.packet, PBX.packet_len );
                 }
@@ -611,7 +665,9 @@ main( void )
 
         if ( DTS.RcvBuf_EH () ) // true if PDU received
         {
-            if ( tau.getMode() != 1 ) // Do not copy DTS->PBX in PC Control mode
+            if ( tau.getMode() != 1 // Do not copy DTS->PBX in PC Control mode
+                && ! soak.IsRunning () // nor while DTS is talking to us
+                && ! config.IsFiltered( TAU_Config::FILTER_TO_PBX, DTS.packet[ 1 ] ) )
             {
                 PBX.xmt_que.PutPDU( DTS.packet, DTS.packet_len );
                 }
@@ -636,6 +692,14 @@ main( void )
 	        PBX.Timed_EH ();
 	        DTS.Timed_EH ();
 
+            // Soak test traffic generator
+            //
+            soak.Timed_EH ();
+
+            // Background EEPROM writer
+            //
+            config.Timed_EH ();
+
             // D channel DASL events
             //
             if ( DASL::IsStatusChanged () )
@@ -644,6 +708,14 @@ main( void )
                 DTS.DASL_EH ();
                 }
 
+            // Flight recorder counters
+            //
+            if ( ++second_timer >= 1000 )
+            {
+                second_timer = 0;
+                crash.OnSecondElapsed ();
+                }
+
             // LED Cadence
             //
             Set_LED( led.IsON () ? 150 : 10 );
@@ -678,6 +750,12 @@ main( void )
             sei ();
             }
 
+        ///////////////////////////////////////////////////////////////////////
+        // Flight recorder report: one frame per pass, when USB FIFO has room
+        //
+        if ( usb.TXE () )
+            crash.Poll ();
+
         ///////////////////////////////////////////////////////////////////////
         // USB receiver events
         //
@@ -690,7 +768,10 @@ main( void )
                 //
                 if ( tau.getAddr () == 1 ) // Copy to DTS
                 {
-                    DTS.xmt_que.PutPDU( tau.getData (), tau.getDataLen () );
+                    // DTS is reserved for traffic generator while it runs
+                    //
+                    if ( ! soak.IsRunning () )
+                        DTS.xmt_que.PutPDU( tau.getData (), tau.getDataLen () );
                     }
                 else if ( tau.getAddr () == 0 ) // Copy to PBX
                 {
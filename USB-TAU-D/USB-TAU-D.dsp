@@ -90,6 +90,14 @@ SOURCE=.\Cadence.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\Config.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\CrashLog.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\ELU28.cpp
 # End Source File
 # Begin Source File
@@ -102,6 +110,10 @@ SOURCE=.\ELU28_Slave.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\TrafficGen.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=".\USB-TAU-D.cpp"
 # End Source File
 # End Group
@@ -114,6 +126,14 @@ SOURCE=.\Cadence.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\Config.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\CrashLog.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\DASL.h
 # End Source File
 # Begin Source File
@@ -132,6 +152,10 @@ SOURCE=.\FT245.h
 
 SOURCE=".\TAU-D.h"
 # End Source File
+# Begin Source File
+
+SOURCE=.\TrafficGen.h
+# End Source File
 # End Group
 # Begin Group "Resource Files"
 